@@ -0,0 +1,34 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_ALLOCATIONCOUNTER_H
+#define TRACKBALLCONTROL_ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+// Count every heap allocation made by the process, by replacing the global operator new.
+// Replacements are program-wide definitions: include this from the benchmark's main file only
+static std::atomic<unsigned long> allocationCount { 0 };
+
+void* operator new( std::size_t size ) {
+    allocationCount++;
+    void *p = std::malloc(size ? size : 1);
+    if ( !p )
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete( void *p ) noexcept {
+    std::free(p);
+}
+
+void operator delete( void *p, std::size_t ) noexcept {
+    std::free(p);
+}
+
+
+#endif //TRACKBALLCONTROL_ALLOCATIONCOUNTER_H
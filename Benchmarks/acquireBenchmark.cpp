@@ -0,0 +1,235 @@
+//
+// Created on 17/10/2026.
+//
+
+// Hardware-free throughput benchmark: drives Trackball::acquire() and Trackball::sensorView() as fast as possible
+// against the simulated FX2, and reports samples/sec, per-call latency percentiles and heap allocations per call.
+
+#include "../Trackball.h"
+#include "../StreamServer.h"
+#include "AllocationCounter.h"
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+
+static void show_usage( std::string name )
+{
+    std::cerr << "Usage: " << name << " <option(s)>\n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message.\n"
+              << "\t-n,--samples N\t\tNumber of acquire() calls to time. Default is 1000000\n"
+              << "\t-f,--frames N\t\tNumber of sensorView() calls to time. Default is 1000\n"
+              << "\t-r,--replay FILE\tReplay a recorded CSV session instead of synthetic motion.\n"
+              << "\t-w,--write PATH\t\tAlso enable disk write, into the folder PATH.\n"
+              << "\t-a,--async DEPTH\tUse pipelined motion polling with DEPTH commands in flight.\n"
+              << "\t-b,--batch K\t\tRead K motion samples per USB command (1 to 9). Default is 1\n"
+              << "\t--rate HZ\t\tTarget sample rate of the pipelined polling. Default is unpaced\n"
+              << "\t--udp PORT\t\tAlso send the samples to 127.0.0.1:PORT. Repeat for several receivers\n"
+              << "\t--udp-batch N\t\tWith --udp, N decoded samples per datagram. Default is raw samples\n"
+              << "\t--udp-burst M\t\tWith --udp-batch, up to M datagrams per sendmmsg() call. Default is 1\n"
+              << "\t--udp-latency US\tWith --udp-batch, latency bound in microseconds. Default is 1000\n"
+              << "\t--udp-inline\t\tWith --udp, send from acquire() instead of the sender thread.\n"
+              << "\t--io-uring\t\tWrite the files and send the datagrams through io_uring.\n"
+              << "\t--shm NAME\t\tAlso publish the samples in the shared memory ring NAME\n"
+              << "\t--serve PATH\t\tAlso stream the samples to the clients of the Unix-domain socket PATH\n"
+              << std::endl;
+}
+
+static void report( const std::string& name, std::vector<double>& latencies, double seconds, unsigned long allocations )
+{
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&latencies]( double p ) {
+        return latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))];
+    };
+
+    std::cout << std::fixed << std::setprecision(2)
+              << name << ": " << latencies.size() << " calls in " << seconds << " s\n"
+              << "\tRate:           " << static_cast<double>(latencies.size()) / seconds << " /s\n"
+              << "\tLatency p50:    " << percentile(0.50) / 1000.0 << " us\n"
+              << "\tLatency p90:    " << percentile(0.90) / 1000.0 << " us\n"
+              << "\tLatency p99:    " << percentile(0.99) / 1000.0 << " us\n"
+              << "\tLatency p99.9:  " << percentile(0.999) / 1000.0 << " us\n"
+              << "\tLatency max:    " << latencies.back() / 1000.0 << " us\n"
+              << "\tAllocations:    " << static_cast<double>(allocations) / static_cast<double>(latencies.size())
+              << " per call" << std::endl;
+}
+
+template <typename Call>
+static double run( const std::string& name, size_t count, Call call )
+{
+    using clock = std::chrono::steady_clock;
+
+    if ( count == 0 )
+        return 0.0;
+
+    // Allocate the results up front so they don't show up in the allocation count
+    std::vector<double> latencies(count);
+
+    // Warm up caches and lazy allocations
+    for ( size_t i = 0; i < std::min<size_t>(count, 1000); i++ )
+        call();
+
+    unsigned long allocationsBefore = allocationCount;
+    auto start = clock::now();
+
+    for ( size_t i = 0; i < count; i++ ) {
+        auto t0 = clock::now();
+        call();
+        latencies[i] = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+    }
+
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    unsigned long allocations = allocationCount - allocationsBefore;
+
+    report(name, latencies, seconds, allocations);
+
+    return seconds;
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t samples = 1000000;
+    size_t frames = 1000;
+    std::string replay;
+    std::string outpath;
+    std::vector<std::string> udpPorts;
+    int udpBatch = 0;
+    int udpBurst = 1;
+    int udpLatency = 1000;
+    bool udpInline = false;
+    std::string servePath;
+    std::string shmName;
+    bool ioUring = false;
+    int asyncDepth = 0;
+    double rate = 0.0;
+    int batch = 1;
+
+    for ( int i = 1; i < argc; ++i ) {
+
+        std::string arg = argv[i];
+
+        if ( (arg == "-h") || (arg == "--help") ) {
+            show_usage(argv[0]);
+            return 0;
+
+        } else if ( ((arg == "-n") || (arg == "--samples")) && i + 1 < argc ) {
+            samples = std::stoul(argv[++i]);
+
+        } else if ( ((arg == "-f") || (arg == "--frames")) && i + 1 < argc ) {
+            frames = std::stoul(argv[++i]);
+
+        } else if ( ((arg == "-r") || (arg == "--replay")) && i + 1 < argc ) {
+            replay = argv[++i];
+
+        } else if ( ((arg == "-w") || (arg == "--write")) && i + 1 < argc ) {
+            outpath = argv[++i];
+
+        } else if ( ((arg == "-a") || (arg == "--async")) && i + 1 < argc ) {
+            asyncDepth = std::stoi(argv[++i]);
+
+        } else if ( ((arg == "-b") || (arg == "--batch")) && i + 1 < argc ) {
+            batch = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--rate") && i + 1 < argc ) {
+            rate = std::stod(argv[++i]);
+
+        } else if ( (arg == "--udp") && i + 1 < argc ) {
+            udpPorts.push_back(argv[++i]);
+
+        } else if ( (arg == "--udp-batch") && i + 1 < argc ) {
+            udpBatch = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--udp-burst") && i + 1 < argc ) {
+            udpBurst = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--udp-latency") && i + 1 < argc ) {
+            udpLatency = std::stoi(argv[++i]);
+
+        } else if ( arg == "--udp-inline" ) {
+            udpInline = true;
+
+        } else if ( arg == "--io-uring" ) {
+            ioUring = true;
+
+        } else if ( (arg == "--shm") && i + 1 < argc ) {
+            shmName = argv[++i];
+
+        } else if ( (arg == "--serve") && i + 1 < argc ) {
+            servePath = argv[++i];
+
+        } else {
+            show_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Trackball tb;
+
+    tb.disableConsoleOutput();
+    tb.setIoUring(ioUring);
+
+    if ( tb.connectSimulator(replay) != 0 )
+        return 1;
+
+    if ( !outpath.empty() ) {
+        tb.setOutputPath(outpath);
+        tb.setOutputName("benchmark");
+        if ( tb.enableDiskwrite() != 0 )
+            return 1;
+    }
+
+    if ( !udpPorts.empty() ) {
+        if ( udpBatch > 0 && tb.setNetworkBatching(udpBatch, udpBurst, std::chrono::microseconds(udpLatency)) != 0 )
+            return 1;
+        tb.setNetworkThread(!udpInline);
+        if ( tb.enableNetwork("127.0.0.1", udpPorts[0]) != 0 )
+            return 1;
+        for ( size_t p = 1; p < udpPorts.size(); p++ )
+            if ( tb.addNetworkDestination("127.0.0.1", udpPorts[p]) != 0 )
+                return 1;
+    }
+
+    if ( !shmName.empty() && tb.enableSharedRing(shmName) != 0 )
+        return 1;
+
+    StreamServer server;
+
+    if ( !servePath.empty() ) {
+        if ( server.listenUnix(servePath) != 0 )
+            return 1;
+        server.start(tb.makeReader());
+    }
+
+    if ( tb.setBatchSize(batch) != 0 )
+        return 1;
+
+    if ( asyncDepth > 0 && tb.enableAsyncMode(asyncDepth, rate) != 0 )
+        return 1;
+
+    // In async mode one acquire() call can decode several samples (or none), so count the samples too
+    int countBefore = tb.getCount();
+    double seconds = run("acquire()", samples, [&tb]() { tb.acquire(); });
+
+    if ( seconds > 0.0 )
+        std::cout << "\tSamples:        " << static_cast<double>(tb.getCount() - countBefore) / seconds << " /s" << std::endl;
+
+    tb.printTimingStats();
+    if ( !udpPorts.empty() ) {
+        tb.disableNetwork();
+        tb.printNetworkStats();
+    }
+
+    if ( !servePath.empty() ) {
+        server.stop();
+        server.printStats();
+    }
+
+    tb.enableSensorView();
+    run("sensorView()", frames, [&tb]() { tb.sensorView(); });
+
+    printInstrumentation();
+
+    return 0;
+}
@@ -0,0 +1,366 @@
+//
+// Created on 17/10/2026.
+//
+
+// Compression ratio and cost of the delta codec (DeltaCodec.h) on recorded sessions: binary session logs (.tbs,
+// compressed or not) or the CSV files of the Disk Write mode. Each session is encoded as the compressed session
+// log does (blocks of 256 records) and as the compressed datagrams would be (one block per datagram), decoded back,
+// checked record for record, and timed.
+// Without a file, a synthetic session stands in: bouts of walking and of standing still, with USB timing jitter.
+
+#include "../DeltaCodec.h"
+#include "../SessionLog.h"
+#include "../Clock.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+
+static void show_usage( std::string name )
+{
+    std::cerr << "Usage: " << name << " <option(s)> [SESSION.tbs|SESSION.csv ...]\n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message.\n"
+              << "\t-n,--samples N\t\tLength of the synthetic session. Default is 1000000\n"
+              << "\t--rate HZ\t\tSample rate of the synthetic session, and of CSV files without timestamps. Default is 5000\n"
+              << "\t--udp-batch N\t\tRecords per datagram. Default is 36\n"
+              << std::endl;
+}
+
+// Binary session log, plain or compressed, with the positions integrated along
+static bool loadSession( const std::string& name, std::vector<WireRecord>& records )
+{
+    std::ifstream input(name.c_str(), std::ios::binary);
+
+    unsigned char headerBytes[sessionHeaderSize];
+    SessionHeader header;
+
+    if ( !input.read(reinterpret_cast<char*>(headerBytes), sessionHeaderSize) || decodeSessionHeader(headerBytes, header) != 0 )
+        return false;
+
+    if ( header.compressed ) {
+
+        unsigned char blockHeader[sessionBlockHeaderSize];
+        std::vector<unsigned char> payload;
+
+        while ( input.read(reinterpret_cast<char*>(blockHeader), sessionBlockHeaderSize) ) {
+
+            payload.resize(static_cast<size_t>(blockHeader[0] | (blockHeader[1] << 8)));
+            if ( !input.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size())) )
+                break;
+
+            DeltaBlockReader reader(payload.data(), payload.size());
+            WireRecord record;
+            while ( reader.next(record) )
+                records.push_back(record);
+        }
+
+        return true;
+    }
+
+    int32_t position[4] { 0 };
+    unsigned char recordBytes[sessionRecordSize];
+
+    while ( input.read(reinterpret_cast<char*>(recordBytes), sessionRecordSize) ) {
+
+        SessionRecord session;
+        decodeSessionRecord(recordBytes, session);
+
+        WireRecord record;
+        record.count = session.count;
+        record.timestamp = session.timestamp;
+        for ( int i = 0; i < 2; i++ ) {
+            position[i] += session.dx[i];
+            position[i+2] += session.dy[i];
+            record.x[i] = position[i];
+            record.y[i] = position[i+2];
+            record.dx[i] = session.dx[i];
+            record.dy[i] = session.dy[i];
+            record.sq[i] = session.sq[i];
+        }
+        record.button = session.button;
+        record.marker = session.marker;
+
+        records.push_back(record);
+    }
+
+    return true;
+}
+
+// "Count; X0; Y0; X1; Y1; SQ0; SQ1[; Timestamp]", the positions as written by the Disk Write mode
+static bool loadCsv( const std::string& name, double rate, std::vector<WireRecord>& records )
+{
+    std::ifstream input(name.c_str());
+
+    if ( !input )
+        return false;
+
+    std::string line;
+    getline(input, line);       // Skip the header
+
+    int32_t previous[4] { 0 };
+
+    while ( getline(input, line) ) {
+
+        std::stringstream row(line);
+        std::string cell;
+        long long fields[8] { 0 };
+        int n = 0;
+
+        while ( n < 8 && getline(row, cell, ';') )
+            fields[n++] = std::atoll(cell.c_str());
+
+        if ( n < 7 )
+            continue;
+
+        WireRecord record;
+        record.count = static_cast<uint32_t>(fields[0]);
+        record.timestamp = ( n == 8 ) ? fields[7] : static_cast<int64_t>(static_cast<double>(records.size()) * 1e9 / rate);
+
+        // X0, X1, Y0, Y1 columns
+        const int order[4] { 1, 3, 2, 4 };
+        int32_t position[4];
+        int delta[4];
+        for ( int i = 0; i < 4; i++ ) {
+            position[i] = static_cast<int32_t>(fields[order[i]]);
+            delta[i] = std::max(-128, std::min(127, static_cast<int>(position[i] - previous[i])));
+            previous[i] = position[i];
+        }
+
+        for ( int i = 0; i < 2; i++ ) {
+            record.x[i] = position[i];
+            record.y[i] = position[i+2];
+            record.dx[i] = static_cast<signed char>(delta[i]);
+            record.dy[i] = static_cast<signed char>(delta[i+2]);
+        }
+
+        record.sq[0] = static_cast<unsigned char>(fields[5]);
+        record.sq[1] = static_cast<unsigned char>(fields[6]);
+
+        records.push_back(record);
+    }
+
+    return !records.empty();
+}
+
+// Walking bouts (smooth motion on both sensors) and pauses, SQ drifting slowly, timestamps with some USB jitter
+static void synthesize( size_t samples, double rate, std::vector<WireRecord>& records )
+{
+    std::mt19937 rng(0x5EED);
+    std::normal_distribution<double> jitter(0.0, 4000.0);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::exponential_distribution<double> bout(1.0 / 1500.0);
+
+    WireRecord record;
+    record.sq[0] = record.sq[1] = 0x30;
+
+    bool walking = false;
+    double heading = 0.0;
+    size_t boutEnd = 0;
+    double period = 1e9 / rate;
+
+    for ( size_t s = 0; s < samples; s++ ) {
+
+        if ( s >= boutEnd ) {
+            walking = !walking;
+            boutEnd = s + 1 + static_cast<size_t>(bout(rng));
+        }
+
+        record.count = static_cast<uint32_t>(s);
+        record.timestamp = static_cast<int64_t>(static_cast<double>(s) * period + jitter(rng));
+
+        for ( int i = 0; i < 2; i++ ) {
+            int dx = 0, dy = 0;
+            if ( walking ) {
+                heading += 0.002 * noise(rng);
+                dx = static_cast<int>(std::lround(3.0 * std::cos(heading) + noise(rng)));
+                dy = static_cast<int>(std::lround(3.0 * std::sin(heading) + noise(rng)));
+            }
+            record.dx[i] = static_cast<signed char>(dx);
+            record.dy[i] = static_cast<signed char>(dy);
+            record.x[i] += dx;
+            record.y[i] += dy;
+
+            if ( rng() % 64 == 0 )
+                record.sq[i] = static_cast<unsigned char>(std::max(0x20, std::min(0x40, record.sq[i] + static_cast<int>(rng() % 3) - 1)));
+        }
+
+        record.marker = ( rng() % 50000 == 0 ) ? 'o' : 0;
+
+        records.push_back(record);
+    }
+}
+
+static bool sameRecord( const WireRecord& a, const WireRecord& b )
+{
+    return a.count == b.count && a.timestamp == b.timestamp && memcmp(a.x, b.x, sizeof(a.x)) == 0
+           && memcmp(a.y, b.y, sizeof(a.y)) == 0 && memcmp(a.dx, b.dx, sizeof(a.dx)) == 0
+           && memcmp(a.dy, b.dy, sizeof(a.dy)) == 0 && memcmp(a.sq, b.sq, sizeof(a.sq)) == 0
+           && a.button == b.button && a.marker == b.marker;
+}
+
+// Encodes the whole session in blocks of 'blockSize' records, decodes it back, and times both (best of a few runs)
+static void measure( const std::string& label, const std::vector<WireRecord>& records, size_t blockSize,
+                     size_t headerSize, size_t plainRecordSize, size_t plainHeaderSize )
+{
+    std::vector<unsigned char> stream;
+    std::vector<size_t> blocks;                 // Offsets
+    DeltaBlockWriter writer(blockSize);
+
+    double encodeNs = 1e30, decodeNs = 1e30;
+
+    for ( int run = 0; run < 5; run++ ) {
+
+        stream.clear();
+        blocks.clear();
+        stream.reserve(records.size() * deltaMaxRecordSize / 4);
+
+        int64_t t0 = monotonicNs();
+
+        for ( size_t r = 0; r < records.size(); r += blockSize ) {
+            writer.clear();
+            size_t end = std::min(records.size(), r + blockSize);
+            for ( size_t k = r; k < end; k++ )
+                writer.append(records[k]);
+
+            blocks.push_back(stream.size());
+            stream.insert(stream.end(), writer.data(), writer.data() + writer.size());
+        }
+
+        int64_t t1 = monotonicNs();
+        encodeNs = std::min(encodeNs, static_cast<double>(t1 - t0) / static_cast<double>(records.size()));
+    }
+
+    blocks.push_back(stream.size());
+
+    size_t mismatches = 0;
+
+    for ( int run = 0; run < 5; run++ ) {
+
+        WireRecord record;
+        size_t index = 0;
+        uint64_t checksum = 0;
+
+        int64_t t0 = monotonicNs();
+
+        for ( size_t b = 0; b + 1 < blocks.size(); b++ ) {
+            DeltaBlockReader reader(&stream[blocks[b]], blocks[b + 1] - blocks[b]);
+            while ( reader.next(record) ) {
+                checksum += record.count;
+                index++;
+            }
+        }
+
+        int64_t t1 = monotonicNs();
+        decodeNs = std::min(decodeNs, static_cast<double>(t1 - t0) / static_cast<double>(records.size()));
+
+        if ( index != records.size() || checksum == 0 )
+            mismatches++;
+    }
+
+    // Then check every field, untimed
+    WireRecord record;
+    size_t index = 0;
+    for ( size_t b = 0; b + 1 < blocks.size(); b++ ) {
+        DeltaBlockReader reader(&stream[blocks[b]], blocks[b + 1] - blocks[b]);
+        while ( reader.next(record) && index < records.size() )
+            if ( !sameRecord(record, records[index++]) )
+                mismatches++;
+    }
+
+    double blockCount = static_cast<double>(blocks.size() - 1);
+    double plain = static_cast<double>(records.size() * plainRecordSize) + blockCount * static_cast<double>(plainHeaderSize);
+    double packed = static_cast<double>(stream.size()) + blockCount * static_cast<double>(headerSize);
+
+    std::cout << "\t" << std::left << std::setw(22) << label << std::right << std::fixed << std::setprecision(2)
+              << packed / static_cast<double>(records.size()) << " B/sample (" << plain / static_cast<double>(records.size()) << " plain), ratio "
+              << plain / packed << ", encode " << std::setprecision(1) << encodeNs << " ns/sample, decode " << decodeNs << " ns/sample"
+              << ( mismatches == 0 ? "" : ", MISMATCH" ) << std::endl;
+}
+
+static void report( const std::string& name, const std::vector<WireRecord>& records, size_t udpBatch )
+{
+    size_t moving = 0;
+    for ( const auto& record : records )
+        if ( record.dx[0] != 0 || record.dx[1] != 0 || record.dy[0] != 0 || record.dy[1] != 0 )
+            moving++;
+
+    std::cout << name << ": " << records.size() << " samples, " << std::fixed << std::setprecision(1)
+              << 100.0 * static_cast<double>(moving) / static_cast<double>(records.size()) << " % with motion" << std::endl;
+
+    measure("Session log", records, sessionBlockRecords, sessionBlockHeaderSize, sessionRecordSize, 0);
+    measure("Datagrams of " + std::to_string(udpBatch), records, udpBatch, wireCompressedHeaderSize, wireRecordSize, wireHeaderSize);
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t samples = 1000000;
+    double rate = 5000.0;
+    size_t udpBatch = 36;
+    std::vector<std::string> files;
+
+    for ( int i = 1; i < argc; ++i ) {
+
+        std::string arg = argv[i];
+
+        if ( (arg == "-h") || (arg == "--help") ) {
+            show_usage(argv[0]);
+            return 0;
+
+        } else if ( (arg == "-n" || arg == "--samples") && i + 1 < argc ) {
+            samples = std::stoul(argv[++i]);
+
+        } else if ( (arg == "--rate") && i + 1 < argc ) {
+            rate = std::stod(argv[++i]);
+
+        } else if ( (arg == "--udp-batch") && i + 1 < argc ) {
+            udpBatch = std::stoul(argv[++i]);
+
+        } else if ( !arg.empty() && arg[0] != '-' ) {
+            files.push_back(arg);
+
+        } else {
+            show_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ( rate <= 0.0 || udpBatch < 1 || udpBatch > 36 ) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    if ( files.empty() ) {
+        std::vector<WireRecord> records;
+        synthesize(samples, rate, records);
+        report("Synthetic session", records, udpBatch);
+        return 0;
+    }
+
+    for ( const auto& file : files ) {
+
+        std::vector<WireRecord> records;
+
+        if ( !loadSession(file, records) && !loadCsv(file, rate, records) ) {
+            std::cerr << "Can't read " << file << std::endl;
+            continue;
+        }
+
+        if ( records.empty() ) {
+            std::cerr << file << " has no samples" << std::endl;
+            continue;
+        }
+
+        report(file, records, udpBatch);
+    }
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+//
+// Created on 17/10/2026.
+//
+
+// Microbenchmark of the CSV row formatting: the former std::stringstream + std::setw path against CsvFormatter.
+// Both format the same pseudo-random samples; the rows are checked to be byte-identical before timing.
+
+#include "../CsvFormatter.h"
+#include "AllocationCounter.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+
+struct Row {
+    int count;
+    int formatted[10];
+    int64_t timestamp;
+};
+
+static void show_usage( std::string name )
+{
+    std::cerr << "Usage: " << name << " <option(s)>\n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message.\n"
+              << "\t-n,--rows N\t\tNumber of rows to format with each method. Default is 1000000\n"
+              << "\t-t,--timestamps\t\tAlso format the timestamp column.\n"
+              << std::endl;
+}
+
+// The row as Trackball::acquire() used to build it
+static std::string streamRow( const Row& row, bool timestamps )
+{
+    std::stringstream txtbuffer;
+
+    txtbuffer << std::setw(7) << row.count << ";"
+              << std::setw(7) << row.formatted[0] << ";"
+              << std::setw(7) << row.formatted[2] << ";"
+              << std::setw(7) << row.formatted[1] << ";"
+              << std::setw(7) << row.formatted[3] << ";"
+              << std::setw(7) << row.formatted[8] << ";"
+              << std::setw(7) << row.formatted[9];
+
+    if ( timestamps )
+        txtbuffer << ";" << std::setw(20) << row.timestamp;
+
+    txtbuffer << std::endl;
+
+    return txtbuffer.str();
+}
+
+template <typename Format>
+static void run( const std::string& name, const std::vector<Row>& rows, Format format )
+{
+    using clock = std::chrono::steady_clock;
+
+    size_t bytes = 0;
+    unsigned long allocationsBefore = allocationCount;
+    auto start = clock::now();
+
+    for ( const auto& row : rows )
+        bytes += format(row);
+
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    unsigned long allocations = allocationCount - allocationsBefore;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << name << ": " << rows.size() << " rows in " << seconds << " s\n"
+              << "\tRate:           " << static_cast<double>(rows.size()) / seconds << " rows/s\n"
+              << "\tPer row:        " << seconds * 1e9 / static_cast<double>(rows.size()) << " ns\n"
+              << "\tBytes:          " << bytes << "\n"
+              << "\tAllocations:    " << static_cast<double>(allocations) / static_cast<double>(rows.size())
+              << " per row" << std::endl;
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t count = 1000000;
+    bool timestamps = false;
+
+    for ( int i = 1; i < argc; ++i ) {
+
+        std::string arg = argv[i];
+
+        if ( (arg == "-h") || (arg == "--help") ) {
+            show_usage(argv[0]);
+            return 0;
+
+        } else if ( ((arg == "-n") || (arg == "--rows")) && i + 1 < argc ) {
+            count = std::stoul(argv[++i]);
+
+        } else if ( (arg == "-t") || (arg == "--timestamps") ) {
+            timestamps = true;
+
+        } else {
+            show_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Integrated positions drift far from 0 over a long session, SQ stays within 0-255
+    std::vector<Row> rows(count);
+    uint32_t state = 0x5EED;
+    int position[4] { 0 };
+
+    for ( size_t k = 0; k < count; k++ ) {
+
+        Row& row = rows[k];
+        row.count = static_cast<int>(k);
+        row.timestamp = 1000000000LL + static_cast<int64_t>(k) * 1000;
+
+        for ( int i = 0; i < 4; i++ ) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            position[i] += static_cast<int>(state % 255) - 127;
+            row.formatted[i] = position[i];
+        }
+        row.formatted[8] = static_cast<int>(state & 0xFF);
+        row.formatted[9] = static_cast<int>((state >> 8) & 0xFF);
+    }
+
+    // Same bytes, or the comparison is meaningless
+    CsvFormatter formatter;
+
+    for ( const auto& row : rows ) {
+        formatter.sampleRow(row.count, row.formatted, timestamps, row.timestamp);
+        if ( streamRow(row, timestamps) != std::string(formatter.data(), formatter.size()) ) {
+            std::cerr << "Rows differ at count " << row.count << std::endl;
+            return 1;
+        }
+    }
+
+    run("std::stringstream", rows, [timestamps]( const Row& row ) {
+        return streamRow(row, timestamps).size();
+    });
+
+    run("CsvFormatter", rows, [&formatter, timestamps]( const Row& row ) {
+        formatter.sampleRow(row.count, row.formatted, timestamps, row.timestamp);
+        return formatter.size();
+    });
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+//
+// Created on 17/10/2026.
+//
+
+// Cross-process latency of the shared memory ring: this process publishes samples at a fixed rate,
+// and reader processes (forked, so really in another address space) measure the time between the
+// publication of each sample and the moment they read it, either spinning on the ring or sleeping on its futex.
+
+#include "../SharedRing.h"
+#include "../Histogram.h"
+#include "../Clock.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+static void show_usage( std::string name )
+{
+    std::cerr << "Usage: " << name << " <option(s)>\n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message.\n"
+              << "\t-n,--samples N\t\tNumber of samples to publish. Default is 50000\n"
+              << "\t--rate HZ\t\tPublication rate. Default is 5000\n"
+              << "\t--mode MODE\t\tReaders poll, wait (futex), or both (one of each). Default is both. Each polling reader needs a core of its own\n"
+              << "\t--readers K\t\tNumber of readers of each kind. Default is 1\n"
+              << "\t--name NAME\t\tShared memory name. Default is /trackball-benchmark\n"
+              << std::endl;
+}
+
+// Runs in the child process
+static int readerProcess( const std::string& name, bool waiting, int ready )
+{
+    SharedRingReader reader;
+
+    int r = reader.open(name, waiting);
+
+    // Tell the producer we're in, even if open() failed (it must not wait for us forever)
+    char status = ( r == 0 ) ? 1 : 0;
+    if ( write(ready, &status, 1) != 1 || r != 0 )
+        return 1;
+    close(ready);
+
+    Histogram latency;
+    std::vector<Sample> samples(256);
+    std::vector<int64_t> publishTimes(256);
+    uint64_t received = 0;
+
+    while ( true ) {
+
+        size_t n = reader.read(samples.data(), samples.size(), publishTimes.data());
+        int64_t now = monotonicNs();
+
+        for ( size_t i = 0; i < n; i++ )
+            latency.record(now - publishTimes[i]);
+        received += n;
+
+        if ( n > 0 )
+            continue;
+
+        if ( !reader.producerAlive() ) {
+            // Whatever was published just before the producer left
+            if ( reader.available() == 0 )
+                break;
+            continue;
+        }
+
+        if ( waiting )
+            reader.wait(100000000);
+    }
+
+    std::string label = std::string(waiting ? "futex wait" : "polling") + " reader (pid " + std::to_string(getpid()) + ")";
+    latency.print(label, false);
+    std::cout << "\t" << received << " samples, " << reader.dropped() << " lost" << std::endl;
+
+    return 0;
+}
+
+int main( int argc, char* argv[] )
+{
+    unsigned long samples = 50000;
+    double rate = 5000.0;
+    std::string mode = "both";
+    int readers = 1;
+    std::string name = "/trackball-benchmark";
+
+    for ( int i = 1; i < argc; ++i ) {
+
+        std::string arg = argv[i];
+
+        if ( (arg == "-h") || (arg == "--help") ) {
+            show_usage(argv[0]);
+            return 0;
+
+        } else if ( (arg == "-n" || arg == "--samples") && i + 1 < argc ) {
+            samples = std::stoul(argv[++i]);
+
+        } else if ( (arg == "--rate") && i + 1 < argc ) {
+            rate = std::stod(argv[++i]);
+
+        } else if ( (arg == "--mode") && i + 1 < argc ) {
+            mode = argv[++i];
+
+        } else if ( (arg == "--readers") && i + 1 < argc ) {
+            readers = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--name") && i + 1 < argc ) {
+            name = argv[++i];
+
+        } else {
+            show_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ( rate <= 0.0 || readers < 1 || ( mode != "poll" && mode != "wait" && mode != "both" ) ) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    SharedRingWriter writer;
+    if ( writer.create(name) != 0 )
+        return 1;
+
+    std::vector<bool> kinds;
+    for ( int k = 0; k < readers; k++ ) {
+        if ( mode != "wait" )
+            kinds.push_back(false);
+        if ( mode != "poll" )
+            kinds.push_back(true);
+    }
+
+    std::vector<pid_t> children;
+
+    for ( bool waiting : kinds ) {
+
+        int ready[2];
+        if ( pipe(ready) != 0 )
+            return 1;
+
+        pid_t pid = fork();
+
+        if ( pid == 0 ) {
+            close(ready[0]);
+            _exit(readerProcess(name, waiting, ready[1]));
+        }
+
+        close(ready[1]);
+
+        char status = 0;
+        if ( pid < 0 || read(ready[0], &status, 1) != 1 || status != 1 ) {
+            std::cerr << "A reader failed to start." << std::endl;
+            return 1;
+        }
+        close(ready[0]);
+
+        children.push_back(pid);
+    }
+
+    std::cout << "Publishing " << samples << " samples at " << rate << " Hz to " << kinds.size() << " readers" << std::endl;
+
+    // Busy-wait between samples: sleeping would add the scheduler's wake-up jitter to the producer side
+    int64_t period = static_cast<int64_t>(1e9 / rate);
+    int64_t next = monotonicNs();
+
+    Sample sample;
+
+    for ( unsigned long s = 0; s < samples; s++ ) {
+
+        while ( monotonicNs() < next ) { }
+        next += period;
+
+        sample.count = static_cast<int>(s);
+        sample.timestamp = monotonicNs();
+        writer.publish(sample);
+    }
+
+    writer.close();
+
+    int failures = 0;
+    for ( pid_t pid : children ) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if ( !WIFEXITED(status) || WEXITSTATUS(status) != 0 )
+            failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+//
+// Created on 17/10/2026.
+//
+
+// The output sinks with the blocking calls (writev() on the writer thread, sendmmsg() inline) against io_uring,
+// at 1, 5 and 10 kHz: the same work as Trackball::acquire() does per sample (CSV row and binary record to the
+// disk writer, a datagram to the network), paced like the async polling, timed on the producer thread.
+// A local thread receives the datagrams, so the network stack does all of its work.
+
+#include "../DiskWriter.h"
+#include "../NetworkSink.h"
+#include "../CsvFormatter.h"
+#include "../SessionLog.h"
+#include "../Histogram.h"
+#include "../Clock.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+
+static void show_usage( std::string name )
+{
+    std::cerr << "Usage: " << name << " <option(s)>\n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message.\n"
+              << "\t-s,--seconds S\t\tDuration of each run. Default is 3\n"
+              << "\t-r,--rate HZ\t\tOnly run at this rate. Default is 1000, 5000 and 10000\n"
+              << "\t-w,--write PATH\t\tFolder of the output files. Default is /tmp\n"
+              << "\t--udp-batch N\t\tN decoded samples per datagram. Default is one raw sample per datagram\n"
+              << "\t--udp-port PORT\t\tLocal port of the receiver. Default is 45945\n"
+              << std::endl;
+}
+
+static double cpuSeconds()
+{
+    rusage usage { };
+    getrusage(RUSAGE_SELF, &usage);
+
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+           + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void run( bool ioUring, double rate, double seconds, const std::string& path, int udpBatch, const std::string& port )
+{
+    DiskWriter disk;
+    disk.setIoUring(ioUring);
+
+    int dataA = disk.open(path + "/sinkBenchmark.csv");
+    int dataB = disk.open(path + "/sinkBenchmark.tbs");
+    if ( dataA < 0 || dataB < 0 ) {
+        std::cout << "Can't write in " << path << std::endl;
+        return;
+    }
+    disk.start();
+
+    NetworkSink network;
+    if ( udpBatch > 0 )
+        network.setBatching(udpBatch, 1, std::chrono::microseconds(1000));
+    if ( network.open("127.0.0.1", port) != 0 )
+        return;
+    if ( ioUring )
+        network.setIoUring(true);
+
+    std::cout << ( ioUring ? "io_uring" : "blocking" ) << " at " << static_cast<int>(rate) << " Hz" << std::endl;
+
+    Histogram latency;
+    CsvFormatter row;
+    SessionRecord record;
+    unsigned char recordBytes[sessionRecordSize];
+    unsigned char raw[8] { 0 };
+    int formatted[10] { 0 };
+
+    auto period = std::chrono::nanoseconds(static_cast<int64_t>(1e9 / rate));
+    auto next = std::chrono::steady_clock::now();
+    auto end = next + std::chrono::nanoseconds(static_cast<int64_t>(seconds * 1e9));
+    double cpuBefore = cpuSeconds();
+    int count = 0;
+
+    // Paced with sleeps, like the async polling: the writer thread and the network stack get the CPU in between
+    while ( next < end ) {
+
+        std::this_thread::sleep_until(next);
+        next += period;
+
+        int64_t timestamp = monotonicNs();
+        count++;
+        formatted[0] += count % 7 - 3;
+        formatted[2] += count % 5 - 2;
+
+        int64_t t0 = monotonicNs();
+
+        row.sampleRow(count, formatted, true, timestamp);
+        disk.append(dataA, row.data(), row.size());
+
+        record.count = static_cast<uint32_t>(count);
+        record.timestamp = timestamp;
+        encodeSessionRecord(record, recordBytes);
+        disk.append(dataB, recordBytes, sessionRecordSize);
+
+        if ( udpBatch > 0 ) {
+            WireRecord wire;
+            wire.count = static_cast<uint32_t>(count);
+            wire.timestamp = timestamp;
+            wire.x[0] = formatted[0];
+            wire.y[0] = formatted[2];
+            network.poll();
+            network.append(wire);
+        } else {
+            raw[0] = static_cast<unsigned char>(count);
+            network.sendRaw(raw, sizeof(raw));
+        }
+
+        latency.record(monotonicNs() - t0);
+    }
+
+    double cpu = cpuSeconds() - cpuBefore;
+
+    network.close();
+    disk.close();
+
+    latency.print("\tPer sample (producer)");
+    std::cout << "\tCPU:            " << std::fixed << std::setprecision(1) << 100.0 * cpu / seconds << " % of a core (all threads)" << std::endl;
+    std::cout << "\t";
+    disk.printStats();
+    std::cout << "\t";
+    network.printStats();
+}
+
+int main( int argc, char* argv[] )
+{
+    double seconds = 3.0;
+    std::vector<double> rates { 1000.0, 5000.0, 10000.0 };
+    std::string path = "/tmp";
+    int udpBatch = 0;
+    std::string port = "45945";
+
+    for ( int i = 1; i < argc; ++i ) {
+
+        std::string arg = argv[i];
+
+        if ( (arg == "-h") || (arg == "--help") ) {
+            show_usage(argv[0]);
+            return 0;
+
+        } else if ( (arg == "-s" || arg == "--seconds") && i + 1 < argc ) {
+            seconds = std::stod(argv[++i]);
+
+        } else if ( (arg == "-r" || arg == "--rate") && i + 1 < argc ) {
+            rates = { std::stod(argv[++i]) };
+
+        } else if ( (arg == "-w" || arg == "--write") && i + 1 < argc ) {
+            path = argv[++i];
+
+        } else if ( (arg == "--udp-batch") && i + 1 < argc ) {
+            udpBatch = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--udp-port") && i + 1 < argc ) {
+            port = argv[++i];
+
+        } else {
+            show_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // The receiver: drains the socket so the sends never hit a full buffer
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    sockaddr_in address = { };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(std::stoi(port)));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    timeval timeout { 0, 100000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if ( bind(sock, (sockaddr*)&address, sizeof(address)) != 0 ) {
+        std::cerr << "Can't listen on port " << port << std::endl;
+        return 1;
+    }
+
+    std::atomic<bool> receiving { true };
+    std::thread receiver([sock, &receiving]() {
+        unsigned char buffer[2048];
+        while ( receiving )
+            recv(sock, buffer, sizeof(buffer), 0);
+    });
+
+    for ( double rate : rates )
+        for ( bool ioUring : { false, true } )
+            run(ioUring, rate, seconds, path, udpBatch, port);
+
+    receiving = false;
+    receiver.join();
+    close(sock);
+
+    unlink((path + "/sinkBenchmark.csv").c_str());
+    unlink((path + "/sinkBenchmark.tbs").c_str());
+
+    return 0;
+}
@@ -0,0 +1,248 @@
+//
+// Created on 17/10/2026.
+//
+
+// Freeball path integration (TrajectoryEngine.h) over hour-long sessions: the vectorised batch kernel against the
+// scalar loop the trace used to run, in samples per second, and how far apart their paths end up.
+// Sessions are binary session logs (.tbs, compressed or not), integrated once. Without a file, one minute of
+// synthetic walking (bouts of walking and of standing still, the heading drifting) is replayed for the whole duration.
+
+#include "../TrajectoryEngine.h"
+#include "../DeltaCodec.h"
+#include "../SessionLog.h"
+#include "../Clock.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+
+static void show_usage( std::string name )
+{
+    std::cerr << "Usage: " << name << " <option(s)> [SESSION.tbs ...]\n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message.\n"
+              << "\t--duration S\t\tLength of the synthetic session, in seconds. Default is 3600\n"
+              << "\t--rate HZ\t\tSample rate of the synthetic session. Default is 10000\n"
+              << "\t--chunk N\t\tSamples per integrate() call (the trace passes what it drained in a frame). Default is 4096\n"
+              << std::endl;
+}
+
+// The sensor deltas, one array per field
+struct Deltas {
+    std::vector<int> dx0, dx1, dy0, dy1;
+
+    void push( int a, int b, int c, int d ) {
+        dx0.push_back(a);
+        dx1.push_back(b);
+        dy0.push_back(c);
+        dy1.push_back(d);
+    }
+
+    size_t size() const { return dx0.size(); }
+};
+
+// Binary session log, plain or compressed. Marker records carry no motion and are left out
+static bool loadSession( const std::string& name, Deltas& deltas, double calibration[2] )
+{
+    std::ifstream input(name.c_str(), std::ios::binary);
+
+    unsigned char headerBytes[sessionHeaderSize];
+    SessionHeader header;
+
+    if ( !input.read(reinterpret_cast<char*>(headerBytes), sessionHeaderSize) || decodeSessionHeader(headerBytes, header) != 0 )
+        return false;
+
+    for ( int i = 0; i < 2; i++ )
+        if ( header.calibration[i] > 0.0 )
+            calibration[i] = header.calibration[i];
+
+    if ( header.compressed ) {
+
+        unsigned char blockHeader[sessionBlockHeaderSize];
+        std::vector<unsigned char> payload;
+
+        while ( input.read(reinterpret_cast<char*>(blockHeader), sessionBlockHeaderSize) ) {
+
+            payload.resize(static_cast<size_t>(blockHeader[0] | (blockHeader[1] << 8)));
+            if ( !input.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size())) )
+                break;
+
+            DeltaBlockReader reader(payload.data(), payload.size());
+            WireRecord record;
+            while ( reader.next(record) )
+                if ( record.marker == 0 )
+                    deltas.push(record.dx[0], record.dx[1], record.dy[0], record.dy[1]);
+        }
+
+        return true;
+    }
+
+    unsigned char recordBytes[sessionRecordSize];
+
+    while ( input.read(reinterpret_cast<char*>(recordBytes), sessionRecordSize) ) {
+
+        SessionRecord record;
+        decodeSessionRecord(recordBytes, record);
+
+        if ( record.marker == 0 )
+            deltas.push(record.dx[0], record.dx[1], record.dy[0], record.dy[1]);
+    }
+
+    return true;
+}
+
+// Walking bouts (forward on both sensors, turning a little) and pauses
+static void synthesize( size_t samples, Deltas& deltas )
+{
+    std::mt19937 rng(0x5EED);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::exponential_distribution<double> bout(1.0 / 3000.0);
+
+    bool walking = false;
+    double turning = 0.0;
+    size_t boutEnd = 0;
+
+    for ( size_t s = 0; s < samples; s++ ) {
+
+        if ( s >= boutEnd ) {
+            walking = !walking;
+            boutEnd = s + 1 + static_cast<size_t>(bout(rng));
+        }
+
+        if ( !walking ) {
+            deltas.push(0, 0, 0, 0);
+            continue;
+        }
+
+        turning = 0.99 * turning + 0.05 * noise(rng);
+        deltas.push(static_cast<int>(std::lround(turning + 0.3 * noise(rng))),
+                    static_cast<int>(std::lround(turning + 0.3 * noise(rng))),
+                    static_cast<int>(std::lround(4.0 + noise(rng))),
+                    static_cast<int>(std::lround(4.0 + noise(rng))));
+    }
+}
+
+// Integrates 'total' samples (replaying the deltas as many times as needed) in chunks, like the trace does
+template <typename Integrate>
+static double run( const Deltas& deltas, size_t total, size_t chunk, Integrate integrate )
+{
+    std::vector<double> heading(chunk), x(chunk), y(chunk);
+
+    int64_t t0 = monotonicNs();
+
+    for ( size_t done = 0; done < total; ) {
+
+        size_t offset = done % deltas.size();
+        size_t n = std::min({ chunk, total - done, deltas.size() - offset });
+
+        integrate(&deltas.dx0[offset], &deltas.dx1[offset], &deltas.dy0[offset], &deltas.dy1[offset], n,
+                  heading.data(), x.data(), y.data());
+        done += n;
+    }
+
+    int64_t t1 = monotonicNs();
+
+    return static_cast<double>(t1 - t0) * 1e-9;
+}
+
+static void report( const std::string& name, const Deltas& deltas, size_t total, size_t chunk, const double calibration[2] )
+{
+    TrajectoryEngine scalar(calibration[0], calibration[1]);
+    TrajectoryEngine batch(calibration[0], calibration[1]);
+
+    double scalarSeconds = run(deltas, total, chunk, [&scalar]( const int *a, const int *b, const int *c, const int *d, size_t n,
+                                                               double *h, double *x, double *y ) {
+        scalar.integrateScalar(a, b, c, d, n, h, x, y);
+    });
+
+    double batchSeconds = run(deltas, total, chunk, [&batch]( const int *a, const int *b, const int *c, const int *d, size_t n,
+                                                             double *h, double *x, double *y ) {
+        batch.integrate(a, b, c, d, n, h, x, y);
+    });
+
+    double headingError = std::fabs(batch.getHeading() - scalar.getHeading());
+    headingError = std::min(headingError, 2.0 * M_PI - headingError);
+
+    std::cout << name << ": " << total << " samples, path ends " << std::fixed << std::setprecision(1)
+              << std::hypot(scalar.getX(), scalar.getY()) / 1000.0 << " m from the start" << std::endl;
+
+    std::cout << "\tScalar loop:    " << std::setprecision(1) << static_cast<double>(total) / scalarSeconds / 1e6 << " M samples/s ("
+              << scalarSeconds << " s)" << std::endl;
+    std::cout << "\tBatch kernel:   " << static_cast<double>(total) / batchSeconds / 1e6 << " M samples/s ("
+              << batchSeconds << " s), x" << std::setprecision(2) << scalarSeconds / batchSeconds << std::endl;
+    std::cout << "\tDivergence:     " << std::scientific << std::setprecision(2)
+              << std::hypot(batch.getX() - scalar.getX(), batch.getY() - scalar.getY()) << " mm, "
+              << headingError << " rad" << std::defaultfloat << std::endl;
+}
+
+int main( int argc, char* argv[] )
+{
+    double duration = 3600.0;
+    double rate = 10000.0;
+    size_t chunk = 4096;
+    std::vector<std::string> files;
+
+    for ( int i = 1; i < argc; ++i ) {
+
+        std::string arg = argv[i];
+
+        if ( (arg == "-h") || (arg == "--help") ) {
+            show_usage(argv[0]);
+            return 0;
+
+        } else if ( (arg == "--duration") && i + 1 < argc ) {
+            duration = std::stod(argv[++i]);
+
+        } else if ( (arg == "--rate") && i + 1 < argc ) {
+            rate = std::stod(argv[++i]);
+
+        } else if ( (arg == "--chunk") && i + 1 < argc ) {
+            chunk = std::stoul(argv[++i]);
+
+        } else if ( !arg.empty() && arg[0] != '-' ) {
+            files.push_back(arg);
+
+        } else {
+            show_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ( duration <= 0.0 || rate <= 0.0 || chunk < 1 ) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    if ( files.empty() ) {
+        Deltas deltas;
+        double calibration[2] { 1000.0, 1000.0 };
+        synthesize(static_cast<size_t>(std::min(duration, 60.0) * rate), deltas);
+        report("Synthetic session", deltas, static_cast<size_t>(duration * rate), chunk, calibration);
+        return 0;
+    }
+
+    for ( const auto& file : files ) {
+
+        Deltas deltas;
+        double calibration[2] { 1000.0, 1000.0 };
+
+        if ( !loadSession(file, deltas, calibration) ) {
+            std::cerr << "Can't read " << file << std::endl;
+            continue;
+        }
+
+        if ( deltas.size() == 0 ) {
+            std::cerr << file << " has no samples" << std::endl;
+            continue;
+        }
+
+        report(file, deltas, deltas.size(), chunk, calibration);
+    }
+
+    return 0;
+}
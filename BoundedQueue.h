@@ -0,0 +1,126 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_BOUNDEDQUEUE_H
+#define TRACKBALLCONTROL_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+
+// Fixed-capacity FIFO between threads, with blocking and non-blocking ends, for the camera pipeline's frames
+// (tens per second: a mutex is cheap there, unlike on the sample path). Never allocates after construction.
+// close() wakes everyone up: pushes fail from then on, and pops fail once the queue is drained.
+template <typename T>
+class BoundedQueue {
+
+public:
+
+    explicit BoundedQueue( size_t capacity ) : items(capacity) { }
+
+    // Waits while the queue is full. false if it is closed
+    bool push( const T& item ) {
+
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return count < items.size() || closed; });
+
+        return insert(item, lock);
+    }
+
+    // false if the queue is full or closed
+    bool tryPush( const T& item ) {
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if ( count == items.size() )
+            return false;
+
+        return insert(item, lock);
+    }
+
+    // Waits while the queue is empty. false once it is closed and drained
+    bool pop( T& item ) {
+
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return count > 0 || closed; });
+
+        return remove(item, lock);
+    }
+
+    // false if the queue is empty
+    bool tryPop( T& item ) {
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        return remove(item, lock);
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    // Empties and reopens the queue. Only when no thread uses it
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        head = 0;
+        count = 0;
+        closed = false;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+private:
+
+    bool insert( const T& item, std::unique_lock<std::mutex>& lock ) {
+
+        if ( closed )
+            return false;
+
+        items[(head + count) % items.size()] = item;
+        count++;
+
+        lock.unlock();
+        notEmpty.notify_one();
+
+        return true;
+    }
+
+    bool remove( T& item, std::unique_lock<std::mutex>& lock ) {
+
+        if ( count == 0 )
+            return false;
+
+        item = items[head];
+        head = (head + 1) % items.size();
+        count--;
+
+        lock.unlock();
+        notFull.notify_one();
+
+        return true;
+    }
+
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+    std::vector<T> items;
+    size_t head = 0;
+    size_t count = 0;
+    bool closed = false;
+
+};
+
+
+#endif //TRACKBALLCONTROL_BOUNDEDQUEUE_H
@@ -0,0 +1,23 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_CLOCK_H
+#define TRACKBALLCONTROL_CLOCK_H
+
+#include <cstdint>
+#include <ctime>
+
+
+// Host timestamps of the samples: CLOCK_MONOTONIC_RAW is never stepped nor slewed by NTP,
+// so differences between two samples are real elapsed time
+inline int64_t monotonicNs() {
+
+    timespec ts { };
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+
+#endif //TRACKBALLCONTROL_CLOCK_H
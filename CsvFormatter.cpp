@@ -0,0 +1,62 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "CsvFormatter.h"
+#include <charconv>
+#include <cstring>
+
+
+void CsvFormatter::clear() {
+    length = 0;
+}
+
+void CsvFormatter::field( int64_t value, int width ) {
+
+    if ( length > 0 )
+        buffer[length++] = ';';
+
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    auto n = static_cast<size_t>(result.ptr - digits);
+
+    // Pad on the left like std::setw, never truncate
+    size_t padding = ( n < static_cast<size_t>(width) ) ? static_cast<size_t>(width) - n : 0;
+
+    memset(buffer + length, ' ', padding);
+    memcpy(buffer + length + padding, digits, n);
+    length += padding + n;
+}
+
+void CsvFormatter::endRow() {
+    buffer[length++] = '\n';
+}
+
+void CsvFormatter::sampleRow( int count, const int *formatted, bool withTimestamp, int64_t timestamp ) {
+
+    // ------------------------ formattedBuffer -------------------------
+    // |  0  |  1  |  2  |  3  |  4  |  5  |  6  |  7  |  8  |  9  |
+    // |  X0 |  X1 |  Y0 |  Y1 | DX0 | DX1 | DY0 | DY1 | SQ0 | SQ0 |
+
+    clear();
+    field(count);
+    field(formatted[0]);
+    field(formatted[2]);
+    field(formatted[1]);
+    field(formatted[3]);
+    field(formatted[8]);
+    field(formatted[9]);
+
+    if ( withTimestamp )
+        field(timestamp, timestampWidth);
+
+    endRow();
+}
+
+const char* CsvFormatter::data() const {
+    return buffer;
+}
+
+size_t CsvFormatter::size() const {
+    return length;
+}
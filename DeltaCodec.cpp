@@ -0,0 +1,170 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "DeltaCodec.h"
+#include <cstring>
+
+
+// Little-endian helpers, like the ones of WireProtocol.cpp
+static void putU16( unsigned char *p, uint16_t v ) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+}
+
+static void putU32( unsigned char *p, uint32_t v ) {
+    for ( int i = 0; i < 4; i++ )
+        p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+
+DeltaBlockWriter::DeltaBlockWriter( size_t maxRecords ) :
+    buffer(maxRecords * deltaMaxRecordSize),
+    maxRecords(maxRecords) {
+}
+
+void DeltaBlockWriter::append( const WireRecord& record ) {
+
+    unsigned char *p = &buffer[length];
+
+    if ( count == 0 ) {
+
+        *p++ = deltaKeyframe;
+        p += putVarint(record.count, p);
+        p += putVarint(static_cast<uint64_t>(record.timestamp), p);
+        for ( int i = 0; i < 2; i++ )
+            p += putVarint(zigzag(record.x[i]), p);
+        for ( int i = 0; i < 2; i++ )
+            p += putVarint(zigzag(record.y[i]), p);
+        for ( int i = 0; i < 2; i++ )
+            p += putVarint(zigzag(record.dx[i]), p);
+        for ( int i = 0; i < 2; i++ )
+            p += putVarint(zigzag(record.dy[i]), p);
+        *p++ = record.sq[0];
+        *p++ = record.sq[1];
+        *p++ = record.button;
+        *p++ = record.marker;
+
+        interval = 0;
+        runTag = 0;
+
+    } else {
+
+        // Everything wraps like the decoder does, so any input comes back exactly
+        int32_t countStep = static_cast<int32_t>(record.count - previous.count - 1);
+        int64_t newInterval = static_cast<int64_t>(static_cast<uint64_t>(record.timestamp) - static_cast<uint64_t>(previous.timestamp));
+        int64_t intervalChange = static_cast<int64_t>(static_cast<uint64_t>(newInterval) - static_cast<uint64_t>(interval));
+
+        bool moved = record.dx[0] != 0 || record.dx[1] != 0 || record.dy[0] != 0 || record.dy[1] != 0;
+        bool sqChanged = record.sq[0] != previous.sq[0] || record.sq[1] != previous.sq[1];
+
+        int32_t correction[4];
+        bool corrected = false;
+        for ( int i = 0; i < 2; i++ ) {
+            correction[i] = static_cast<int32_t>(static_cast<uint32_t>(record.x[i]) - static_cast<uint32_t>(previous.x[i])
+                                                 - static_cast<uint32_t>(static_cast<int32_t>(record.dx[i])));
+            correction[i+2] = static_cast<int32_t>(static_cast<uint32_t>(record.y[i]) - static_cast<uint32_t>(previous.y[i])
+                                                   - static_cast<uint32_t>(static_cast<int32_t>(record.dy[i])));
+        }
+        for ( int32_t c : correction )
+            corrected |= c != 0;
+
+        bool idle = countStep == 0 && !moved && !sqChanged && record.button == previous.button && record.marker == 0 && !corrected;
+
+        if ( idle ) {
+
+            // Joins the open run if there's room left in it, the run's tag counts the records
+            if ( runTag != 0 && (buffer[runTag] & 0x3F) < 0x3F ) {
+                buffer[runTag]++;
+            } else {
+                runTag = length;
+                *p++ = deltaRun;
+            }
+            p += putVarint(zigzag(intervalChange), p);
+
+        } else {
+
+            runTag = 0;
+
+            unsigned char *flags = p++;
+            *flags = 0;
+
+            if ( countStep != 0 ) {
+                *flags |= 0x10;
+                p += putVarint(zigzag(countStep), p);
+            }
+            if ( intervalChange != 0 ) {
+                *flags |= 0x20;
+                p += putVarint(zigzag(intervalChange), p);
+            }
+            if ( moved ) {
+                *flags |= 0x01;
+                for ( int i = 0; i < 2; i++ )
+                    p += putVarint(zigzag(record.dx[i]), p);
+                for ( int i = 0; i < 2; i++ )
+                    p += putVarint(zigzag(record.dy[i]), p);
+            }
+            if ( sqChanged ) {
+                *flags |= 0x02;
+                for ( int i = 0; i < 2; i++ )
+                    p += putVarint(zigzag(record.sq[i] - previous.sq[i]), p);
+            }
+            if ( record.button != previous.button ) {
+                *flags |= 0x04;
+                *p++ = record.button;
+            }
+            if ( record.marker != 0 ) {
+                *flags |= 0x08;
+                *p++ = record.marker;
+            }
+            if ( corrected ) {
+                *flags |= 0x40;
+                for ( int32_t c : correction )
+                    p += putVarint(zigzag(c), p);
+            }
+        }
+
+        interval = newInterval;
+    }
+
+    previous = record;
+    length = static_cast<size_t>(p - buffer.data());
+    count++;
+}
+
+void DeltaBlockWriter::clear() {
+    length = 0;
+    count = 0;
+    runTag = 0;
+}
+
+bool DeltaBlockWriter::full() const {
+    return count >= maxRecords;
+}
+
+size_t DeltaBlockWriter::records() const {
+    return count;
+}
+
+size_t DeltaBlockWriter::size() const {
+    return length;
+}
+
+const unsigned char* DeltaBlockWriter::data() const {
+    return buffer.data();
+}
+
+
+void encodeCompressedHeader( uint32_t streamId, uint16_t recordCount, uint32_t firstSequence, uint16_t payloadSize,
+                             unsigned char *buffer ) {
+
+    memset(buffer, 0, wireCompressedHeaderSize);
+
+    memcpy(buffer, "TBWC", 4);
+    buffer[4] = wireCompressedVersion;
+    buffer[5] = static_cast<unsigned char>(wireCompressedHeaderSize);
+    putU16(buffer + 6, payloadSize);
+    putU32(buffer + 8, streamId);
+    putU16(buffer + 12, recordCount);
+    putU32(buffer + 16, firstSequence);
+}
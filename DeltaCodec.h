@@ -0,0 +1,361 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_DELTACODEC_H
+#define TRACKBALLCONTROL_DELTACODEC_H
+
+#include "WireProtocol.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+
+// Compressed sample stream, for bandwidth-constrained links and smaller session logs.
+//
+// The samples come in blocks. A block starts with a keyframe, the whole record with its absolute count, timestamp
+// and positions, so every block decodes on its own (a lost datagram or a damaged block loses nothing else).
+// The other records only hold what changed since the previous one, as zigzag LEB128 varints ("zz" below):
+//
+// ---------------------------------------------- Records ----------------------------------------------
+// | 0xFF keyframe | count varint | timestamp varint | X0 X1 Y0 Y1 zz | DX0 DX1 DY0 DY1 zz | SQ0 SQ1 button marker u8 |
+// | 0x00-0x7F delta record: the flags tell which fields follow, in this order
+// |     0x10 count step zz                     (else count + 1)
+// |     0x20 interval change zz                (else the same interval as the previous record)
+// |     0x01 DX0 DX1 DY0 DY1 zz                (else 0)
+// |     0x02 SQ0 SQ1 change zz                 (else unchanged)
+// |     0x04 button u8                         (else unchanged)
+// |     0x08 marker u8                         (else 0)
+// |     0x40 X0 X1 Y0 Y1 correction zz         (else X += DX and Y += DY)
+// | 0x80-0xBF idle run of (tag & 0x3F) + 1 records: no motion, same SQ and button, no marker, count + 1,
+// |     each one followed by its interval change zz
+// | 0xC0-0xFE reserved
+//
+// The interval is the time since the previous record; its change is what's left of the USB timing jitter
+// (and 0 for the records of a batch, which share their packet's timestamp). A moving sample takes 5 to 8 bytes,
+// an idle one 1 to 3, instead of 20 in the session log and 40 on the wire. Sequence numbers aren't coded:
+// the records of a block are consecutive, the first one's is in the datagram header.
+
+constexpr size_t deltaMaxRecordSize = 50;           // Worst case of one record, for sizing the buffers
+const unsigned char deltaKeyframe = 0xFF;
+const unsigned char deltaRun = 0x80;
+
+inline uint64_t zigzag( int64_t v ) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t unzigzag( uint64_t v ) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+inline size_t putVarint( uint64_t v, unsigned char *p ) {
+
+    size_t n = 0;
+    while ( v >= 0x80 ) {
+        p[n++] = static_cast<unsigned char>(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = static_cast<unsigned char>(v);
+
+    return n;
+}
+
+
+// Encodes one block, record after record, into its own buffer
+class DeltaBlockWriter {
+
+public:
+
+    explicit DeltaBlockWriter( size_t maxRecords = 256 );
+
+    void append( const WireRecord& record );        // The first record of a block is the keyframe
+    void clear();                                   // Starts a new block
+
+    bool full() const;
+    size_t records() const;
+    size_t size() const;                            // Bytes
+    const unsigned char* data() const;
+
+private:
+
+    std::vector<unsigned char> buffer;
+    size_t length = 0;
+    size_t count = 0;
+    size_t maxRecords;
+
+    WireRecord previous;
+    int64_t interval = 0;
+    size_t runTag = 0;                              // Offset of the open idle run's tag (0 = none: it's the keyframe's)
+
+};
+
+
+// Reference decoder of one block, header-only like the one in WireProtocol.h. No allocation
+class DeltaBlockReader {
+
+public:
+
+    DeltaBlockReader( const unsigned char *data, size_t length ) : p(data), end(data + length) { }
+
+    // false at the end of the block, or if it is malformed (then error() is true)
+    bool next( WireRecord& record ) {
+
+        if ( runLeft > 0 ) {
+            runLeft--;
+            return idle(record);
+        }
+
+        if ( p >= end || failed )
+            return false;
+
+        unsigned char tag = *p++;
+
+        // Nothing means anything before the keyframe
+        if ( !started && tag != deltaKeyframe )
+            return fail();
+
+        if ( tag == deltaKeyframe )
+            return keyframe(record);
+
+        if ( (tag & 0xC0) == deltaRun ) {
+            runLeft = tag & 0x3F;
+            return idle(record);
+        }
+
+        if ( tag & 0x80 )
+            return fail();
+
+        return delta(tag, record);
+    }
+
+    bool error() const { return failed; }
+
+private:
+
+    bool fail() {
+        failed = true;
+        return false;
+    }
+
+    bool varint( uint64_t& v ) {
+
+        v = 0;
+        for ( int shift = 0; shift < 64 && p < end; shift += 7 ) {
+            unsigned char byte = *p++;
+            v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ( !(byte & 0x80) )
+                return true;
+        }
+
+        return false;
+    }
+
+    bool signedVarint( int64_t& v ) {
+
+        uint64_t u;
+        if ( !varint(u) )
+            return false;
+
+        v = unzigzag(u);
+
+        return true;
+    }
+
+    bool keyframe( WireRecord& record ) {
+
+        uint64_t count, timestamp;
+        int64_t fields[8];
+
+        if ( !varint(count) || !varint(timestamp) )
+            return fail();
+        for ( int64_t& field : fields )
+            if ( !signedVarint(field) )
+                return fail();
+        if ( end - p < 4 )
+            return fail();
+
+        record.count = static_cast<uint32_t>(count);
+        record.timestamp = static_cast<int64_t>(timestamp);
+        for ( int i = 0; i < 2; i++ ) {
+            record.x[i] = static_cast<int32_t>(fields[i]);
+            record.y[i] = static_cast<int32_t>(fields[i+2]);
+            record.dx[i] = static_cast<signed char>(fields[i+4]);
+            record.dy[i] = static_cast<signed char>(fields[i+6]);
+            record.sq[i] = p[i];
+        }
+        record.button = p[2];
+        record.marker = p[3];
+        p += 4;
+
+        started = true;
+        interval = 0;
+        previous = record;
+
+        return true;
+    }
+
+    bool idle( WireRecord& record ) {
+
+        int64_t change;
+        if ( !signedVarint(change) )
+            return fail();
+
+        record = previous;
+        record.count = previous.count + 1;
+        interval = static_cast<int64_t>(static_cast<uint64_t>(interval) + static_cast<uint64_t>(change));
+        record.timestamp = static_cast<int64_t>(static_cast<uint64_t>(previous.timestamp) + static_cast<uint64_t>(interval));
+        for ( int i = 0; i < 2; i++ )
+            record.dx[i] = record.dy[i] = 0;
+        record.marker = 0;
+
+        previous = record;
+
+        return true;
+    }
+
+    bool delta( unsigned char flags, WireRecord& record ) {
+
+        int64_t v;
+
+        record = previous;
+        record.count = previous.count + 1;
+
+        if ( flags & 0x10 ) {
+            if ( !signedVarint(v) )
+                return fail();
+            record.count = static_cast<uint32_t>(record.count + static_cast<uint32_t>(v));
+        }
+
+        if ( flags & 0x20 ) {
+            if ( !signedVarint(v) )
+                return fail();
+            interval = static_cast<int64_t>(static_cast<uint64_t>(interval) + static_cast<uint64_t>(v));
+        }
+        record.timestamp = static_cast<int64_t>(static_cast<uint64_t>(previous.timestamp) + static_cast<uint64_t>(interval));
+
+        for ( int i = 0; i < 2; i++ )
+            record.dx[i] = record.dy[i] = 0;
+
+        if ( flags & 0x01 ) {
+            int64_t d[4];
+            for ( int64_t& field : d )
+                if ( !signedVarint(field) )
+                    return fail();
+            for ( int i = 0; i < 2; i++ ) {
+                record.dx[i] = static_cast<signed char>(d[i]);
+                record.dy[i] = static_cast<signed char>(d[i+2]);
+            }
+        }
+
+        if ( flags & 0x02 ) {
+            for ( int i = 0; i < 2; i++ ) {
+                if ( !signedVarint(v) )
+                    return fail();
+                record.sq[i] = static_cast<unsigned char>(previous.sq[i] + v);
+            }
+        }
+
+        if ( flags & 0x04 ) {
+            if ( p >= end )
+                return fail();
+            record.button = *p++;
+        }
+
+        record.marker = 0;
+        if ( flags & 0x08 ) {
+            if ( p >= end )
+                return fail();
+            record.marker = *p++;
+        }
+
+        // Positions integrate the deltas, unless the record says otherwise (decimated records, lost samples...)
+        for ( int i = 0; i < 2; i++ ) {
+            record.x[i] = static_cast<int32_t>(static_cast<uint32_t>(previous.x[i]) + static_cast<uint32_t>(record.dx[i]));
+            record.y[i] = static_cast<int32_t>(static_cast<uint32_t>(previous.y[i]) + static_cast<uint32_t>(record.dy[i]));
+        }
+
+        if ( flags & 0x40 ) {
+            int64_t c[4];
+            for ( int64_t& field : c )
+                if ( !signedVarint(field) )
+                    return fail();
+            for ( int i = 0; i < 2; i++ ) {
+                record.x[i] = static_cast<int32_t>(static_cast<uint32_t>(record.x[i]) + static_cast<uint32_t>(c[i]));
+                record.y[i] = static_cast<int32_t>(static_cast<uint32_t>(record.y[i]) + static_cast<uint32_t>(c[i+2]));
+            }
+        }
+
+        previous = record;
+
+        return true;
+    }
+
+    const unsigned char *p;
+    const unsigned char *end;
+
+    WireRecord previous;
+    int64_t interval = 0;
+    int runLeft = 0;
+    bool started = false;
+    bool failed = false;
+
+};
+
+
+// Compressed datagrams (NetworkSink::setCompression()): the records of a "TBWP" datagram, as one block.
+//
+// ------------------------------------------- Header (20 bytes) -------------------------------------------
+// | magic "TBWC" | version u8 | header size u8 | payload size u16 | stream ID u32 | record count u16 | (2 bytes 0) |
+// | first sequence u32 |
+//
+// Same stream ID and sequence numbers as the uncompressed datagrams: a sender sends a datagram uncompressed
+// whenever that's smaller, so a receiver must take both.
+
+const uint8_t wireCompressedVersion = 1;
+constexpr size_t wireCompressedHeaderSize = 20;
+
+void encodeCompressedHeader( uint32_t streamId, uint16_t recordCount, uint32_t firstSequence, uint16_t payloadSize,
+                             unsigned char *buffer );
+
+class CompressedDatagram {
+
+public:
+
+    // false if it isn't a compressed datagram or if it's truncated
+    bool parse( const unsigned char *data, size_t length ) {
+
+        if ( length < wireCompressedHeaderSize || data[0] != 'T' || data[1] != 'B' || data[2] != 'W' || data[3] != 'C' )
+            return false;
+
+        headerSize = data[5];
+        payloadSize = wireU16(data + 6);
+        streamNumber = wireU32(data + 8);
+        records = wireU16(data + 12);
+        first = wireU32(data + 16);
+
+        if ( data[4] < 1 || headerSize < wireCompressedHeaderSize || length < headerSize + payloadSize )
+            return false;
+
+        this->data = data;
+
+        return true;
+    }
+
+    uint32_t streamId() const { return streamNumber; }
+    uint32_t firstSequence() const { return first; }
+    size_t size() const { return records; }
+    DeltaBlockReader reader() const { return DeltaBlockReader(data + headerSize, payloadSize); }
+
+private:
+
+    const unsigned char *data { nullptr };
+    size_t headerSize = 0;
+    size_t payloadSize = 0;
+    uint32_t streamNumber = 0;
+    size_t records = 0;
+    uint32_t first = 0;
+
+};
+
+
+#endif //TRACKBALLCONTROL_DELTACODEC_H
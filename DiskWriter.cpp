@@ -0,0 +1,354 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "DiskWriter.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <algorithm>
+
+
+DiskWriter::DiskWriter( size_t bufferSize ) {
+
+    // Power of 2, so positions wrap with a mask
+    this->bufferSize = 1;
+    while ( this->bufferSize < bufferSize )
+        this->bufferSize <<= 1;
+}
+
+DiskWriter::~DiskWriter() {
+    close();
+}
+
+void DiskWriter::setCommitPolicy( size_t commitSize, std::chrono::milliseconds commitInterval ) {
+    this->commitSize = commitSize;
+    this->commitInterval = commitInterval;
+}
+
+void DiskWriter::setIoUring( bool enabled ) {
+    if ( !running )
+        ioUringRequested = enabled;
+}
+
+bool DiskWriter::usesIoUring() const {
+    return ioUringUsed;
+}
+
+int DiskWriter::open( const std::string& path ) {
+
+    if ( running )
+        return -1;
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 )
+        return -1;
+
+    auto channel = std::make_unique<Channel>();
+    channel->fd = fd;
+    channel->buffer.resize(bufferSize);
+    channel->lastCommit = std::chrono::steady_clock::now();
+
+    channels.push_back(std::move(channel));
+
+    return static_cast<int>(channels.size()) - 1;
+}
+
+void DiskWriter::start() {
+
+    if ( running )
+        return;
+
+    if ( ioUringRequested && !channels.empty() ) {
+
+        // At most two linked writes in flight per file
+        int r = ring.init(static_cast<unsigned>(channels.size()) * 2);
+
+        if ( r != 0 ) {
+            std::cout << "io_uring isn't available (" << strerror(-r) << "), writing the files with write()" << std::endl;
+        } else {
+            std::vector<iovec> buffers;
+            for ( auto& channel : channels )
+                buffers.push_back({ channel->buffer.data(), channel->buffer.size() });
+
+            // Pinned memory counts against RLIMIT_MEMLOCK: plain (unregistered) writes if it's too small
+            r = ring.registerBuffers(buffers.data(), static_cast<unsigned>(buffers.size()));
+            if ( r != 0 )
+                std::cout << "Can't register the disk buffers (" << strerror(-r) << "), using unregistered io_uring writes" << std::endl;
+        }
+    }
+
+    ioUringUsed = ring.isOpen();
+
+    running = true;
+    writer = std::thread(ring.isOpen() ? &DiskWriter::runIoUring : &DiskWriter::run, this);
+}
+
+void DiskWriter::append( int channel, const void *data, size_t length ) {
+
+    if ( channel < 0 || static_cast<size_t>(channel) >= channels.size() )
+        return;
+
+    Channel& ch = *channels[channel];
+    auto bytes = static_cast<const char*>(data);
+    uint64_t mask = bufferSize - 1;
+
+    while ( length > 0 ) {
+
+        uint64_t head = ch.head.load(std::memory_order_relaxed);
+        uint64_t tail = ch.tail.load(std::memory_order_acquire);
+        size_t space = bufferSize - static_cast<size_t>(head - tail);
+
+        // Buffer full: the disk can't keep up, nothing to do but wait for the writer thread
+        if ( space == 0 ) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            stallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+            continue;
+        }
+
+        // Copy what fits, in at most two pieces around the end of the buffer
+        size_t n = std::min(length, space);
+        size_t offset = static_cast<size_t>(head & mask);
+        size_t first = std::min(n, bufferSize - offset);
+
+        memcpy(&ch.buffer[offset], bytes, first);
+        memcpy(&ch.buffer[0], bytes + first, n - first);
+
+        ch.head.store(head + n, std::memory_order_release);
+
+        bytes += n;
+        length -= n;
+
+        uint64_t depth = head + n - tail;
+        if ( depth > maxQueueDepth.load(std::memory_order_relaxed) )
+            maxQueueDepth.store(depth, std::memory_order_relaxed);
+    }
+}
+
+void DiskWriter::close() {
+
+    if ( running ) {
+        running = false;
+        writer.join();
+    }
+
+    // The writer thread exits only once everything is written, but it may never have been started
+    for ( auto& channel : channels ) {
+        commit(*channel, true);
+        ::close(channel->fd);
+    }
+
+    channels.clear();
+    ring.close();
+}
+
+bool DiskWriter::isRunning() const {
+    return running;
+}
+
+uint64_t DiskWriter::queueDepth() const {
+
+    uint64_t depth = 0;
+
+    for ( auto& channel : channels )
+        depth += channel->head.load(std::memory_order_acquire) - channel->tail.load(std::memory_order_acquire);
+
+    return depth;
+}
+
+DiskWriter::Stats DiskWriter::getStats() const {
+
+    Stats stats;
+    stats.bytesWritten = bytesWritten;
+    stats.commits = commits;
+    stats.writeErrors = writeErrors;
+    stats.shortWrites = shortWrites;
+    stats.queueDepth = queueDepth();
+    stats.maxQueueDepth = maxQueueDepth;
+    stats.stallNs = stallNs;
+    stats.maxCommitNs = maxCommitNs;
+
+    return stats;
+}
+
+void DiskWriter::printStats() const {
+
+    Stats stats = getStats();
+
+    std::cout << "Disk writer" << ( ioUringUsed ? " (io_uring)" : "" ) << ": " << stats.bytesWritten << " bytes in " << stats.commits << " writes"
+              << " (" << stats.writeErrors << " errors, " << stats.shortWrites << " short), max queue " << stats.maxQueueDepth << " bytes"
+              << ", slowest write " << stats.maxCommitNs / 1000 << " us"
+              << ", producer stalled " << stats.stallNs / 1000 << " us" << std::endl;
+}
+
+
+// Private methods
+void DiskWriter::run() {
+
+    // Keep going after close() was requested until all the buffers are empty
+    while ( true ) {
+
+        bool stopping = !running;
+        bool wrote = false;
+
+        for ( auto& channel : channels )
+            wrote |= commit(*channel, stopping);
+
+        if ( stopping && queueDepth() == 0 )
+            break;
+
+        if ( !wrote )
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void DiskWriter::runIoUring() {
+
+    IoRing::Completion completions[16];
+
+    while ( true ) {
+
+        bool stopping = !running;
+
+        // Completions first: they free the buffers and decide where the next writes go in the files
+        size_t n = ring.reap(completions, 16);
+        for ( size_t k = 0; k < n; k++ )
+            completeWrite(*channels[completions[k].userData >> 1], static_cast<int>(completions[k].userData & 1), completions[k].result);
+
+        // Then every file that is due, all in one submission
+        bool queued = false;
+        for ( size_t i = 0; i < channels.size(); i++ )
+            if ( channels[i]->outstanding == 0 )
+                queued |= queueCommit(*channels[i], static_cast<int>(i), stopping);
+
+        if ( queued ) {
+            int r = ring.submit(0);
+            if ( r < 0 )
+                std::cout << "io_uring submission failed (" << strerror(-r) << ")" << std::endl;
+        } else if ( ring.inFlight() > 0 ) {
+            ring.submit(1);         // Nothing new to write: sleep until a write completes
+        } else if ( stopping && queueDepth() == 0 ) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+bool DiskWriter::queueCommit( Channel& channel, int index, bool force ) {
+
+    auto now = std::chrono::steady_clock::now();
+
+    uint64_t tail = channel.tail.load(std::memory_order_relaxed);
+    uint64_t head = channel.head.load(std::memory_order_acquire);
+    size_t pending = static_cast<size_t>(head - tail);
+
+    if ( pending == 0 || ( !force && pending < commitSize && now - channel.lastCommit < commitInterval ) )
+        return false;
+
+    // Same two pieces as commit(), as two linked writes: the second only starts once the first is complete
+    size_t offset = static_cast<size_t>(tail & (bufferSize - 1));
+    size_t first = std::min(pending, bufferSize - offset);
+    size_t second = pending - first;
+
+    const char *pieces[2] = { &channel.buffer[offset], &channel.buffer[0] };
+    size_t lengths[2] = { first, second };
+    int count = ( second > 0 ) ? 2 : 1;
+
+    for ( int piece = 0; piece < count; piece++ ) {
+
+        uint64_t userData = static_cast<uint64_t>(index) << 1 | static_cast<uint64_t>(piece);
+        uint64_t fileOffset = channel.fileOffset + ( piece == 1 ? first : 0 );
+        bool link = piece + 1 < count;
+
+        if ( ring.hasRegisteredBuffers() )
+            ring.writeFixed(channel.fd, pieces[piece], lengths[piece], fileOffset, index, userData, link);
+        else
+            ring.write(channel.fd, pieces[piece], lengths[piece], fileOffset, userData, link);
+
+        channel.requested[piece] = lengths[piece];
+    }
+
+    channel.outstanding = count;
+    channel.submitted = now;
+    channel.lastCommit = now;
+    commits++;
+
+    return true;
+}
+
+void DiskWriter::completeWrite( Channel& channel, int piece, int32_t result ) {
+
+    size_t requested = channel.requested[piece];
+    uint64_t tail = channel.tail.load(std::memory_order_relaxed);
+
+    if ( result == -ECANCELED ) {
+        // The first piece came short or failed: this one is still in the buffer, for the next write
+    } else if ( result < 0 ) {
+        // Drop the bytes rather than retrying forever and blocking the producer
+        writeErrors++;
+        channel.tail.store(tail + requested, std::memory_order_release);
+    } else {
+        if ( static_cast<size_t>(result) < requested )
+            shortWrites++;
+        bytesWritten += static_cast<uint64_t>(result);
+        channel.fileOffset += static_cast<uint64_t>(result);
+        channel.tail.store(tail + static_cast<uint64_t>(result), std::memory_order_release);
+    }
+
+    if ( --channel.outstanding == 0 ) {
+        auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - channel.submitted).count());
+        if ( elapsed > maxCommitNs )
+            maxCommitNs = elapsed;
+    }
+}
+
+bool DiskWriter::commit( Channel& channel, bool force ) {
+
+    auto now = std::chrono::steady_clock::now();
+
+    uint64_t tail = channel.tail.load(std::memory_order_relaxed);
+    uint64_t head = channel.head.load(std::memory_order_acquire);
+    size_t pending = static_cast<size_t>(head - tail);
+
+    if ( pending == 0 || ( !force && pending < commitSize && now - channel.lastCommit < commitInterval ) )
+        return false;
+
+    // The pending bytes may wrap around the end of the buffer: write both pieces at once
+    size_t offset = static_cast<size_t>(tail & (bufferSize - 1));
+    size_t first = std::min(pending, bufferSize - offset);
+
+    iovec pieces[2];
+    pieces[0].iov_base = &channel.buffer[offset];
+    pieces[0].iov_len = first;
+    pieces[1].iov_base = &channel.buffer[0];
+    pieces[1].iov_len = pending - first;
+
+    ssize_t written = ::pwritev(channel.fd, pieces, ( pieces[1].iov_len > 0 ) ? 2 : 1, static_cast<off_t>(channel.fileOffset));
+
+    auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - now).count());
+    if ( elapsed > maxCommitNs )
+        maxCommitNs = elapsed;
+
+    commits++;
+    channel.lastCommit = now;
+
+    if ( written < 0 ) {
+        // Drop the bytes rather than retrying forever and blocking the producer
+        writeErrors++;
+        written = static_cast<ssize_t>(pending);
+    } else {
+        if ( static_cast<size_t>(written) < pending )
+            shortWrites++;
+        bytesWritten += static_cast<uint64_t>(written);
+        channel.fileOffset += static_cast<uint64_t>(written);
+    }
+
+    channel.tail.store(tail + static_cast<uint64_t>(written), std::memory_order_release);
+
+    return true;
+}
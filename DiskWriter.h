@@ -0,0 +1,108 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_DISKWRITER_H
+#define TRACKBALLCONTROL_DISKWRITER_H
+
+#include "IoRing.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Group-commit file writer: the acquisition thread only copies bytes into a per-file ring buffer,
+// and a dedicated thread writes them out in large chunks once enough bytes are buffered or
+// enough time has passed since the previous write. The acquisition thread never makes a syscall on the files.
+//
+// With setIoUring(), the writer thread queues the writes of all the files in an io_uring and submits them with a
+// single syscall, straight from the per-file buffers (registered with the kernel once, at start()).
+class DiskWriter {
+
+public:
+
+    struct Stats {
+        uint64_t bytesWritten = 0;
+        uint64_t commits = 0;           // write() calls
+        uint64_t writeErrors = 0;
+        uint64_t shortWrites = 0;       // Fewer bytes written than asked (the rest goes with the next write)
+        uint64_t queueDepth = 0;        // Bytes waiting right now, all files together
+        uint64_t maxQueueDepth = 0;     // Bytes waiting in a buffer, at worst
+        uint64_t stallNs = 0;           // Time the producer spent waiting for space in a full buffer
+        uint64_t maxCommitNs = 0;       // Slowest single write()
+    };
+
+    explicit DiskWriter( size_t bufferSize = 4 << 20 );
+    ~DiskWriter();
+
+    // Commit as soon as commitSize bytes are waiting, or commitInterval after the previous commit
+    void setCommitPolicy( size_t commitSize, std::chrono::milliseconds commitInterval );
+
+    // Before start(). Falls back to the blocking writes (with a message) where io_uring isn't available
+    void setIoUring( bool enabled );
+    bool usesIoUring() const;
+
+    // Open (truncate) a file and return its channel number, -1 on error. Only before start()
+    int open( const std::string& path );
+    void start();
+
+    // [Producer side] Only ever called from one thread. Blocks (and counts the stall) only if the buffer is full.
+    // Does nothing if the channel isn't open (-1 from open(), or after close())
+    void append( int channel, const void *data, size_t length );
+
+    // Write everything still buffered, stop the thread and close the files
+    void close();
+
+    bool isRunning() const;
+    uint64_t queueDepth() const;        // Bytes currently waiting, all files together
+    Stats getStats() const;
+    void printStats() const;
+
+private:
+
+    struct Channel {
+        int fd = -1;
+        std::vector<char> buffer;
+        std::atomic<uint64_t> head { 0 };       // Total bytes appended (producer)
+        std::atomic<uint64_t> tail { 0 };       // Total bytes written (writer thread)
+        std::chrono::steady_clock::time_point lastCommit;
+        uint64_t fileOffset = 0;                // Bytes actually in the file
+
+        // [io_uring] The write in flight, in up to two linked pieces
+        size_t requested[2] { 0, 0 };
+        int outstanding = 0;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    void run();
+    void runIoUring();
+    bool commit( Channel& channel, bool force );
+    bool queueCommit( Channel& channel, int index, bool force );
+    void completeWrite( Channel& channel, int piece, int32_t result );
+
+    size_t bufferSize;
+    size_t commitSize = 256 << 10;
+    std::chrono::milliseconds commitInterval { 100 };
+
+    std::vector<std::unique_ptr<Channel>> channels;
+    bool ioUringRequested = false;
+    bool ioUringUsed = false;                   // By the last start(), still true after close() for the stats
+    IoRing ring;
+    std::thread writer;
+    std::atomic<bool> running { false };
+
+    std::atomic<uint64_t> bytesWritten { 0 };
+    std::atomic<uint64_t> commits { 0 };
+    std::atomic<uint64_t> writeErrors { 0 };
+    std::atomic<uint64_t> shortWrites { 0 };
+    std::atomic<uint64_t> maxQueueDepth { 0 };
+    std::atomic<uint64_t> stallNs { 0 };
+    std::atomic<uint64_t> maxCommitNs { 0 };
+
+};
+
+
+#endif //TRACKBALLCONTROL_DISKWRITER_H
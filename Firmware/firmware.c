@@ -53,6 +53,7 @@ __data int siz;
 void toSensors( unsigned char dat );
 void fromSensors( __data signed char resBuf[] );
 void toHost( __data signed char resBuf[], __data int siz );
+void readMotion( __data signed char inBuf[] );
 
 // ------------------------------------------------
 
@@ -119,11 +120,49 @@ void fromSensors( __data signed char resBuf[] )
 	resBuf[2] = IOB & 0x10;	// 0001 0000 	--> Put IOB into resBuf, but set the 5th bit to 0 if B4 == 0 (red button pressed)
 }
 
+void readMotion( __data signed char inBuf[] )
+{
+    __data unsigned char addr;
+    __data int i;
+
+	addr = 0x02;					// 0x02 == "MOTION_STATUS" address for ADNS
+	toSensors( addr );				// Write to ADNS' address 0x02
+	fromSensors( resBuf );			// Read response from ADNS (into resBuf)
+
+    addr = 0x03;					// 0x03 == "DELTA_X" address
+    toSensors( addr );
+    fromSensors( resBuf );			// Get DX
+
+    for ( i = 0; i < 2; i++ )
+    {
+        inBuf[i] = resBuf[i];		// Start to fill inBuf with DX
+    }
+    addr = 0x04;					// 0x04 == "DELTA_Y" address
+    toSensors( addr );
+    fromSensors( resBuf );			// Get DY
+
+    for ( i = 0; i < 2; i++ )
+    {
+        inBuf[i + 2] = resBuf[i];	// Continue to fill inBuf with DY
+    }
+    addr = 0x05;					// 0x05 == "SQUAL" address
+    toSensors( addr );
+    fromSensors( resBuf );			// Get SQ
+
+    for ( i = 0; i < 3; i++ )
+    {
+        inBuf[i + 4] = resBuf[i];	// Continue to fill inBuf with SQ (and the button byte)
+    }
+}
+
 void main()
 {
 	__data unsigned char addr;				// ADNS Addresses
 	__data unsigned char command = 0x00;	// Command to send
 	__data signed char inBuf[7];			// Input buffer (from the ADNS)
+	__data unsigned char nbSamples;			// Number of motion reads in a batch
+	__data unsigned char k;
+	__data unsigned char n;					// Bytes already in EP1INBUF (pixel burst)
     __data int i;
 
 	OEB = 0x0F;		// 0000 1111 	--> PortB pins B0-B3 = OUT, pins B4-B7 = IN
@@ -187,35 +226,56 @@ void main()
 				break;
 			}
 
+			case 0xEB:						// Firmware-only "PIX_BURST" command: PIX_GRAB, packed into full 64-byte packets
+			{
+				toSensors( 0x8B );			   // Write 0x8B to ADNS (same as PIX_GRAB)
+				toSensors( 0x00 );		       // Write anything to addr 0x0B to reset pixel counter = 0
+
+				n = 0;
+
+				for ( i = 1; i <= 361; i++ )   // 361 read operations (19x19 pixels), like PIX_GRAB
+				{
+					while ( 1 )           	   // While current pixel not valid
+					{
+						toSensors( 0x0B );
+						fromSensors( resBuf );
+
+						if ( (resBuf[0] & 0x80) && (resBuf[1] & 0x80) )
+						{
+							break;
+						}
+					}
+
+					if ( n == 0 )
+					{
+						while ( EP01STAT & 0x04 )	// Only wait for the host before starting a new packet
+						{
+							;
+						}
+					}
+
+					EP1INBUF[n] = resBuf[0] & 0x7f;		// Pixel pair, 'Pixel valid' bit cleared
+					EP1INBUF[n + 1] = resBuf[1] & 0x7f;
+					n += 2;
+
+					if ( n == 64 )
+					{
+						EP1INBC = 64;			// Full packet: send it while the next pixels are read
+						n = 0;
+					}
+				}
+
+				if ( n > 0 )
+				{
+					EP1INBC = n;				// 722 = 11 x 64 + 18: the short last packet ends the host's read
+				}
+
+				break;
+			}
+
 			case 0x02:						// 0x02 == "MOTION_STATUS" address for ADNS
 			{
-				toSensors( addr );			// Write to ADNS' address 0x02
-				fromSensors( resBuf );		// Read response from ADNS (into resBuf)
-
-                addr = 0x03;				// 0x03 == "DELTA_X" address
-                toSensors( addr );
-                fromSensors( resBuf );		// Get DX
-
-                for ( i = 0; i < 2; i++ )
-                {
-                    inBuf[i] = resBuf[i];	// Start to fill inBuf with DX
-                }
-                addr = 0x04;				// 0x04 == "DELTA_Y" address
-                toSensors( addr );
-                fromSensors( resBuf );		// Get DY
-
-                for ( i = 0; i < 2; i++ )
-                {
-                    inBuf[i + 2] = resBuf[i];	// Continue to fill inBuf with DY
-                }
-                addr = 0x05;				// 0x05 == "SQUAL" address
-                toSensors( addr );
-                fromSensors( resBuf );		// Get SQ
-
-                for ( i = 0; i < 3; i++ )
-                {
-                    inBuf[i + 4] = resBuf[i];		// Continue to fill inBuf with SQ
-                }
+				readMotion( inBuf );				// Get DX, DY, SQ and the button into inBuf
 
                 toHost( inBuf, 7 );			    	// Finally send inBuf to host
 
@@ -224,6 +284,52 @@ void main()
 				break;
 			}
 
+			case 0x7E:						// Firmware-only "FW_INFO" command: signature and version of this firmware
+			{
+				// Bit 7 is clear, so an older firmware takes it for a plain register read (2 bytes back, nothing written)
+				inBuf[0] = 'T';
+				inBuf[1] = 'B';
+				inBuf[2] = 'F';
+				inBuf[3] = 1;				// Version 1: MOTION_BATCH and PIX_BURST
+				toHost( inBuf, 4 );
+				break;
+			}
+
+			case 0xE2:						// Firmware-only "MOTION_BATCH" command (not an ADNS address)
+			{
+				// Second command byte = number of motion reads to pack into a single EP1 IN packet (7 bytes each)
+				nbSamples = ( EP1OUTBC < 2 ) ? 1 : EP1OUTBUF[1];
+				if ( nbSamples < 1 )
+				{
+					nbSamples = 1;
+				}
+				if ( nbSamples > 9 )				// 9 x 7 = 63 bytes, the most that fits in EP1INBUF
+				{
+					nbSamples = 9;
+				}
+
+				while ( EP01STAT & 0x04 )		// Wait for the host to take the previous packet before filling EP1INBUF
+				{
+					;
+				}
+
+				for ( k = 0; k < nbSamples; k++ )
+				{
+					readMotion( inBuf );
+
+					for ( i = 0; i < 7; i++ )
+					{
+						EP1INBUF[k * 7 + i] = inBuf[i];	// Append the record right behind the previous one
+					}
+
+					for ( i = 0; i < 200; i++ ) {;}     // Same delay as between two single motion reads
+				}
+
+				EP1INBC = nbSamples * 7;		// Arm EP1 IN with all the records at once
+
+				break;
+			}
+
 			default:
 			{
 				toSensors( addr );
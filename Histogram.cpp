@@ -0,0 +1,155 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "Histogram.h"
+#include <iostream>
+#include <iomanip>
+
+
+void Histogram::record( int64_t ns ) {
+
+    uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+
+    // Single writer: plain load/store pairs are enough, the atomics only make concurrent reads safe
+    auto bump = []( std::atomic<uint64_t>& a, uint64_t v ) { a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed); };
+
+    bump(buckets[bucketOf(value)], 1);
+    bump(total, 1);
+    bump(sum, value);
+
+    if ( ns < smallest.load(std::memory_order_relaxed) )
+        smallest.store(ns, std::memory_order_relaxed);
+    if ( ns > largest.load(std::memory_order_relaxed) )
+        largest.store(ns, std::memory_order_relaxed);
+}
+
+void Histogram::reset() {
+
+    for ( auto& bucket : buckets )
+        bucket.store(0, std::memory_order_relaxed);
+
+    total = 0;
+    sum = 0;
+    smallest = INT64_MAX;
+    largest = 0;
+}
+
+uint64_t Histogram::count() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+int64_t Histogram::min() const {
+    return count() ? smallest.load(std::memory_order_relaxed) : 0;
+}
+
+int64_t Histogram::max() const {
+    return largest.load(std::memory_order_relaxed);
+}
+
+double Histogram::mean() const {
+    uint64_t n = count();
+    return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / static_cast<double>(n) : 0.0;
+}
+
+int64_t Histogram::percentile( double p ) const {
+
+    uint64_t n = count();
+    if ( n == 0 )
+        return 0;
+
+    // Rank of the value we're looking for (1-based), then walk the buckets until we pass it
+    auto rank = static_cast<uint64_t>(p * static_cast<double>(n - 1)) + 1;
+    uint64_t seen = 0;
+
+    for ( int i = 0; i < bucketCount; i++ ) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if ( seen >= rank )
+            return std::min(static_cast<int64_t>(valueOf(i)), max());
+    }
+
+    return max();
+}
+
+void Histogram::merge( const Histogram& other ) {
+
+    for ( int i = 0; i < bucketCount; i++ )
+        buckets[i].fetch_add(other.buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    total.fetch_add(other.total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    sum.fetch_add(other.sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    if ( other.count() > 0 ) {
+        if ( other.min() < smallest.load(std::memory_order_relaxed) )
+            smallest.store(other.min(), std::memory_order_relaxed);
+        if ( other.max() > largest.load(std::memory_order_relaxed) )
+            largest.store(other.max(), std::memory_order_relaxed);
+    }
+}
+
+void Histogram::print( const std::string& name, bool detailed ) const {
+
+    std::cout << std::fixed << std::setprecision(1)
+              << name << ": " << count() << " values, mean " << mean() / 1000.0 << " us"
+              << ", min " << min() / 1000.0 << " us"
+              << ", p50 " << percentile(0.50) / 1000.0 << " us"
+              << ", p90 " << percentile(0.90) / 1000.0 << " us"
+              << ", p99 " << percentile(0.99) / 1000.0 << " us"
+              << ", p99.9 " << percentile(0.999) / 1000.0 << " us"
+              << ", max " << max() / 1000.0 << " us" << std::endl;
+
+    if ( !detailed || count() == 0 )
+        return;
+
+    // Coarse view: one line per power of 2, with a bar proportional to its share of the values
+    uint64_t lower = 0;
+
+    for ( int i = 0; i < bucketCount; i += subCount ) {
+
+        uint64_t n = 0;
+        for ( int j = i; j < i + subCount; j++ )
+            n += buckets[j].load(std::memory_order_relaxed);
+
+        uint64_t upper = valueOf(i + subCount - 1);
+
+        if ( n > 0 ) {
+            int bar = static_cast<int>(50.0 * static_cast<double>(n) / static_cast<double>(count()) + 0.5);
+            std::cout << "\t" << std::setw(12) << lower / 1000.0 << " - " << std::setw(12) << upper / 1000.0 << " us "
+                      << std::setw(10) << n << " " << std::string(bar, '#') << std::endl;
+        }
+
+        lower = upper + 1;
+    }
+}
+
+
+// Private methods
+int Histogram::bucketOf( uint64_t value ) {
+
+    // Values below 2 * subCount end up in their own exact bucket (shift is 0 for the second range)
+    if ( value < static_cast<uint64_t>(subCount) )
+        return static_cast<int>(value);
+
+    int msb = 63 - __builtin_clzll(value);
+    if ( msb > maxBits ) {
+        msb = maxBits;
+        value = (1ULL << (maxBits + 1)) - 1;
+    }
+
+    // Power of 2 above the first range, then the top subBits bits below the most significant one
+    int shift = msb - subBits;
+    int sub = static_cast<int>((value >> shift) & (subCount - 1));
+
+    return (shift + 1) * subCount + sub;
+}
+
+uint64_t Histogram::valueOf( int bucket ) {
+
+    if ( bucket < subCount )
+        return static_cast<uint64_t>(bucket);
+
+    int shift = bucket / subCount - 1;
+    uint64_t sub = static_cast<uint64_t>(bucket % subCount);
+
+    return (((static_cast<uint64_t>(subCount) + sub) << shift) | ((1ULL << shift) - 1));
+}
@@ -0,0 +1,56 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_HISTOGRAM_H
+#define TRACKBALLCONTROL_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+// HDR-style histogram of durations in ns: values are grouped by power of 2, and each power of 2
+// is split into 32 linear sub-buckets, so every value is kept within ~3% from 1 ns to ~18 minutes.
+// Recording is O(1) and never allocates. One thread records; any thread can read it at the same time.
+class Histogram {
+
+public:
+
+    Histogram() = default;
+
+    void record( int64_t ns );
+    void reset();
+
+    uint64_t count() const;
+    int64_t min() const;
+    int64_t max() const;
+    double mean() const;
+    int64_t percentile( double p ) const;       // p in [0, 1]
+
+    // Add all the values recorded in another histogram
+    void merge( const Histogram& other );
+
+    // One-line summary, then one line per non-empty power of 2 if 'detailed'
+    void print( const std::string& name, bool detailed = false ) const;
+
+private:
+
+    static const int subBits = 5;                           // 32 sub-buckets per power of 2
+    static const int subCount = 1 << subBits;
+    static const int maxBits = 40;                          // 2^40 ns ~ 18 min, larger values are clamped
+    static const int bucketCount = (maxBits - subBits + 2) * subCount;
+
+    static int bucketOf( uint64_t value );
+    static uint64_t valueOf( int bucket );                  // Upper bound of the bucket
+
+    std::atomic<uint64_t> buckets[bucketCount] { };
+    std::atomic<uint64_t> total { 0 };
+    std::atomic<uint64_t> sum { 0 };
+    std::atomic<int64_t> smallest { INT64_MAX };
+    std::atomic<int64_t> largest { 0 };
+
+};
+
+
+#endif //TRACKBALLCONTROL_HISTOGRAM_H
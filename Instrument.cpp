@@ -0,0 +1,136 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "Instrument.h"
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// What one thread recorded. Never freed: the values of finished threads still count in the totals
+struct ThreadStats {
+    Histogram stages[static_cast<int>(Stage::Count)];
+    std::atomic<uint64_t> events[static_cast<int>(Event::Count)] { };
+};
+
+static std::mutex registryMutex;
+static std::vector<ThreadStats*> registry;
+
+static ThreadStats& localStats() {
+
+    // Registered once per thread, on its first value: the lock is never taken again by that thread
+    thread_local ThreadStats *stats = nullptr;
+
+    if ( !stats ) {
+        stats = new ThreadStats;
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(stats);
+    }
+
+    return *stats;
+}
+
+
+void recordStage( Stage stage, int64_t ns ) {
+    localStats().stages[static_cast<int>(stage)].record(ns);
+}
+
+void countEvent( Event event, uint64_t n ) {
+
+    auto& counter = localStats().events[static_cast<int>(event)];
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+bool instrumentationEnabled() {
+#ifdef TRACKBALL_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+}
+
+void stageHistogram( Stage stage, Histogram& histogram ) {
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    for ( auto stats : registry )
+        histogram.merge(stats->stages[static_cast<int>(stage)]);
+}
+
+uint64_t eventCount( Event event ) {
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    uint64_t total = 0;
+    for ( auto stats : registry )
+        total += stats->events[static_cast<int>(event)].load(std::memory_order_relaxed);
+
+    return total;
+}
+
+void resetInstrumentation() {
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    for ( auto stats : registry ) {
+        for ( auto& stage : stats->stages )
+            stage.reset();
+        for ( auto& event : stats->events )
+            event.store(0, std::memory_order_relaxed);
+    }
+}
+
+void printInstrumentation() {
+
+    if ( !instrumentationEnabled() )
+        return;
+
+    std::cout << "Pipeline stages:" << std::endl;
+
+    for ( int i = 0; i < static_cast<int>(Stage::Count); i++ ) {
+
+        auto stage = static_cast<Stage>(i);
+
+        // Histograms are too big for the stack
+        auto histogram = std::make_unique<Histogram>();
+        stageHistogram(stage, *histogram);
+
+        if ( histogram->count() > 0 )
+            histogram->print(std::string("\t") + stageName(stage));
+    }
+
+    std::cout << "Pipeline events:";
+    for ( int i = 0; i < static_cast<int>(Event::Count); i++ )
+        std::cout << " " << eventName(static_cast<Event>(i)) << " " << eventCount(static_cast<Event>(i)) << ( i + 1 < static_cast<int>(Event::Count) ? "," : "" );
+    std::cout << std::endl;
+}
+
+const char* stageName( Stage stage ) {
+
+    switch ( stage ) {
+        case Stage::Acquire:        return "Acquire";
+        case Stage::OutTransfer:    return "OUT transfer";
+        case Stage::InTransfer:     return "IN transfer";
+        case Stage::UsbEvents:      return "USB events";
+        case Stage::Decode:         return "Decode";
+        case Stage::Format:         return "Format";
+        case Stage::Console:        return "Console";
+        case Stage::Disk:           return "Disk";
+        case Stage::Transmit:       return "Transmit";
+        default:                    return "?";
+    }
+}
+
+const char* eventName( Event event ) {
+
+    switch ( event ) {
+        case Event::Samples:        return "samples";
+        case Event::Commands:       return "commands";
+        case Event::ShortReads:     return "short reads";
+        case Event::TransferErrors: return "transfer errors";
+        default:                    return "?";
+    }
+}
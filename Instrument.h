@@ -0,0 +1,93 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_INSTRUMENT_H
+#define TRACKBALLCONTROL_INSTRUMENT_H
+
+#include "Histogram.h"
+#include <chrono>
+#include <cstdint>
+
+
+// Per-stage timers and event counters for the acquisition pipeline.
+//
+// Built in only with -DTRACKBALL_INSTRUMENT=ON (which defines TRACKBALL_INSTRUMENT): otherwise the
+// INSTRUMENT_* macros expand to nothing and the hot path is exactly the same as without them.
+// Each thread records into its own histograms, so recording never takes a lock;
+// the query functions merge the histograms of all the threads that ever recorded something.
+
+enum class Stage : int {
+    Acquire,            // A whole Trackball::acquire() call (includes the stages below)
+    OutTransfer,        // Sending the motion command
+    InTransfer,         // Reading the motion records back
+    UsbEvents,          // Async mode: waiting for and dispatching USB completions (includes the decoding)
+    Decode,             // Integrating the positions and publishing the sample
+    Format,             // Building the text row
+    Console,            // Printing the row
+    Disk,               // Handing the rows and records to the disk writer
+    Transmit,           // Sending the UDP packet
+    Count
+};
+
+enum class Event : int {
+    Samples,            // Samples decoded
+    Commands,           // Motion commands sent
+    ShortReads,         // Responses too short to hold a record
+    TransferErrors,     // Failed USB transfers
+    Count
+};
+
+void recordStage( Stage stage, int64_t ns );
+void countEvent( Event event, uint64_t n = 1 );
+
+// [Runtime queries] Safe to call from any thread while the pipeline runs
+bool instrumentationEnabled();                                  // false if built without TRACKBALL_INSTRUMENT
+void stageHistogram( Stage stage, Histogram& histogram );       // Merges all the threads' values into 'histogram'
+uint64_t eventCount( Event event );
+void resetInstrumentation();                                    // Values recorded during the reset may be lost
+void printInstrumentation();
+
+const char* stageName( Stage stage );
+const char* eventName( Event event );
+
+
+// Times a stage from its construction until stop() or the end of the scope, whichever comes first
+class StageTimer {
+
+public:
+
+    explicit StageTimer( Stage stage ) : stage(stage), start(std::chrono::steady_clock::now()) { }
+    ~StageTimer() { stop(); }
+
+    StageTimer( const StageTimer& ) = delete;
+    StageTimer& operator=( const StageTimer& ) = delete;
+
+    void stop() {
+        if ( stopped )
+            return;
+        stopped = true;
+        recordStage(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+private:
+
+    Stage stage;
+    std::chrono::steady_clock::time_point start;
+    bool stopped = false;
+
+};
+
+
+#ifdef TRACKBALL_INSTRUMENT
+#define INSTRUMENT_STAGE( name )        StageTimer stageTimer##name(Stage::name)
+#define INSTRUMENT_STOP( name )         stageTimer##name.stop()
+#define INSTRUMENT_COUNT( name, n )     countEvent(Event::name, (n))
+#else
+#define INSTRUMENT_STAGE( name )        ((void)0)
+#define INSTRUMENT_STOP( name )         ((void)0)
+#define INSTRUMENT_COUNT( name, n )     ((void)0)
+#endif
+
+
+#endif //TRACKBALLCONTROL_INSTRUMENT_H
@@ -0,0 +1,265 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "IoRing.h"
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+
+static int ioUringSetup( unsigned entries, io_uring_params *params ) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter( int fd, unsigned toSubmit, unsigned minComplete, unsigned flags ) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int ioUringRegister( int fd, unsigned opcode, const void *arg, unsigned count ) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+template <typename T>
+static T* at( void *base, unsigned offset ) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+
+IoRing::~IoRing() {
+    close();
+}
+
+int IoRing::init( unsigned entries ) {
+
+    close();
+
+    io_uring_params params { };
+    int ring = ioUringSetup(entries, &params);
+    if ( ring < 0 )
+        return -errno;
+
+    fd = ring;
+    this->entries = params.sq_entries;
+
+    // The two rings and the submission entries live in kernel memory, mapped here
+    sqLength = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqLength = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqesLength = params.sq_entries * sizeof(io_uring_sqe);
+
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if ( singleMap )
+        sqLength = cqLength = std::max(sqLength, cqLength);
+
+    sqMemory = mmap(nullptr, sqLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if ( sqMemory == MAP_FAILED ) {
+        sqMemory = nullptr;
+        int error = -errno;
+        close();
+        return error;
+    }
+
+    cqMemory = singleMap ? sqMemory : mmap(nullptr, cqLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if ( cqMemory == MAP_FAILED ) {
+        cqMemory = nullptr;
+        int error = -errno;
+        close();
+        return error;
+    }
+
+    void *entriesMemory = mmap(nullptr, sqesLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if ( entriesMemory == MAP_FAILED ) {
+        int error = -errno;
+        close();
+        return error;
+    }
+    sqes = static_cast<io_uring_sqe*>(entriesMemory);
+
+    sqHead = at<std::atomic<unsigned>>(sqMemory, params.sq_off.head);
+    sqTail = at<std::atomic<unsigned>>(sqMemory, params.sq_off.tail);
+    sqMask = at<unsigned>(sqMemory, params.sq_off.ring_mask);
+    sqArray = at<unsigned>(sqMemory, params.sq_off.array);
+    cqHead = at<std::atomic<unsigned>>(cqMemory, params.cq_off.head);
+    cqTail = at<std::atomic<unsigned>>(cqMemory, params.cq_off.tail);
+    cqMask = at<unsigned>(cqMemory, params.cq_off.ring_mask);
+    cqes = at<io_uring_cqe>(cqMemory, params.cq_off.cqes);
+
+    localTail = sqTail->load(std::memory_order_relaxed);
+    pending = 0;
+    submitted = 0;
+
+    return 0;
+}
+
+void IoRing::close() {
+
+    if ( sqes )
+        munmap(sqes, sqesLength);
+    if ( cqMemory && cqMemory != sqMemory )
+        munmap(cqMemory, cqLength);
+    if ( sqMemory )
+        munmap(sqMemory, sqLength);
+    if ( fd >= 0 )
+        ::close(fd);        // Also unregisters the buffers
+
+    fd = -1;
+    sqes = nullptr;
+    sqMemory = nullptr;
+    cqMemory = nullptr;
+    registered = false;
+}
+
+bool IoRing::isOpen() const {
+    return fd >= 0;
+}
+
+int IoRing::registerBuffers( const iovec *buffers, unsigned count ) {
+
+    if ( fd < 0 )
+        return -EBADF;
+
+    if ( ioUringRegister(fd, IORING_REGISTER_BUFFERS, buffers, count) != 0 )
+        return -errno;
+
+    registered = true;
+
+    return 0;
+}
+
+bool IoRing::hasRegisteredBuffers() const {
+    return registered;
+}
+
+bool IoRing::write( int fd, const void *data, size_t length, uint64_t offset, uint64_t userData, bool linkNext ) {
+
+    io_uring_sqe *entry = nextEntry();
+    if ( !entry )
+        return false;
+
+    entry->opcode = IORING_OP_WRITE;
+    entry->fd = fd;
+    entry->addr = reinterpret_cast<uint64_t>(data);
+    entry->len = static_cast<uint32_t>(length);
+    entry->off = offset;
+    entry->user_data = userData;
+    entry->flags = linkNext ? IOSQE_IO_LINK : 0;
+
+    return true;
+}
+
+bool IoRing::writeFixed( int fd, const void *data, size_t length, uint64_t offset, int bufferIndex, uint64_t userData, bool linkNext ) {
+
+    io_uring_sqe *entry = nextEntry();
+    if ( !entry )
+        return false;
+
+    entry->opcode = IORING_OP_WRITE_FIXED;
+    entry->fd = fd;
+    entry->addr = reinterpret_cast<uint64_t>(data);
+    entry->len = static_cast<uint32_t>(length);
+    entry->off = offset;
+    entry->buf_index = static_cast<uint16_t>(bufferIndex);
+    entry->user_data = userData;
+    entry->flags = linkNext ? IOSQE_IO_LINK : 0;
+
+    return true;
+}
+
+bool IoRing::sendMessage( int fd, const msghdr *message, uint64_t userData ) {
+
+    io_uring_sqe *entry = nextEntry();
+    if ( !entry )
+        return false;
+
+    entry->opcode = IORING_OP_SENDMSG;
+    entry->fd = fd;
+    entry->addr = reinterpret_cast<uint64_t>(message);
+    entry->len = 1;
+    entry->user_data = userData;
+
+    return true;
+}
+
+int IoRing::submit( unsigned waitFor ) {
+
+    if ( fd < 0 )
+        return -EBADF;
+
+    // Publish the new entries to the kernel
+    sqTail->store(localTail, std::memory_order_release);
+
+    unsigned toSubmit = pending;
+    if ( toSubmit == 0 && waitFor == 0 )
+        return 0;
+
+    int r = ioUringEnter(fd, toSubmit, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0);
+
+    // The kernel reports the entries it consumed even when the wait is interrupted afterwards, so an error
+    // (EINTR included) means none of them was: they stay pending for the next call
+    if ( r < 0 )
+        return -errno;
+
+    unsigned consumed = static_cast<unsigned>(r);
+    pending -= consumed;
+    submitted += consumed;
+
+    return static_cast<int>(consumed);
+}
+
+size_t IoRing::reap( Completion *completions, size_t max ) {
+
+    if ( fd < 0 )
+        return 0;
+
+    unsigned head = cqHead->load(std::memory_order_relaxed);
+    unsigned tail = cqTail->load(std::memory_order_acquire);
+    size_t n = 0;
+
+    while ( head != tail && n < max ) {
+        const io_uring_cqe& entry = cqes[head & *cqMask];
+        completions[n].userData = entry.user_data;
+        completions[n].result = entry.res;
+        n++;
+        head++;
+    }
+
+    cqHead->store(head, std::memory_order_release);
+    submitted -= static_cast<unsigned>(n);
+
+    return n;
+}
+
+unsigned IoRing::queued() const {
+    return pending;
+}
+
+unsigned IoRing::inFlight() const {
+    return submitted;
+}
+
+unsigned IoRing::capacity() const {
+    return entries;
+}
+
+
+// Private methods
+io_uring_sqe* IoRing::nextEntry() {
+
+    // The kernel frees entries as it consumes them, at submit() time
+    unsigned head = sqHead->load(std::memory_order_acquire);
+    if ( localTail - head >= entries )
+        return nullptr;
+
+    unsigned index = localTail & *sqMask;
+    io_uring_sqe *entry = &sqes[index];
+    memset(entry, 0, sizeof(*entry));
+    sqArray[index] = index;
+
+    localTail++;
+    pending++;
+
+    return entry;
+}
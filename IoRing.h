@@ -0,0 +1,88 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_IORING_H
+#define TRACKBALLCONTROL_IORING_H
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+
+// Minimal io_uring wrapper, straight on the system calls (no liburing dependency).
+// Requests are queued in the submission ring without any syscall, then handed to the kernel all at once by submit();
+// completions are read from the completion ring, also without syscall. Used by one thread at a time.
+class IoRing {
+
+public:
+
+    struct Completion {
+        uint64_t userData;
+        int32_t result;                 // Bytes transferred, or -errno
+    };
+
+    IoRing() = default;
+    ~IoRing();
+
+    IoRing( const IoRing& ) = delete;
+    IoRing& operator=( const IoRing& ) = delete;
+
+    int init( unsigned entries );       // 0, or -errno (ENOSYS on kernels without io_uring, EPERM if it is disabled)
+    void close();
+    bool isOpen() const;
+
+    // Pins the buffers for writeFixed(). Fails (-errno) if they don't fit in RLIMIT_MEMLOCK
+    int registerBuffers( const iovec *buffers, unsigned count );
+    bool hasRegisteredBuffers() const;
+
+    // Queue a request; false if the submission ring is full. Nothing reaches the kernel before submit()
+    bool write( int fd, const void *data, size_t length, uint64_t offset, uint64_t userData, bool linkNext = false );
+    bool writeFixed( int fd, const void *data, size_t length, uint64_t offset, int bufferIndex, uint64_t userData, bool linkNext = false );
+    bool sendMessage( int fd, const msghdr *message, uint64_t userData );
+
+    // Submit everything queued, and wait for at least 'waitFor' completions. Returns the number submitted, or -errno
+    int submit( unsigned waitFor = 0 );
+
+    // Up to 'max' completions, oldest first
+    size_t reap( Completion *completions, size_t max );
+
+    unsigned queued() const;            // Requests not submitted yet
+    unsigned inFlight() const;          // Submitted, not reaped yet
+    unsigned capacity() const;
+
+private:
+
+    io_uring_sqe* nextEntry();
+
+    int fd = -1;
+    unsigned entries = 0;
+    bool registered = false;
+
+    void *sqMemory { nullptr };
+    size_t sqLength = 0;
+    void *cqMemory { nullptr };
+    size_t cqLength = 0;
+    io_uring_sqe *sqes { nullptr };
+    size_t sqesLength = 0;
+
+    std::atomic<unsigned> *sqHead { nullptr };
+    std::atomic<unsigned> *sqTail { nullptr };
+    unsigned *sqMask { nullptr };
+    unsigned *sqArray { nullptr };
+    std::atomic<unsigned> *cqHead { nullptr };
+    std::atomic<unsigned> *cqTail { nullptr };
+    unsigned *cqMask { nullptr };
+    io_uring_cqe *cqes { nullptr };
+
+    unsigned localTail = 0;             // Entries filled in, published to the kernel at submit()
+    unsigned pending = 0;
+    unsigned submitted = 0;
+
+};
+
+
+#endif //TRACKBALLCONTROL_IORING_H
@@ -0,0 +1,59 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_MARKERQUEUE_H
+#define TRACKBALLCONTROL_MARKERQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+
+
+// Keys pressed on the visualizer thread, on their way to the acquisition thread.
+// Lock-free with a single producer and a single consumer: push() never blocks the keyboard loop,
+// and the acquisition thread drains it with one atomic load when nothing is pending.
+class MarkerQueue {
+
+public:
+
+    static constexpr uint32_t capacity = 16;        // Power of 2. Keys come every 30 ms at most: plenty
+
+    // [Producer side] false if the queue is full (the key is dropped)
+    bool push( char key ) {
+
+        uint32_t tail = writePos.load(std::memory_order_relaxed);
+
+        if ( tail - readPos.load(std::memory_order_acquire) == capacity )
+            return false;
+
+        keys[tail & (capacity - 1)] = key;
+        writePos.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // [Consumer side] false if the queue is empty
+    bool pop( char& key ) {
+
+        uint32_t head = readPos.load(std::memory_order_relaxed);
+
+        if ( head == writePos.load(std::memory_order_acquire) )
+            return false;
+
+        key = keys[head & (capacity - 1)];
+        readPos.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+private:
+
+    char keys[capacity] { 0 };
+
+    alignas(64) std::atomic<uint32_t> writePos { 0 };
+    alignas(64) std::atomic<uint32_t> readPos { 0 };
+
+};
+
+
+#endif //TRACKBALLCONTROL_MARKERQUEUE_H
@@ -0,0 +1,149 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "NetworkSender.h"
+#include <iostream>
+#include <vector>
+#include <sys/prctl.h>
+
+
+NetworkSender::~NetworkSender() {
+    stop();
+}
+
+void NetworkSender::setIdleWait( std::chrono::microseconds wait ) {
+    idleWait = wait;
+}
+
+int NetworkSender::start( NetworkSink& sink, SampleReader reader ) {
+
+    if ( running || !sink.isOpen() )
+        return -1;
+
+    this->sink = &sink;
+    this->reader = reader;
+
+    samples = 0;
+    dropped = 0;
+    highWater = 0;
+    wakeups = 0;
+
+    running = true;
+    sender = std::thread(&NetworkSender::run, this);
+
+    return 0;
+}
+
+void NetworkSender::stop() {
+
+    if ( !running )
+        return;
+
+    running = false;
+    sender.join();
+}
+
+bool NetworkSender::isRunning() const {
+    return running;
+}
+
+NetworkSender::Stats NetworkSender::getStats() const {
+
+    Stats stats;
+    stats.samples = samples;
+    stats.dropped = dropped;
+    stats.highWater = highWater;
+    stats.wakeups = wakeups;
+
+    return stats;
+}
+
+void NetworkSender::printStats() const {
+
+    Stats stats = getStats();
+
+    std::cout << "Network sender: " << stats.samples << " samples (" << stats.dropped << " dropped), "
+              << stats.highWater << " waiting at most, " << stats.wakeups << " wake-ups" << std::endl;
+}
+
+
+// Private methods
+void NetworkSender::run() {
+
+    // The default 50 us timer slack would add up to half the idle wait to every sample's latency
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+    std::vector<Sample> batch(256);
+    uint64_t lost = reader.dropped();
+
+    while ( true ) {
+
+        // Noted before draining, so the samples published up to stop() still go out
+        bool stopping = !running;
+
+        wakeups++;
+
+        uint64_t waiting = reader.available();
+        if ( waiting > highWater )
+            highWater = waiting;
+
+        size_t n;
+
+        while ( ( n = reader.read(batch.data(), batch.size()) ) > 0 ) {
+
+            uint64_t nowLost = reader.dropped();
+            if ( nowLost != lost ) {
+                sink->skip(static_cast<uint32_t>(nowLost - lost));
+                dropped += nowLost - lost;
+                lost = nowLost;
+            }
+
+            for ( size_t k = 0; k < n; k++ )
+                send(batch[k]);
+
+            samples += n;
+        }
+
+        // Batched records must not wait longer than the latency bound, even if no new sample comes
+        sink->poll();
+
+        if ( stopping )
+            break;
+
+        std::this_thread::sleep_for(idleWait);
+    }
+}
+
+void NetworkSender::send( const Sample& sample ) {
+
+    // Raw mode: the 8 bytes as read from the firmware, rebuilt from the decoded sample
+    if ( !sink->isBatching() ) {
+
+        unsigned char raw[8] { 0 };
+        for ( int i = 0; i < 2; i++ ) {
+            raw[i] = static_cast<unsigned char>(sample.motion[i+4]);
+            raw[i+2] = static_cast<unsigned char>(sample.motion[i+6]);
+            raw[i+4] = static_cast<unsigned char>(sample.motion[i+8]);
+        }
+        raw[6] = sample.button;
+
+        sink->sendRaw(raw, sizeof(raw), sample.timestamp);
+        return;
+    }
+
+    WireRecord record;
+    record.count = static_cast<uint32_t>(sample.count);
+    record.timestamp = sample.timestamp;
+    for ( int i = 0; i < 2; i++ ) {
+        record.x[i] = sample.motion[i];
+        record.y[i] = sample.motion[i+2];
+        record.dx[i] = static_cast<signed char>(sample.motion[i+4]);
+        record.dy[i] = static_cast<signed char>(sample.motion[i+6]);
+        record.sq[i] = static_cast<unsigned char>(sample.motion[i+8]);
+    }
+    record.button = sample.button;
+    record.marker = static_cast<unsigned char>(sample.marker);
+
+    sink->append(record);
+}
@@ -0,0 +1,67 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_NETWORKSENDER_H
+#define TRACKBALLCONTROL_NETWORKSENDER_H
+
+#include "SampleRing.h"
+#include "NetworkSink.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+
+// Runs a NetworkSink on a thread of its own, fed by the SampleRing: the acquisition thread only publishes the
+// samples (no lock, no syscall), and a slow send, a full socket buffer or an unreachable receiver only delay
+// this thread. The ring is the queue between the two: if the sender falls more than a full ring behind,
+// the oldest samples are dropped, and their sequence numbers are skipped so the receivers see the hole.
+//
+// The sink must be configured before start(), and must not be used by anyone else until stop().
+class NetworkSender {
+
+public:
+
+    struct Stats {
+        uint64_t samples = 0;           // Samples handed to the sink
+        uint64_t dropped = 0;           // Overwritten in the ring before the sender got to them
+        uint64_t highWater = 0;         // Most samples waiting in the ring at once
+        uint64_t wakeups = 0;
+    };
+
+    NetworkSender() = default;
+    ~NetworkSender();
+
+    NetworkSender( const NetworkSender& ) = delete;
+    NetworkSender& operator=( const NetworkSender& ) = delete;
+
+    // How long the thread sleeps when the ring is empty. Default is 100 us
+    void setIdleWait( std::chrono::microseconds wait );
+
+    int start( NetworkSink& sink, SampleReader reader );
+    void stop();                        // Sends what is still in the ring first. The sink stays open
+    bool isRunning() const;
+
+    Stats getStats() const;
+    void printStats() const;
+
+private:
+
+    void run();
+    void send( const Sample& sample );
+
+    NetworkSink *sink { nullptr };
+    SampleReader reader;
+    std::thread sender;
+    std::atomic<bool> running { false };
+    std::chrono::nanoseconds idleWait { 100000 };
+
+    std::atomic<uint64_t> samples { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+    std::atomic<uint64_t> highWater { 0 };
+    std::atomic<uint64_t> wakeups { 0 };
+
+};
+
+
+#endif //TRACKBALLCONTROL_NETWORKSENDER_H
@@ -0,0 +1,727 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "NetworkSink.h"
+#include "Clock.h"
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <chrono>
+
+
+NetworkSink::~NetworkSink() {
+    close();
+}
+
+int NetworkSink::open( const std::string& hostname, const std::string& service_or_port ) {
+
+    int r{ 1 };
+
+    close();
+
+    // Populate the socket object
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    if ( sock < 0 ) {
+        std::cout << "Can't create the network socket (" << strerror(errno) << ")" << std::endl;
+        return 1;
+    }
+
+    int reusePort = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &reusePort, sizeof(reusePort));
+
+    // Populate the sockaddr_in struct
+    sockaddr_in addrTb = { };           // Trackball address struct
+    addrTb.sin_family = AF_INET;    // IPv4 only
+    addrTb.sin_port = 0x0A1A;       // Port 6666
+
+    // Bind: Assigns a network name to our socket
+    r = bind( sock, (sockaddr*)&addrTb, sizeof(addrTb) );
+
+    if ( r != 0 ) {
+        std::cout << errno;
+        ::close(sock);
+        sock = -1;
+        return 1;
+    }
+
+    stats = Stats();
+    sequence = 0;
+
+    // New stream ID (see WireProtocol.h)
+    streamId = static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count()) ^ static_cast<uint32_t>(getpid());
+
+    if ( addDestination(hostname, service_or_port) != 0 ) {
+        ::close(sock);
+        sock = -1;
+        return 2;
+    }
+
+    return 0;
+}
+
+void NetworkSink::close() {
+
+    if ( sock < 0 )
+        return;
+
+    // The samples aggregated since the last record of a decimated destination still go out
+    for ( auto& destination : destinations )
+        if ( destination.decimated() && destination.pendingSamples > 0 )
+            emit(destination);
+
+    flush();
+
+    // Every queued datagram must be sent before the socket goes away
+    if ( ring.isOpen() ) {
+        while ( ring.inFlight() > 0 || ring.queued() > 0 ) {
+            int r = ring.submit(1);
+            if ( r < 0 && r != -EINTR && r != -EBUSY )
+                break;
+            reap();
+        }
+        ring.close();
+    }
+
+    ::close(sock);
+    sock = -1;
+    destinations.clear();
+    fullRate = 0;
+    decimatedCount = 0;
+}
+
+bool NetworkSink::isOpen() const {
+    return sock >= 0;
+}
+
+int NetworkSink::addDestination( const std::string& hostname, const std::string& service_or_port ) {
+
+    if ( sock < 0 || destinations.size() >= maxDestinations )
+        return -1;
+
+    // Temporary struct of discovered internet addresses
+    addrinfo* foundAddresses { nullptr };
+
+    // This hints struct is a skeleton of which results we want to select from the discovered addresses struct
+    addrinfo hints { };
+    hints.ai_family = AF_INET;             // Typically AF_INET or AF_INET6 (IPv4 or IPv6), or AF_UNSPEC (= 0) for "any"
+    hints.ai_socktype = SOCK_DGRAM;        // SOCK_STREAM (TCP) or SOCK_DGRAM (UDP), or 0 for "any"
+    hints.ai_protocol = IPPROTO_UDP;       // IPPROTO_UDP or IPPROTO_TCP, or IPPROTO_IP (= 0) for "any". When ai_protocol is 0, UDP is used for SOCK_DGRAM and TCP is used for SOCK_STREAM
+    hints.ai_flags = AI_NUMERICSERV;       // AI_NUMERICSERV specifies not to try to do server name resolution
+
+    // Query network and get all matching addresses
+    int r = getaddrinfo( hostname.c_str(), service_or_port.c_str(), &hints, &foundAddresses );
+
+    if ( r != 0 ) {
+        std::cout << "Can't resolve " << hostname << ":" << service_or_port << " (" << gai_strerror(r) << ")" << std::endl;
+        return -1;
+    }
+
+    // Copy the first match, then delete the foundAddresses struct
+    Destination destination;
+    memcpy( &destination.address, foundAddresses->ai_addr, foundAddresses->ai_addrlen );
+    destination.length = foundAddresses->ai_addrlen;
+    freeaddrinfo( foundAddresses );
+
+    // Everything queued so far goes to the previous destinations only
+    flush();
+
+    destinations.push_back(destination);
+    fullRate++;
+    reserve();
+
+    return 0;
+}
+
+size_t NetworkSink::destinationCount() const {
+    return destinations.size();
+}
+
+int NetworkSink::setDecimation( size_t destination, int factor, double rate ) {
+
+    if ( destination >= destinations.size() || factor < 1 || rate < 0.0 )
+        return -1;
+
+    if ( !batching && ( factor > 1 || rate > 0.0 ) ) {
+        std::cout << "Decimated outputs need the batched mode: raw samples can't be aggregated" << std::endl;
+        return -1;
+    }
+
+    // What was queued so far was meant for the previous setting
+    flush();
+
+    Destination& d = destinations[destination];
+
+    d.decimation = ( rate > 0.0 ) ? 1 : factor;
+    d.period = ( rate > 0.0 ) ? static_cast<int64_t>(1e9 / rate) : 0;
+    d.pendingSamples = 0;
+    d.nextRecord = 0;
+    d.buffered = 0;
+
+    fullRate = 0;
+    decimatedCount = 0;
+    for ( auto& other : destinations )
+        ( other.decimated() ? decimatedCount : fullRate )++;
+
+    reserve();
+
+    return 0;
+}
+
+int NetworkSink::setMulticast( int ttl, const std::string& interface ) {
+
+    if ( sock < 0 )
+        return -1;
+
+    unsigned char multicastTTL = static_cast<unsigned char>(ttl);
+    if ( setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &multicastTTL, sizeof(multicastTTL)) != 0 ) {
+        std::cout << "Can't set the multicast TTL (" << strerror(errno) << ")" << std::endl;
+        return -1;
+    }
+
+    if ( interface.empty() )
+        return 0;
+
+    // Either the address of the interface, or its name
+    ip_mreqn request = { };
+
+    if ( inet_pton(AF_INET, interface.c_str(), &request.imr_address) != 1 ) {
+        request.imr_ifindex = static_cast<int>(if_nametoindex(interface.c_str()));
+        if ( request.imr_ifindex == 0 ) {
+            std::cout << "Unknown network interface " << interface << std::endl;
+            return -1;
+        }
+    }
+
+    if ( setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof(request)) != 0 ) {
+        std::cout << "Can't send multicast through " << interface << " (" << strerror(errno) << ")" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int NetworkSink::setBatching( int recordsPerDatagram, int datagramsPerFlush, std::chrono::microseconds latency ) {
+
+    if ( recordsPerDatagram < 1 || recordsPerDatagram > maxRecordsPerDatagram ) {
+        std::cout << "The number of samples per datagram must be between 1 and " << maxRecordsPerDatagram << std::endl;
+        return -1;
+    }
+
+    if ( datagramsPerFlush < 1 || datagramsPerFlush > maxDatagramsPerFlush ) {
+        std::cout << "The number of datagrams per send must be between 1 and " << maxDatagramsPerFlush << std::endl;
+        return -1;
+    }
+
+    flush();
+
+    this->recordsPerDatagram = recordsPerDatagram;
+    this->datagramsPerFlush = datagramsPerFlush;
+    this->latency = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+
+    // Everything is allocated here, so append() and flush() never allocate
+    datagramSize = wireHeaderSize + static_cast<size_t>(recordsPerDatagram) * wireRecordSize;
+    buffer.assign(datagramSize * static_cast<size_t>(datagramsPerFlush), 0);
+    batching = true;
+    reserve();
+
+    return 0;
+}
+
+bool NetworkSink::isBatching() const {
+    return batching;
+}
+
+void NetworkSink::setCompression( bool enabled ) {
+
+    flush();
+
+    compression = enabled;
+    reserve();
+}
+
+int NetworkSink::setIoUring( bool enabled ) {
+
+    if ( sock < 0 )
+        return -1;
+
+    flush();
+
+    if ( !enabled ) {
+        while ( ring.inFlight() > 0 || ring.queued() > 0 ) {
+            int r = ring.submit(1);
+            if ( r < 0 && r != -EINTR && r != -EBUSY )
+                break;
+            reap();
+        }
+        ring.close();
+        return 0;
+    }
+
+    if ( ring.isOpen() )
+        return 0;
+
+    // Room for every pool buffer sent to a few destinations; more just waits for the next submit
+    int r = ring.init(1024);
+    if ( r != 0 ) {
+        std::cout << "io_uring isn't available (" << strerror(-r) << "), sending with sendmmsg()" << std::endl;
+        return -1;
+    }
+
+    // Allocated once: queue() only takes and returns buffers
+    pool.assign(poolSize, PoolBuffer());
+    freeBuffers.clear();
+    for ( int b = poolSize - 1; b >= 0; b-- )
+        freeBuffers.push_back(b);
+
+    return 0;
+}
+
+bool NetworkSink::usesIoUring() const {
+    return ring.isOpen();
+}
+
+void NetworkSink::setStreamId( uint32_t id ) {
+    streamId = id;
+}
+
+uint32_t NetworkSink::getStreamId() const {
+    return streamId;
+}
+
+void NetworkSink::sendRaw( const unsigned char *data, size_t length, int64_t timestamp ) {
+
+    pieces[0].iov_base = const_cast<unsigned char*>(data);
+    pieces[0].iov_len = length;
+
+    stats.samples++;
+    send(1);
+
+    if ( timestamp != 0 )
+        sendLatency.record(monotonicNs() - timestamp);
+}
+
+void NetworkSink::append( WireRecord record ) {
+
+    stats.samples++;
+
+    if ( decimatedCount > 0 )
+        for ( auto& destination : destinations )
+            if ( destination.decimated() )
+                aggregate(destination, record);
+
+    if ( fullRate == 0 )
+        return;
+
+    if ( buffered == 0 )
+        oldest = record.timestamp;
+
+    // Records go right behind their datagram's header, which is only written at flush time
+    int datagram = buffered / recordsPerDatagram;
+    int slot = buffered % recordsPerDatagram;
+    unsigned char *p = &buffer[datagramSize * datagram + wireHeaderSize + wireRecordSize * slot];
+
+    record.sequence = sequence++;
+    encodeWireRecord(record, p);
+
+    buffered++;
+
+    if ( buffered == recordsPerDatagram * datagramsPerFlush || latency == 0 )
+        flush();
+}
+
+void NetworkSink::poll() {
+
+    if ( ring.isOpen() && ring.inFlight() > 0 )
+        reap();
+
+    if ( buffered == 0 && decimatedCount == 0 )
+        return;
+
+    int64_t now = monotonicNs();
+
+    if ( buffered > 0 && now - oldest >= latency )
+        flush();
+
+    if ( decimatedCount > 0 )
+        for ( auto& destination : destinations )
+            if ( destination.buffered > 0 && now - destination.oldest >= latency )
+                flush(destination);
+}
+
+void NetworkSink::flush() {
+
+    if ( sock < 0 )
+        return;
+
+    if ( decimatedCount > 0 )
+        for ( auto& destination : destinations )
+            flush(destination);
+
+    if ( buffered == 0 )
+        return;
+
+    // Full datagrams, and the last one with whatever is left
+    int datagrams = (buffered + recordsPerDatagram - 1) / recordsPerDatagram;
+
+    for ( int d = 0; d < datagrams; d++ ) {
+
+        int records = std::min(recordsPerDatagram, buffered - d * recordsPerDatagram);
+        unsigned char *datagram = &buffer[datagramSize * d];
+
+        encodeWireHeader(streamId, static_cast<uint16_t>(records), datagram);
+
+        pieces[d].iov_base = datagram;
+        pieces[d].iov_len = wireHeaderSize + static_cast<size_t>(records) * wireRecordSize;
+
+        stats.uncompressedBytes += pieces[d].iov_len * static_cast<uint64_t>(fullRate);
+
+        if ( compression ) {
+            size_t length = pack(datagram, records, &packed[datagramSize * d]);
+            if ( length > 0 ) {
+                pieces[d].iov_base = &packed[datagramSize * d];
+                pieces[d].iov_len = length;
+            }
+        }
+    }
+
+    send(datagrams);
+    buffered = 0;
+
+    sendLatency.record(monotonicNs() - oldest);
+}
+
+void NetworkSink::skip( uint32_t samples ) {
+
+    // The records of a compressed datagram must follow each other
+    if ( compression && buffered > 0 )
+        flush();
+
+    sequence += samples;
+}
+
+NetworkSink::Stats NetworkSink::getStats() const {
+    return stats;
+}
+
+const Histogram& NetworkSink::getSendLatency() const {
+    return sendLatency;
+}
+
+void NetworkSink::printStats() const {
+
+    std::cout << "Network" << ( ring.isOpen() ? " (io_uring)" : "" ) << ": " << stats.samples << " samples in " << stats.datagrams << " datagrams, "
+              << stats.sendCalls << " send calls (" << stats.sendErrors << " errors";
+
+    if ( ring.isOpen() || stats.shortSends > 0 || stats.poolExhausted > 0 )
+        std::cout << ", " << stats.shortSends << " short, " << stats.poolExhausted << " dropped with no free buffer";
+
+    std::cout << "), " << stats.bytes << " bytes";
+
+    if ( compression && stats.uncompressedBytes > 0 )
+        std::cout << " (" << std::fixed << std::setprecision(1) << 100.0 * static_cast<double>(stats.bytes) / static_cast<double>(stats.uncompressedBytes)
+                  << " % of the uncompressed size)";
+
+    std::cout << std::endl;
+
+    if ( sendLatency.count() > 0 )
+        sendLatency.print("Network send latency");
+}
+
+
+// Private methods
+void NetworkSink::reserve() {
+
+    // Allocated here rather than when sending, so the acquisition thread never allocates
+    size_t datagrams = batching ? static_cast<size_t>(datagramsPerFlush) : 1;
+
+    pieces.assign(datagrams, iovec { });
+    packed.assign(compression ? datagramSize * datagrams : 0, 0);
+    messages.assign(datagrams * std::max<size_t>(destinations.size(), 1), mmsghdr { });
+
+    // A decimated destination sends one datagram at a time, from its own buffer
+    for ( auto& destination : destinations )
+        destination.buffer.assign(destination.decimated() ? datagramSize : 0, 0);
+}
+
+void NetworkSink::send( int datagrams ) {
+
+    if ( fullRate == 0 )
+        return;
+
+    for ( int d = 0; d < datagrams; d++ )
+        stats.bytes += pieces[d].iov_len * static_cast<uint64_t>(fullRate);
+
+    if ( ring.isOpen() ) {
+        for ( int d = 0; d < datagrams; d++ )
+            queue(pieces[d].iov_base, pieces[d].iov_len, nullptr);
+
+        ring.submit(0);
+        stats.sendCalls++;
+        return;
+    }
+
+    // The same iovec for every destination: nothing is copied per destination
+    int count = 0;
+
+    for ( int d = 0; d < datagrams; d++ ) {
+        for ( auto& destination : destinations ) {
+
+            if ( destination.decimated() )
+                continue;
+
+            mmsghdr& message = messages[count++];
+
+            message = mmsghdr { };
+            message.msg_hdr.msg_name = &destination.address;
+            message.msg_hdr.msg_namelen = destination.length;
+            message.msg_hdr.msg_iov = &pieces[d];
+            message.msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    // sendmmsg() may stop early: go on from the first datagram it didn't send, and drop the rest on error
+    int sent = 0;
+
+    while ( sent < count ) {
+
+        int r = sendmmsg(sock, &messages[sent], static_cast<unsigned int>(count - sent), 0);
+        stats.sendCalls++;
+
+        if ( r <= 0 ) {
+            stats.sendErrors++;
+            std::cout << "Error sending data" << std::endl;
+            break;
+        }
+
+        sent += r;
+    }
+
+    stats.datagrams += static_cast<uint64_t>(sent);
+}
+
+void NetworkSink::aggregate( Destination& destination, const WireRecord& record ) {
+
+    WireRecord& pending = destination.pending;
+
+    // A record carries one marker: the interval holding one already ends here, ahead of schedule
+    if ( destination.pendingSamples > 0 && pending.marker != 0 && record.marker != 0 )
+        emit(destination);
+
+    if ( destination.pendingSamples == 0 ) {
+        pending = record;
+        for ( int i = 0; i < 2; i++ ) {
+            destination.pendingDelta[i] = record.dx[i];
+            destination.pendingDelta[i+2] = record.dy[i];
+        }
+    } else {
+        // Positions, count and time of the latest sample; everything else accumulates over the interval
+        pending.count = record.count;
+        pending.timestamp = record.timestamp;
+        for ( int i = 0; i < 2; i++ ) {
+            pending.x[i] = record.x[i];
+            pending.y[i] = record.y[i];
+            pending.sq[i] = std::min(pending.sq[i], record.sq[i]);
+            destination.pendingDelta[i] += record.dx[i];
+            destination.pendingDelta[i+2] += record.dy[i];
+        }
+        pending.button &= record.button;        // Bit 4 cleared = pressed
+        if ( record.marker != 0 )
+            pending.marker = record.marker;
+    }
+
+    destination.pendingSamples++;
+
+    if ( destination.period > 0 ) {
+
+        // The first sample goes out right away, then one record per period
+        if ( record.timestamp < destination.nextRecord )
+            return;
+
+        destination.nextRecord += destination.period;
+        if ( destination.nextRecord <= record.timestamp )
+            destination.nextRecord = record.timestamp + destination.period;     // First record, or after a pause
+
+    } else if ( destination.pendingSamples < destination.decimation ) {
+        return;
+    }
+
+    emit(destination);
+}
+
+void NetworkSink::emit( Destination& destination ) {
+
+    WireRecord& pending = destination.pending;
+
+    for ( int i = 0; i < 2; i++ ) {
+        pending.dx[i] = static_cast<signed char>(std::max(-128, std::min(127, destination.pendingDelta[i])));
+        pending.dy[i] = static_cast<signed char>(std::max(-128, std::min(127, destination.pendingDelta[i+2])));
+    }
+
+    pending.sequence = destination.sequence++;
+
+    if ( destination.buffered == 0 )
+        destination.oldest = pending.timestamp;
+
+    encodeWireRecord(pending, &destination.buffer[wireHeaderSize + wireRecordSize * static_cast<size_t>(destination.buffered)]);
+
+    destination.buffered++;
+    destination.pendingSamples = 0;
+
+    if ( destination.buffered == recordsPerDatagram || latency == 0 )
+        flush(destination);
+}
+
+void NetworkSink::flush( Destination& destination ) {
+
+    if ( destination.buffered == 0 )
+        return;
+
+    encodeWireHeader(streamId, static_cast<uint16_t>(destination.buffered), destination.buffer.data());
+
+    const unsigned char *datagram = destination.buffer.data();
+    size_t length = wireHeaderSize + static_cast<size_t>(destination.buffered) * wireRecordSize;
+
+    stats.uncompressedBytes += length;
+
+    if ( compression ) {
+        size_t packedLength = pack(datagram, destination.buffered, packed.data());
+        if ( packedLength > 0 ) {
+            datagram = packed.data();
+            length = packedLength;
+        }
+    }
+
+    stats.bytes += length;
+
+    if ( ring.isOpen() ) {
+        queue(datagram, length, &destination);
+        ring.submit(0);
+        stats.sendCalls++;
+    } else {
+        ssize_t r = sendto(sock, datagram, length, 0, (sockaddr*)&destination.address, destination.length);
+        stats.sendCalls++;
+
+        if ( r < 0 ) {
+            stats.sendErrors++;
+            std::cout << "Error sending data" << std::endl;
+        } else {
+            stats.datagrams++;
+        }
+    }
+
+    destination.buffered = 0;
+
+    sendLatency.record(monotonicNs() - destination.oldest);
+}
+
+size_t NetworkSink::pack( const unsigned char *datagram, int records, unsigned char *out ) {
+
+    packer.clear();
+    for ( int k = 0; k < records; k++ )
+        packer.append(WireRecordView(datagram + wireHeaderSize + wireRecordSize * static_cast<size_t>(k)).record());
+
+    // Random motion, or a single record, can come out larger: those datagrams stay as they are
+    size_t length = wireCompressedHeaderSize + packer.size();
+    if ( length >= wireHeaderSize + static_cast<size_t>(records) * wireRecordSize )
+        return 0;
+
+    uint32_t first = WireRecordView(datagram + wireHeaderSize).sequence();
+    encodeCompressedHeader(streamId, static_cast<uint16_t>(records), first, static_cast<uint16_t>(packer.size()), out);
+    memcpy(out + wireCompressedHeaderSize, packer.data(), packer.size());
+
+    return length;
+}
+
+void NetworkSink::queue( const void *data, size_t length, const Destination *only ) {
+
+    if ( freeBuffers.empty() )
+        reap();
+
+    // Still nothing: the network is that far behind, better drop this datagram than block the acquisition
+    if ( freeBuffers.empty() ) {
+        stats.poolExhausted++;
+        return;
+    }
+
+    int index = freeBuffers.back();
+    freeBuffers.pop_back();
+
+    PoolBuffer& buffer = pool[index];
+    memcpy(buffer.data, data, length);
+    buffer.length = length;
+    buffer.piece.iov_base = buffer.data;
+    buffer.piece.iov_len = length;
+    // One reference held while the messages are queued, so completions reaped in between can't free the buffer
+    buffer.references = 1;
+    int k = 0;
+
+    for ( auto& destination : destinations ) {
+
+        if ( only ? &destination != only : destination.decimated() )
+            continue;
+
+        buffer.addresses[k] = destination.address;
+        buffer.messages[k] = msghdr { };
+        buffer.messages[k].msg_name = &buffer.addresses[k];
+        buffer.messages[k].msg_namelen = destination.length;
+        buffer.messages[k].msg_iov = &buffer.piece;
+        buffer.messages[k].msg_iovlen = 1;
+
+        bool queued = ring.sendMessage(sock, &buffer.messages[k], static_cast<uint64_t>(index));
+
+        // A full submission ring: hand it to the kernel, which frees the entries. If it refuses them (a full completion
+        // ring, EBUSY, or EAGAIN), reaping makes room for the next attempt
+        if ( !queued ) {
+            if ( ring.submit(0) < 0 )
+                reap();
+            else
+                stats.sendCalls++;
+
+            queued = ring.sendMessage(sock, &buffer.messages[k], static_cast<uint64_t>(index));
+        }
+
+        // Still no room: this destination misses the datagram, rather than the acquisition waiting for the kernel
+        if ( !queued ) {
+            stats.sendErrors++;
+            continue;
+        }
+
+        buffer.references++;
+        k++;
+    }
+
+    if ( --buffer.references == 0 )
+        freeBuffers.push_back(index);
+}
+
+void NetworkSink::reap() {
+
+    IoRing::Completion completions[64];
+    size_t n;
+
+    while ( ( n = ring.reap(completions, 64) ) > 0 ) {
+        for ( size_t k = 0; k < n; k++ ) {
+
+            int index = static_cast<int>(completions[k].userData);
+            PoolBuffer& buffer = pool[index];
+
+            if ( completions[k].result < 0 )
+                stats.sendErrors++;
+            else if ( static_cast<size_t>(completions[k].result) < buffer.length )
+                stats.shortSends++;
+            else
+                stats.datagrams++;
+
+            if ( --buffer.references == 0 )
+                freeBuffers.push_back(index);
+        }
+    }
+}
@@ -0,0 +1,190 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_NETWORKSINK_H
+#define TRACKBALLCONTROL_NETWORKSINK_H
+
+#include "WireProtocol.h"
+#include "IoRing.h"
+#include "Histogram.h"
+#include "DeltaCodec.h"
+#include <netdb.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// UDP output of the samples.
+//
+// Raw mode (the default) sends each sample on its own, as the 8 raw bytes read from the firmware.
+// Batched mode sends decoded, sequence-numbered records (see WireProtocol.h), several records per datagram,
+// and hands several datagrams at once to sendmmsg().
+// A flush happens when all the datagrams are full, or when the oldest buffered sample is older than the latency bound.
+//
+// Every datagram goes to all the destinations (unicast or IPv4 multicast) through the same socket:
+// the samples are encoded once, and one sendmmsg() call covers every datagram for every destination.
+//
+// In batched mode a destination can also take fewer records than the acquisition rate (one every N samples, or
+// a target rate): each of its records then aggregates all the samples since its previous one. The positions are
+// the integrated ones of the last sample, so they stay exact; DX/DY are the sums of the deltas (saturated to the
+// i8 range, the positions being the reference), SQ is the worst of the interval, the button is pressed if it was
+// pressed at any point, and a marker is never dropped (a second marker within an interval sends the record holding
+// the first one right away). Such a destination has its own sequence numbers and datagrams.
+//
+// With setCompression(), each datagram of the batched mode goes out as one block of deltas (see DeltaCodec.h)
+// whenever that is smaller. Every datagram still decodes on its own, so a lost datagram loses nothing else.
+//
+// With setIoUring(), the datagrams are copied into a preallocated pool and queued as io_uring send requests,
+// one submission per flush: the calling thread doesn't wait for the kernel's network stack, and the completions
+// (errors, short sends) are collected later without syscall.
+class NetworkSink {
+
+public:
+
+    static constexpr int maxRecordsPerDatagram = 36;        // 16 + 36 x 40 = 1456 bytes, fits in one Ethernet frame
+    static constexpr int maxDatagramsPerFlush = 64;
+    static constexpr int maxDestinations = 16;
+
+    struct Stats {
+        uint64_t samples = 0;
+        uint64_t datagrams = 0;         // Counted once per destination
+        uint64_t sendCalls = 0;         // sendmmsg() calls
+        uint64_t sendErrors = 0;        // [io_uring] Including the datagrams that found no room in the submission ring
+        uint64_t shortSends = 0;        // [io_uring] Datagrams sent incomplete
+        uint64_t poolExhausted = 0;     // [io_uring] Datagrams dropped: every pool buffer was still in flight
+        uint64_t bytes = 0;             // Handed to the kernel, counted once per destination
+        uint64_t uncompressedBytes = 0; // [Compression] What they would have been without it
+    };
+
+    NetworkSink() = default;
+    ~NetworkSink();
+
+    NetworkSink( const NetworkSink& ) = delete;
+    NetworkSink& operator=( const NetworkSink& ) = delete;
+
+    // Opens the socket and adds a first destination
+    int open( const std::string& hostname, const std::string& service_or_port );
+    void close();                       // Flushes what is still buffered first
+    bool isOpen() const;
+
+    // Additional receivers, after open(). A 224.0.0.0/4 address is a multicast group
+    int addDestination( const std::string& hostname, const std::string& service_or_port );
+    size_t destinationCount() const;
+
+    // [Batched mode] One record every 'factor' samples, or at most 'rate' records per second (rate > 0 wins).
+    // factor = 1 and rate = 0 is the full rate
+    int setDecimation( size_t destination, int factor, double rate = 0.0 );
+
+    // Multicast TTL (1 = stay on the local network), and the outgoing interface, by IPv4 address or by name
+    // ("" = let the routing table choose)
+    int setMulticast( int ttl, const std::string& interface = "" );
+
+    // recordsPerDatagram = 1 and datagramsPerFlush = 1 (or latency = 0) sends every sample right away,
+    // but with its sequence number
+    int setBatching( int recordsPerDatagram, int datagramsPerFlush, std::chrono::microseconds latency );
+    bool isBatching() const;
+
+    // [Batched mode] Compressed datagrams ("TBWC", see DeltaCodec.h), each one only if it comes out smaller
+    void setCompression( bool enabled );
+
+    // After open(). Falls back to sendmmsg() (with a message) where io_uring isn't available
+    int setIoUring( bool enabled );
+    bool usesIoUring() const;
+
+    // Identifies this sender in the datagrams (see WireProtocol.h). A new one is picked at each open()
+    void setStreamId( uint32_t id );
+    uint32_t getStreamId() const;
+
+    // [Raw mode] timestamp: the sample's monotonicNs() time, for the send latency (0 = not measured)
+    void sendRaw( const unsigned char *data, size_t length, int64_t timestamp = 0 );
+
+    // [Batched mode] The sequence number is filled in here, the timestamp must be the sample's monotonicNs() time
+    void append( WireRecord record );
+    void poll();                        // Flushes if the latency bound has passed (cheap when nothing is buffered)
+    void flush();
+    // Samples that never reached the sink: they still take their sequence numbers, so the receivers count them as lost
+    void skip( uint32_t samples );
+
+    Stats getStats() const;
+    const Histogram& getSendLatency() const;    // From the sample's timestamp to its datagram handed to the kernel
+    void printStats() const;
+
+private:
+
+    struct Destination {
+        sockaddr_storage address = { };
+        socklen_t length = 0;
+
+        // Decimated destinations only
+        int decimation = 1;
+        int64_t period = 0;                     // ns, from the target rate
+        WireRecord pending;                     // Aggregate of the samples since the last record
+        int pendingSamples = 0;
+        int pendingDelta[4] { 0 };              // DX0 DX1 DY0 DY1, summed at full width before saturating
+        int64_t nextRecord = 0;                 // Target rate: the pending record is complete past this time
+        std::vector<unsigned char> buffer;      // One datagram of its own records
+        int buffered = 0;
+        int64_t oldest = 0;
+        uint32_t sequence = 0;
+
+        bool decimated() const { return decimation > 1 || period > 0; }
+    };
+
+    void reserve();                     // Sizes the message arrays for the current batching and destinations
+    void send( int datagrams );         // pieces[0..datagrams) to every full-rate destination
+    // [io_uring] A datagram being sent: its own copy of the bytes and of the addresses, until every send completes
+    struct PoolBuffer {
+        unsigned char data[wireHeaderSize + maxRecordsPerDatagram * wireRecordSize];
+        size_t length = 0;
+        iovec piece = { };
+        sockaddr_storage addresses[maxDestinations];
+        msghdr messages[maxDestinations];
+        int references = 0;
+    };
+
+    static constexpr int poolSize = 256;
+
+    void queue( const void *data, size_t length, const Destination *only );    // only = nullptr: every full-rate destination
+    void reap();
+    void aggregate( Destination& destination, const WireRecord& record );
+    void emit( Destination& destination );  // Queues the pending aggregate as one record
+    void flush( Destination& destination );
+    size_t pack( const unsigned char *datagram, int records, unsigned char *out );     // 0 if it isn't smaller
+
+    int sock = -1;
+    std::vector<Destination> destinations;
+
+    bool batching = false;
+    int recordsPerDatagram = 1;
+    int datagramsPerFlush = 1;
+    int64_t latency = 0;                // ns
+
+    std::vector<unsigned char> buffer;  // datagramsPerFlush x (header + recordsPerDatagram records)
+    size_t datagramSize = 0;            // Largest datagram, in bytes
+    std::vector<mmsghdr> messages;
+    std::vector<iovec> pieces;
+    int buffered = 0;                   // Records in the buffer
+    int fullRate = 0;                   // Destinations that get every sample
+    int decimatedCount = 0;
+    int64_t oldest = 0;                 // Timestamp of the first buffered record
+    uint32_t sequence = 0;
+    uint32_t streamId = 0;
+
+    bool compression = false;
+    DeltaBlockWriter packer { maxRecordsPerDatagram };
+    std::vector<unsigned char> packed;  // Compressed datagrams, one slot per datagram of the buffer
+
+    IoRing ring;
+    std::vector<PoolBuffer> pool;
+    std::vector<int> freeBuffers;
+
+    Stats stats;
+    Histogram sendLatency;              // One value per send: the oldest record of the datagrams
+
+};
+
+
+#endif //TRACKBALLCONTROL_NETWORKSINK_H
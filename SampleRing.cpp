@@ -0,0 +1,124 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "SampleRing.h"
+
+
+SampleRing::SampleRing( size_t capacity ) {
+
+    size_t size = 1;
+    while ( size < capacity )
+        size <<= 1;
+
+    // The only allocation the ring ever makes
+    slots = std::vector<Slot>(size);
+    mask = size - 1;
+}
+
+void SampleRing::publish( const Sample& sample ) {
+
+    uint64_t position = head.load(std::memory_order_relaxed);
+    Slot& slot = slots[position & mask];
+
+    // Mark the slot as being written, so a reader copying it at the same time knows to throw its copy away
+    slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.sample = sample;
+
+    slot.sequence.store(2 * position + 2, std::memory_order_release);
+    head.store(position + 1, std::memory_order_release);
+}
+
+SampleReader SampleRing::reader() const {
+    return SampleReader(this, head.load(std::memory_order_acquire));
+}
+
+bool SampleRing::latest( Sample& sample ) const {
+
+    // The producer can lap us between loading the head and copying, so just retry with the new head
+    for ( int tries = 0; tries < 16; tries++ ) {
+
+        uint64_t position = head.load(std::memory_order_acquire);
+        if ( position == 0 )
+            return false;
+
+        if ( readSlot(position - 1, sample) )
+            return true;
+    }
+
+    return false;
+}
+
+uint64_t SampleRing::published() const {
+    return head.load(std::memory_order_acquire);
+}
+
+size_t SampleRing::capacity() const {
+    return slots.size();
+}
+
+bool SampleRing::readSlot( uint64_t position, Sample& sample ) const {
+
+    const Slot& slot = slots[position & mask];
+
+    uint64_t before = slot.sequence.load(std::memory_order_acquire);
+    if ( before != 2 * position + 2 )
+        return false;
+
+    sample = slot.sample;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+
+    return after == before;
+}
+
+
+SampleReader::SampleReader( const SampleRing *ring, uint64_t cursor ) {
+    this->ring = ring;
+    this->cursor = cursor;
+}
+
+size_t SampleReader::read( Sample *samples, size_t max ) {
+
+    if ( !ring )
+        return 0;
+
+    size_t n = 0;
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+
+    while ( cursor < head && n < max ) {
+
+        // More than a full ring behind: the oldest samples are gone, skip to the oldest one still there
+        uint64_t oldest = ( head > ring->slots.size() ) ? head - ring->slots.size() : 0;
+
+        if ( cursor < oldest ) {
+            lost += oldest - cursor;
+            cursor = oldest;
+        }
+
+        if ( ring->readSlot(cursor, samples[n]) ) {
+            n++;
+            cursor++;
+        } else {
+            // Overwritten while we were copying it: reload the head and resynchronise
+            head = ring->head.load(std::memory_order_acquire);
+            if ( head - cursor <= ring->slots.size() ) {
+                lost++;
+                cursor++;
+            }
+        }
+    }
+
+    return n;
+}
+
+uint64_t SampleReader::available() const {
+    return ring ? ring->published() - cursor : 0;
+}
+
+uint64_t SampleReader::dropped() const {
+    return lost;
+}
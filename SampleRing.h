@@ -0,0 +1,91 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_SAMPLERING_H
+#define TRACKBALLCONTROL_SAMPLERING_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+// One decoded motion sample, as published by Trackball::acquire()
+struct Sample {
+    int64_t timestamp = 0;          // Host time of the sample: monotonicNs() at USB completion
+    int count = 0;                  // Acquisition count (ackCount)
+    int motion[10] { 0 };           // Same layout as Trackball's formattedBuffer (X0 X1 Y0 Y1 DX0 DX1 DY0 DY1 SQ0 SQ1)
+    unsigned char button = 0x10;    // Raw button byte from the firmware (0x10 = not pressed)
+    char marker = 0;                // First key pressed (Trackball::marker()) since the previous sample, 0 = none
+};
+
+
+class SampleReader;
+
+// Lock-free ring of samples with a single producer (the acquisition thread) and any number of readers.
+// The producer never blocks and never allocates: it overwrites the oldest sample when the ring is full.
+// Each reader keeps its own cursor, drains everything published since its last read,
+// and counts the samples it lost if it fell more than a full ring behind.
+class SampleRing {
+
+public:
+
+    explicit SampleRing( size_t capacity = 1 << 16 );     // Rounded up to a power of 2
+
+    // [Producer side]
+    void publish( const Sample& sample );
+
+    // [Consumer side]
+    SampleReader reader() const;                    // Starts at the next published sample
+    bool latest( Sample& sample ) const;            // Most recent sample, false if nothing was published yet
+
+    uint64_t published() const;
+    size_t capacity() const;
+
+private:
+
+    friend class SampleReader;
+
+    // The slot sequence is odd while the producer writes it, and 2 * (position + 1) once it holds that position
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence { 0 };
+        Sample sample;
+    };
+
+    bool readSlot( uint64_t position, Sample& sample ) const;
+
+    std::vector<Slot> slots;
+    uint64_t mask;
+
+    alignas(64) std::atomic<uint64_t> head { 0 };      // Next position to be written
+
+};
+
+
+class SampleReader {
+
+public:
+
+    SampleReader() = default;
+
+    // Copy up to 'max' samples published since the last read, oldest first. Returns the number of samples copied
+    size_t read( Sample *samples, size_t max );
+
+    uint64_t available() const;         // Samples published and not read yet (including the ones already lost)
+    uint64_t dropped() const;           // Samples overwritten before this reader got to them
+
+private:
+
+    friend class SampleRing;
+
+    SampleReader( const SampleRing *ring, uint64_t cursor );
+
+    const SampleRing *ring { nullptr };
+    uint64_t cursor = 0;
+    uint64_t lost = 0;
+
+};
+
+
+#endif //TRACKBALLCONTROL_SAMPLERING_H
@@ -0,0 +1,151 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "SessionLog.h"
+#include <cstring>
+#include <fstream>
+
+
+// Little-endian helpers, so the files are the same whatever machine wrote them
+static void putU16( unsigned char *p, uint16_t v ) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+}
+
+static void putU32( unsigned char *p, uint32_t v ) {
+    for ( int i = 0; i < 4; i++ )
+        p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+static void putU64( unsigned char *p, uint64_t v ) {
+    for ( int i = 0; i < 8; i++ )
+        p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+static void putF64( unsigned char *p, double v ) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    putU64(p, bits);
+}
+
+static uint16_t getU16( const unsigned char *p ) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32( const unsigned char *p ) {
+    uint32_t v = 0;
+    for ( int i = 3; i >= 0; i-- )
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t getU64( const unsigned char *p ) {
+    uint64_t v = 0;
+    for ( int i = 7; i >= 0; i-- )
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static double getF64( const unsigned char *p ) {
+    uint64_t bits = getU64(p);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+
+void encodeSessionHeader( const SessionHeader& header, unsigned char *buffer ) {
+
+    memset(buffer, 0, sessionHeaderSize);
+
+    memcpy(buffer, "TBSL", 4);
+    putU16(buffer + 4, header.version);
+    putU16(buffer + 6, static_cast<uint16_t>(sessionHeaderSize));
+    putU16(buffer + 8, static_cast<uint16_t>(header.compressed ? 0 : sessionRecordSize));
+    buffer[10] = header.sensorID[0];
+    buffer[11] = header.sensorID[1];
+    buffer[12] = header.sensorRev[0];
+    buffer[13] = header.sensorRev[1];
+    putU64(buffer + 16, header.firmwareHash);
+    putF64(buffer + 24, header.sampleRate);
+    putF64(buffer + 32, header.calibration[0]);
+    putF64(buffer + 40, header.calibration[1]);
+    putU64(buffer + 48, static_cast<uint64_t>(header.startTime));
+}
+
+int decodeSessionHeader( const unsigned char *buffer, SessionHeader& header ) {
+
+    if ( memcmp(buffer, "TBSL", 4) != 0 )
+        return -1;
+
+    header.version = getU16(buffer + 4);
+
+    // Only the layout of version 1 is known
+    uint16_t recordSize = getU16(buffer + 8);
+    if ( header.version != sessionVersion || getU16(buffer + 6) != sessionHeaderSize
+                                          || ( recordSize != sessionRecordSize && recordSize != 0 ) )
+        return -1;
+
+    header.compressed = ( recordSize == 0 );
+
+    header.sensorID[0] = buffer[10];
+    header.sensorID[1] = buffer[11];
+    header.sensorRev[0] = buffer[12];
+    header.sensorRev[1] = buffer[13];
+    header.firmwareHash = getU64(buffer + 16);
+    header.sampleRate = getF64(buffer + 24);
+    header.calibration[0] = getF64(buffer + 32);
+    header.calibration[1] = getF64(buffer + 40);
+    header.startTime = static_cast<int64_t>(getU64(buffer + 48));
+
+    return 0;
+}
+
+void encodeSessionRecord( const SessionRecord& record, unsigned char *buffer ) {
+
+    putU32(buffer, record.count);
+    putU64(buffer + 4, static_cast<uint64_t>(record.timestamp));
+    buffer[12] = static_cast<unsigned char>(record.dx[0]);
+    buffer[13] = static_cast<unsigned char>(record.dx[1]);
+    buffer[14] = static_cast<unsigned char>(record.dy[0]);
+    buffer[15] = static_cast<unsigned char>(record.dy[1]);
+    buffer[16] = record.sq[0];
+    buffer[17] = record.sq[1];
+    buffer[18] = record.button;
+    buffer[19] = record.marker;
+}
+
+void decodeSessionRecord( const unsigned char *buffer, SessionRecord& record ) {
+
+    record.count = getU32(buffer);
+    record.timestamp = static_cast<int64_t>(getU64(buffer + 4));
+    record.dx[0] = static_cast<signed char>(buffer[12]);
+    record.dx[1] = static_cast<signed char>(buffer[13]);
+    record.dy[0] = static_cast<signed char>(buffer[14]);
+    record.dy[1] = static_cast<signed char>(buffer[15]);
+    record.sq[0] = buffer[16];
+    record.sq[1] = buffer[17];
+    record.button = buffer[18];
+    record.marker = buffer[19];
+}
+
+uint64_t hashFile( const std::string& path ) {
+
+    std::ifstream input(path.c_str(), std::ios::binary);
+
+    if ( !input )
+        return 0;
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    char chunk[4096];
+
+    while ( input.read(chunk, sizeof(chunk)) || input.gcount() > 0 ) {
+        for ( std::streamsize i = 0; i < input.gcount(); i++ ) {
+            hash ^= static_cast<unsigned char>(chunk[i]);
+            hash *= 0x100000001b3ULL;
+        }
+    }
+
+    return hash;
+}
@@ -0,0 +1,67 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_SESSIONLOG_H
+#define TRACKBALLCONTROL_SESSIONLOG_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+
+// Binary session log (.tbs): one header, then fixed-size records, everything little-endian.
+//
+// ------------------------------------------- Header (64 bytes) -------------------------------------------
+// | magic "TBSL" | version u16 | header size u16 | record size u16 | sensor IDs u8[2] | sensor revs u8[2] |
+// | (2 bytes padding) | firmware hash u64 | sample rate f64 | cal0 f64 | cal1 f64 | start time i64 | (padding)
+//
+// ------------------------------------------- Record (20 bytes) -------------------------------------------
+// | count u32 | timestamp i64 | DX0 i8 | DX1 i8 | DY0 i8 | DY1 i8 | SQ0 u8 | SQ1 u8 | button u8 | marker u8 |
+//
+// A record with a non-zero marker is a key press ('o', 'p'...) attached to the sample 'count'.
+// Its DX/DY are 0, so integrating every record still gives the right positions.
+//
+// A compressed log has a record size of 0 in its header, and the same records come in blocks (see DeltaCodec.h),
+// each one with the positions integrated so far in its keyframe:
+//
+// ------------------------------------------- Block ---------------------------------------------------------
+// | payload size u16 | record count u16 | payload (a keyframe, then deltas and idle runs) |
+
+const uint16_t sessionVersion = 1;
+constexpr size_t sessionHeaderSize = 64;
+constexpr size_t sessionRecordSize = 20;
+constexpr size_t sessionBlockHeaderSize = 4;
+constexpr size_t sessionBlockRecords = 256;         // Records per block of a compressed log, at most
+
+struct SessionHeader {
+    uint16_t version = sessionVersion;
+    unsigned char sensorID[2] { 0 };
+    unsigned char sensorRev[2] { 0 };
+    uint64_t firmwareHash = 0;          // FNV-1a of the firmware file (0 if unknown)
+    double sampleRate = 0.0;            // Nominal sample rate in Hz (0 = unpaced)
+    double calibration[2] { 0.0 };      // Sensor counts per ball rotation
+    int64_t startTime = 0;              // Wall-clock time at the start of the session, in ns since the Unix epoch
+    bool compressed = false;            // Records in compressed blocks
+};
+
+struct SessionRecord {
+    uint32_t count = 0;
+    int64_t timestamp = 0;              // Host time of the sample: CLOCK_MONOTONIC_RAW ns at USB completion
+    signed char dx[2] { 0 };
+    signed char dy[2] { 0 };
+    unsigned char sq[2] { 0 };
+    unsigned char button = 0x10;
+    unsigned char marker = 0;
+};
+
+void encodeSessionHeader( const SessionHeader& header, unsigned char *buffer );
+int decodeSessionHeader( const unsigned char *buffer, SessionHeader& header );    // -1 if not a session log
+void encodeSessionRecord( const SessionRecord& record, unsigned char *buffer );
+void decodeSessionRecord( const unsigned char *buffer, SessionRecord& record );
+
+// FNV-1a 64-bit hash of a file's content (0 if it can't be read)
+uint64_t hashFile( const std::string& path );
+
+
+#endif //TRACKBALLCONTROL_SESSIONLOG_H
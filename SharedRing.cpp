@@ -0,0 +1,389 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "SharedRing.h"
+#include "Clock.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+
+// Shared (not private) futex operations: the waiters are in other processes
+static void futexWake( std::atomic<uint32_t> *word ) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static void futexWait( const std::atomic<uint32_t> *word, uint32_t expected, const timespec *timeout ) {
+    syscall(SYS_futex, reinterpret_cast<const uint32_t*>(word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+static size_t pageAligned( size_t bytes ) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (bytes + page - 1) / page * page;
+}
+
+
+SharedRingWriter::~SharedRingWriter() {
+    close();
+}
+
+int SharedRingWriter::create( const std::string& name, size_t capacity ) {
+
+    close();
+
+    size_t size = 1;
+    while ( size < capacity )
+        size <<= 1;
+
+    size_t waitersOffset = pageAligned(sizeof(SharedRingHeader));
+    size_t slotsOffset = waitersOffset + pageAligned(sizeof(SharedRingWaiters));
+    size_t total = slotsOffset + size * sizeof(SharedSlot);
+
+    // A ring left behind by a previous run: readers still mapping it keep their copy, new ones get ours
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if ( fd < 0 ) {
+        std::cout << "Can't create the shared memory ring " << name << " (" << strerror(errno) << ")" << std::endl;
+        return -1;
+    }
+
+    if ( ftruncate(fd, static_cast<off_t>(total)) != 0 ) {
+        std::cout << "Can't size the shared memory ring " << name << " (" << strerror(errno) << ")" << std::endl;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return -1;
+    }
+
+    void *p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if ( p == MAP_FAILED ) {
+        std::cout << "Can't map the shared memory ring " << name << " (" << strerror(errno) << ")" << std::endl;
+        shm_unlink(name.c_str());
+        return -1;
+    }
+
+    // Fault every page in now rather than in the acquisition loop
+    memset(p, 0, total);
+
+    this->name = name;
+    memory = p;
+    length = total;
+    header = static_cast<SharedRingHeader*>(p);
+    waiters = reinterpret_cast<SharedRingWaiters*>(static_cast<char*>(p) + waitersOffset);
+    slots = reinterpret_cast<SharedSlot*>(static_cast<char*>(p) + slotsOffset);
+    mask = size - 1;
+
+    header->version = sharedRingVersion;
+    header->slotSize = sizeof(SharedSlot);
+    header->streamId = static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count()) ^ static_cast<uint32_t>(getpid());
+    header->capacity = size;
+    header->waitersOffset = waitersOffset;
+    header->slotsOffset = slotsOffset;
+    header->producerPid = getpid();
+    header->alive.store(1, std::memory_order_relaxed);
+
+    // The magic goes last: a reader opening the ring before this point sees zeros and gives up
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, "TBSR", 4);
+
+    return 0;
+}
+
+void SharedRingWriter::close() {
+
+    if ( !memory )
+        return;
+
+    header->alive.store(0, std::memory_order_seq_cst);
+    header->published.fetch_add(1, std::memory_order_seq_cst);
+    futexWake(&header->published);
+
+    munmap(memory, length);
+    shm_unlink(name.c_str());
+
+    memory = nullptr;
+    header = nullptr;
+    waiters = nullptr;
+    slots = nullptr;
+}
+
+bool SharedRingWriter::isOpen() const {
+    return memory != nullptr;
+}
+
+void SharedRingWriter::publish( const Sample& sample ) {
+
+    uint64_t position = header->head.load(std::memory_order_relaxed);
+    SharedSlot& slot = slots[position & mask];
+
+    // Same seqlock as SampleRing::publish()
+    slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.publishTime = monotonicNs();
+    slot.sample = sample;
+
+    slot.sequence.store(2 * position + 2, std::memory_order_release);
+    header->head.store(position + 1, std::memory_order_release);
+
+    // Pairs with the waiters count increment in SharedRingReader::wait(): either the reader sees the new value
+    // of the futex word and doesn't sleep, or we see it waiting and wake it up. No syscall when nobody waits
+    header->published.store(static_cast<uint32_t>(position + 1), std::memory_order_seq_cst);
+    if ( waiters->count.load(std::memory_order_seq_cst) != 0 )
+        futexWake(&header->published);
+}
+
+const std::string& SharedRingWriter::getName() const {
+    return name;
+}
+
+
+SharedRingReader::~SharedRingReader() {
+    close();
+}
+
+int SharedRingReader::open( const std::string& name, bool waitable ) {
+
+    close();
+
+    int fd = shm_open(name.c_str(), waitable ? O_RDWR : O_RDONLY, 0);
+    if ( fd < 0 ) {
+        std::cout << "Can't open the shared memory ring " << name << " (" << strerror(errno) << ")" << std::endl;
+        return -1;
+    }
+
+    // The header first, to learn the size of the rest
+    struct stat status { };
+    size_t headerLength = pageAligned(sizeof(SharedRingHeader));
+
+    if ( fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < headerLength ) {
+        std::cout << "The shared memory ring " << name << " isn't ready" << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    void *p = mmap(nullptr, headerLength, PROT_READ, MAP_SHARED, fd, 0);
+    if ( p == MAP_FAILED ) {
+        ::close(fd);
+        return -1;
+    }
+
+    const SharedRingHeader *h = static_cast<const SharedRingHeader*>(p);
+    bool valid = memcmp(h->magic, "TBSR", 4) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    valid = valid && h->version >= 1 && h->slotSize == sizeof(SharedSlot) && h->capacity != 0
+            && (h->capacity & (h->capacity - 1)) == 0
+            && static_cast<size_t>(status.st_size) >= h->slotsOffset + h->capacity * sizeof(SharedSlot);
+
+    size_t total = valid ? h->slotsOffset + h->capacity * sizeof(SharedSlot) : 0;
+    size_t waitersOffset = valid ? h->waitersOffset : 0;
+    munmap(p, headerLength);
+
+    if ( !valid ) {
+        std::cout << "The shared memory ring " << name << " isn't ready or isn't compatible" << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    // The samples are never written through our mapping
+    p = mmap(nullptr, total, PROT_READ, MAP_SHARED, fd, 0);
+    if ( p == MAP_FAILED ) {
+        std::cout << "Can't map the shared memory ring " << name << " (" << strerror(errno) << ")" << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    memory = p;
+    length = total;
+    header = static_cast<const SharedRingHeader*>(p);
+    slots = reinterpret_cast<const SharedSlot*>(static_cast<const char*>(p) + header->slotsOffset);
+    capacity = header->capacity;
+    mask = capacity - 1;
+
+    // Only the waiters count is writable
+    if ( waitable ) {
+        waitersPage = mmap(nullptr, pageAligned(sizeof(SharedRingWaiters)), PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(waitersOffset));
+        if ( waitersPage == MAP_FAILED )
+            waitersPage = nullptr;
+        waiters = static_cast<SharedRingWaiters*>(waitersPage);
+    }
+
+    ::close(fd);
+
+    cursor = header->head.load(std::memory_order_acquire);
+    lost = 0;
+
+    return 0;
+}
+
+void SharedRingReader::close() {
+
+    if ( waitersPage )
+        munmap(waitersPage, pageAligned(sizeof(SharedRingWaiters)));
+    if ( memory )
+        munmap(memory, length);
+
+    memory = nullptr;
+    waitersPage = nullptr;
+    header = nullptr;
+    waiters = nullptr;
+    slots = nullptr;
+}
+
+bool SharedRingReader::isOpen() const {
+    return memory != nullptr;
+}
+
+size_t SharedRingReader::read( Sample *samples, size_t max, int64_t *publishTimes ) {
+
+    if ( !header )
+        return 0;
+
+    size_t n = 0;
+    uint64_t head = header->head.load(std::memory_order_acquire);
+
+    while ( cursor < head && n < max ) {
+
+        // More than a full ring behind: the oldest samples are gone, skip to the oldest one still there
+        uint64_t oldest = ( head > capacity ) ? head - capacity : 0;
+
+        if ( cursor < oldest ) {
+            lost += oldest - cursor;
+            cursor = oldest;
+        }
+
+        if ( readSlot(cursor, samples[n], publishTimes ? &publishTimes[n] : nullptr) ) {
+            n++;
+            cursor++;
+        } else {
+            // Overwritten while we were copying it: reload the head and resynchronise
+            head = header->head.load(std::memory_order_acquire);
+            if ( head - cursor <= capacity ) {
+                lost++;
+                cursor++;
+            }
+        }
+    }
+
+    return n;
+}
+
+bool SharedRingReader::wait( int64_t timeoutNs ) {
+
+    if ( !header )
+        return false;
+
+    if ( cursor < header->head.load(std::memory_order_acquire) )
+        return true;
+
+    if ( !waiters )
+        return false;
+
+    int64_t deadline = monotonicNs() + timeoutNs;
+
+    while ( header->alive.load(std::memory_order_acquire) ) {
+
+        waiters->count.fetch_add(1, std::memory_order_seq_cst);
+        uint32_t expected = header->published.load(std::memory_order_seq_cst);
+
+        if ( cursor < header->head.load(std::memory_order_acquire) ) {
+            waiters->count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        timespec timeout { };
+        if ( timeoutNs > 0 ) {
+            int64_t remaining = deadline - monotonicNs();
+            if ( remaining <= 0 ) {
+                waiters->count.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            timeout.tv_sec = remaining / 1000000000LL;
+            timeout.tv_nsec = remaining % 1000000000LL;
+        }
+
+        // Returns right away if a sample was published since we loaded 'expected'
+        futexWait(&header->published, expected, timeoutNs > 0 ? &timeout : nullptr);
+        waiters->count.fetch_sub(1, std::memory_order_relaxed);
+
+        if ( cursor < header->head.load(std::memory_order_acquire) )
+            return true;
+    }
+
+    return false;
+}
+
+bool SharedRingReader::latest( Sample& sample ) const {
+
+    if ( !header )
+        return false;
+
+    // The producer can lap us between loading the head and copying, so just retry with the new head
+    for ( int tries = 0; tries < 16; tries++ ) {
+
+        uint64_t position = header->head.load(std::memory_order_acquire);
+        if ( position == 0 )
+            return false;
+
+        if ( readSlot(position - 1, sample, nullptr) )
+            return true;
+    }
+
+    return false;
+}
+
+uint64_t SharedRingReader::available() const {
+    return header ? header->head.load(std::memory_order_acquire) - cursor : 0;
+}
+
+uint64_t SharedRingReader::dropped() const {
+    return lost;
+}
+
+bool SharedRingReader::producerAlive() const {
+
+    if ( !header || !header->alive.load(std::memory_order_acquire) )
+        return false;
+
+    // A producer that crashed never cleared 'alive'
+    return kill(header->producerPid, 0) == 0 || errno == EPERM;
+}
+
+uint32_t SharedRingReader::streamId() const {
+    return header ? header->streamId : 0;
+}
+
+
+// Private methods
+bool SharedRingReader::readSlot( uint64_t position, Sample& sample, int64_t *publishTime ) const {
+
+    const SharedSlot& slot = slots[position & mask];
+
+    uint64_t before = slot.sequence.load(std::memory_order_acquire);
+    if ( before != 2 * position + 2 )
+        return false;
+
+    sample = slot.sample;
+    int64_t time = slot.publishTime;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+
+    if ( publishTime )
+        *publishTime = time;
+
+    return after == before;
+}
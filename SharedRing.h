@@ -0,0 +1,144 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_SHAREDRING_H
+#define TRACKBALLCONTROL_SHAREDRING_H
+
+#include "SampleRing.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+
+// Sample ring in POSIX shared memory, for consumers running in other processes on the same machine
+// (a VR renderer closing the loop on the ball, for instance): no socket, no copy through the kernel, no syscall
+// on either side in the common case.
+//
+// Same protocol as SampleRing: one producer (Trackball), a per-slot seqlock, and a head index. Readers map the
+// samples read-only, each one keeps its own cursor, and a reader that falls more than a full ring behind
+// counts the samples it lost. Readers can either poll (the lowest latency, one core spinning), or sleep on a futex
+// until the next sample: the producer only makes the FUTEX_WAKE syscall when some reader is actually waiting.
+//
+// ----------------------------------------- Segment layout -----------------------------------------
+// | header page (read-only for the readers) | waiters page (read-write for waiting readers) | slots... |
+//
+// Everything is native-endian and uses the layout of the Sample struct: producer and readers must run on
+// the same machine, built by the same compiler (which is the point).
+
+constexpr uint32_t sharedRingVersion = 1;
+
+struct SharedRingHeader {
+    char magic[4];                              // "TBSR"
+    uint32_t version;
+    uint32_t slotSize;
+    uint32_t streamId;                          // New at each run (see WireProtocol.h)
+    uint64_t capacity;                          // Slots (power of 2)
+    uint64_t waitersOffset;                     // Page-aligned offsets of the other two parts, in bytes
+    uint64_t slotsOffset;
+    int32_t producerPid;
+
+    alignas(64) std::atomic<uint64_t> head;     // Next position to be written
+    std::atomic<uint32_t> published;            // Futex word: low 32 bits of head, bumped after each sample
+    std::atomic<uint32_t> alive;                // 0 once the producer has closed the ring
+};
+
+struct SharedRingWaiters {
+    std::atomic<uint32_t> count;                // Readers sleeping (or about to sleep) on the futex
+};
+
+// The slot sequence is odd while the producer writes it, and 2 * (position + 1) once it holds that position
+struct alignas(64) SharedSlot {
+    std::atomic<uint64_t> sequence;
+    int64_t publishTime;                        // monotonicNs() just before the sample was published
+    Sample sample;
+};
+
+
+// [Producer side] Owned by Trackball. Never blocks and never allocates after create()
+class SharedRingWriter {
+
+public:
+
+    SharedRingWriter() = default;
+    ~SharedRingWriter();
+
+    SharedRingWriter( const SharedRingWriter& ) = delete;
+    SharedRingWriter& operator=( const SharedRingWriter& ) = delete;
+
+    // name is a POSIX shared memory name ("/trackball"), capacity is rounded up to a power of 2
+    int create( const std::string& name, size_t capacity = 1 << 16 );
+    void close();                               // Wakes up the waiting readers and removes the name
+    bool isOpen() const;
+
+    void publish( const Sample& sample );
+
+    const std::string& getName() const;
+
+private:
+
+    std::string name;
+    void *memory { nullptr };
+    size_t length = 0;
+
+    SharedRingHeader *header { nullptr };
+    SharedRingWaiters *waiters { nullptr };
+    SharedSlot *slots { nullptr };
+    uint64_t mask = 0;
+
+};
+
+
+// [Consumer side] The whole reader library: link SharedRing.cpp (or the TrackballSharedRing library)
+class SharedRingReader {
+
+public:
+
+    SharedRingReader() = default;
+    ~SharedRingReader();
+
+    SharedRingReader( const SharedRingReader& ) = delete;
+    SharedRingReader& operator=( const SharedRingReader& ) = delete;
+
+    // Starts at the next published sample. 'waitable' also maps the waiters page read-write, which wait() needs
+    int open( const std::string& name, bool waitable = true );
+    void close();
+    bool isOpen() const;
+
+    // Copy up to 'max' samples published since the last read, oldest first. Returns the number of samples copied.
+    // publishTimes (optional) gets the producer's monotonicNs() at publication, for latency measurements
+    size_t read( Sample *samples, size_t max, int64_t *publishTimes = nullptr );
+
+    // Sleep until a sample is available, the producer closes the ring, or the timeout passes (0 = forever).
+    // Returns false on timeout or once the producer is gone
+    bool wait( int64_t timeoutNs = 0 );
+
+    bool latest( Sample& sample ) const;        // Most recent sample, false if nothing was published yet
+
+    uint64_t available() const;                 // Samples published and not read yet (including the ones already lost)
+    uint64_t dropped() const;                   // Samples overwritten before this reader got to them
+    bool producerAlive() const;
+    uint32_t streamId() const;
+
+private:
+
+    bool readSlot( uint64_t position, Sample& sample, int64_t *publishTime ) const;
+
+    void *memory { nullptr };
+    size_t length = 0;
+    void *waitersPage { nullptr };
+
+    const SharedRingHeader *header { nullptr };
+    SharedRingWaiters *waiters { nullptr };
+    const SharedSlot *slots { nullptr };
+    uint64_t capacity = 0;
+    uint64_t mask = 0;
+
+    uint64_t cursor = 0;
+    uint64_t lost = 0;
+
+};
+
+
+#endif //TRACKBALLCONTROL_SHAREDRING_H
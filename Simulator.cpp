@@ -0,0 +1,272 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "Simulator.h"
+#include <libusb-1.0/libusb.h>
+#include <algorithm>
+
+
+SimulatedTransport::SimulatedTransport( unsigned int seed ) {
+    rng = seed ? seed : 1;      // xorshift must never be seeded with 0
+}
+
+int SimulatedTransport::loadReplay( const std::string& csvFile ) {
+
+    std::ifstream input(csvFile.c_str());
+
+    if ( !input ) {
+        std::cout << "Could not open replay file " << csvFile << std::endl;
+        return -1;
+    }
+
+    std::string line;
+    getline(input, line);       // Skip the header
+
+    // Rows are "Count; X0; Y0; X1; Y1; SQ0; SQ1" with accumulated positions, so the deltas are the differences
+    int previous[4] { 0 };
+    int fields[7] { 0 };
+
+    replay.clear();
+
+    while ( getline(input, line) ) {
+
+        std::stringstream row(line);
+        std::string cell;
+        int n = 0;
+
+        while ( n < 7 && getline(row, cell, ';') )
+            fields[n++] = std::atoi(cell.c_str());
+
+        if ( n < 7 )
+            continue;
+
+        unsigned char record[7];
+        const int order[4] { 1, 3, 2, 4 };      // X0, X1, Y0, Y1 columns, in firmware order (DX0, DX1, DY0, DY1)
+
+        for ( int i = 0; i < 4; i++ ) {
+            int delta = fields[order[i]] - previous[i];
+            previous[i] = fields[order[i]];
+
+            delta = std::max(-128, std::min(127, delta));
+            record[i] = static_cast<unsigned char>(static_cast<signed char>(delta));
+        }
+
+        record[4] = static_cast<unsigned char>(fields[5]);
+        record[5] = static_cast<unsigned char>(fields[6]);
+        record[6] = 0x10;           // Button not pressed
+
+        replay.insert(replay.end(), record, record + 7);
+    }
+
+    replayPos = 0;
+
+    if ( replay.empty() ) {
+        std::cout << "No samples found in replay file " << csvFile << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int SimulatedTransport::bulkTransfer( unsigned char endpoint, unsigned char *data, int length, int *transferred,
+                                      unsigned int /*timeout*/ ) {
+
+    *transferred = 0;
+
+    // Host to device: the firmware only ever looks at the command bytes
+    if ( endpoint == endpointOUT ) {
+        handleCommand(data, length);
+        *transferred = length;
+        return 0;
+    }
+
+    if ( endpoint != endpointIN )
+        return LIBUSB_ERROR_INVALID_PARAM;
+
+    // Device to host: nothing armed means the real device would NAK until the timeout expires
+    if ( fifoHead == fifoTail )
+        return LIBUSB_ERROR_TIMEOUT;
+
+    // Like a libusb bulk read, keep concatenating packets until the buffer is full or a short packet ends the transfer
+    while ( fifoHead != fifoTail ) {
+
+        int packetLength = fifoLength[fifoHead];
+
+        if ( packetLength > length - *transferred )
+            return LIBUSB_ERROR_OVERFLOW;
+
+        memcpy(data + *transferred, fifo[fifoHead], packetLength);
+        *transferred += packetLength;
+        fifoHead = (fifoHead + 1) % fifoDepth;
+
+        if ( packetLength < maxPacketSize || *transferred == length )
+            break;
+    }
+
+    return 0;
+}
+
+unsigned long SimulatedTransport::getCommandCount() const {
+    return commandCount;
+}
+
+
+// Private methods
+void SimulatedTransport::handleCommand( const unsigned char *command, int length ) {
+
+    if ( length < 1 )
+        return;
+
+    commandCount++;
+
+    unsigned char addr = command[0];
+    unsigned char response[2] { 0 };
+
+    switch ( addr ) {
+
+        case ( CHIP_RESET | 0x80 ):
+        {
+            posX[0] = posX[1] = 0;
+            posY[0] = posY[1] = 0;
+            break;
+        }
+
+        case ( NAV_CTRL2 | 0x80 ):
+        {
+            break;      // Rest mode has no visible effect on the simulated sensors
+        }
+
+        case PIX_GRAB:
+        {
+            // 361 packets of 2 bytes, one pixel of each sensor per packet, 'Pixel valid' bit already cleared
+            for ( int k = 0; k < 361; k++ ) {
+
+                int row = k / 19;
+                int col = k % 19;
+
+                for ( int s = 0; s < 2; s++ )
+                    response[s] = static_cast<unsigned char>(((row + posY[s] / 8) * 5 + (col + posX[s] / 8) * 3) & 0x7F);
+
+                toHost(response, 2);
+            }
+            break;
+        }
+
+        case PIX_BURST:
+        {
+            // Same pixels, but as 64-byte packets of pixel pairs, the last one short (722 = 11 x 64 + 18)
+            unsigned char frame[722];
+            for ( int k = 0; k < 361; k++ ) {
+
+                int row = k / 19;
+                int col = k % 19;
+
+                for ( int s = 0; s < 2; s++ )
+                    frame[2*k + s] = static_cast<unsigned char>(((row + posY[s] / 8) * 5 + (col + posX[s] / 8) * 3) & 0x7F);
+            }
+
+            for ( int offset = 0; offset < 722; offset += maxPacketSize )
+                toHost(frame + offset, std::min(maxPacketSize, 722 - offset));
+            break;
+        }
+
+        case MOTION_ST:
+        {
+            unsigned char record[7];
+            motionRecord(record);
+            toHost(record, 7);
+            break;
+        }
+
+        case FW_INFO:
+        {
+            unsigned char info[4] { 'T', 'B', 'F', firmwareBurstVersion };
+            toHost(info, 4);
+            break;
+        }
+
+        case MOTION_BATCH:
+        {
+            int nbSamples = ( length < 2 ) ? 1 : command[1];
+            nbSamples = std::min(std::max(nbSamples, 1), maxMotionBatch);
+
+            unsigned char packet[maxMotionBatch * 7];
+            for ( int k = 0; k < nbSamples; k++ )
+                motionRecord(packet + k * 7);
+
+            toHost(packet, nbSamples * 7);
+            break;
+        }
+
+        default:
+        {
+            // Plain register read on both sensors
+            switch ( addr ) {
+                case PRODUCT_ID:
+                    response[0] = response[1] = ADNS5090_ID;
+                    break;
+                case REV_ID:
+                    response[0] = response[1] = 0x01;
+                    break;
+                case SQUAL:
+                    response[0] = squal[0];
+                    response[1] = squal[1];
+                    break;
+                default:
+                    break;
+            }
+            toHost(response, 2);
+        }
+    }
+}
+
+void SimulatedTransport::motionRecord( unsigned char *record ) {
+
+    // Same layout as the firmware's inBuf: DX0, DX1, DY0, DY1, SQ0, SQ1, button
+    if ( !replay.empty() ) {
+
+        memcpy(record, &replay[replayPos], 7);
+        replayPos = (replayPos + 7) % replay.size();
+
+    } else {
+
+        for ( int i = 0; i < 4; i++ )
+            record[i] = static_cast<unsigned char>(static_cast<signed char>(static_cast<int>(nextRandom() % 9) - 4));
+
+        for ( int s = 0; s < 2; s++ ) {
+            squal[s] = static_cast<unsigned char>(0x28 + nextRandom() % 16);
+            record[s+4] = squal[s];
+        }
+
+        record[6] = 0x10;       // IOB & 0x10: button not pressed
+    }
+
+    for ( int s = 0; s < 2; s++ ) {
+        posX[s] += static_cast<signed char>(record[s]);
+        posY[s] += static_cast<signed char>(record[s+2]);
+    }
+}
+
+void SimulatedTransport::toHost( const unsigned char *data, int length ) {
+
+    int next = (fifoTail + 1) % fifoDepth;
+
+    // The real firmware would block here until the host reads; the simulator just drops the packet
+    if ( next == fifoHead )
+        return;
+
+    memcpy(fifo[fifoTail], data, length);
+    fifoLength[fifoTail] = length;
+    fifoTail = next;
+}
+
+unsigned int SimulatedTransport::nextRandom() {
+
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+
+    return rng;
+}
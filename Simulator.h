@@ -0,0 +1,63 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_SIMULATOR_H
+#define TRACKBALLCONTROL_SIMULATOR_H
+
+#include "Transport.h"
+#include "Trackball.h"
+#include <vector>
+#include <string>
+
+
+// Software stand-in for the FX2 running Firmware/firmware.c.
+// It answers the same command bytes with the same packet sizes (MOTION_ST, MOTION_BATCH, PIX_GRAB, PIX_BURST, FW_INFO, SQUAL,
+// CHIP_RESET, NAV_CTRL2, and the 2-byte register read of the firmware's default case), so Trackball can be exercised without hardware.
+// Motion is either synthetic (a deterministic pseudo-random walk) or replayed from a previously recorded CSV file.
+class SimulatedTransport : public Transport {
+
+public:
+
+    explicit SimulatedTransport( unsigned int seed = 0x5EED );
+
+    // Replay the DX/DY/SQ of a session recorded in the usual CSV format (loops at the end of the file)
+    int loadReplay( const std::string& csvFile );
+
+    int bulkTransfer( unsigned char endpoint, unsigned char *data, int length, int *transferred,
+                      unsigned int timeout ) override;
+
+    // Commands received since construction (all command bytes, including the ones that get no answer)
+    unsigned long getCommandCount() const;
+
+private:
+
+    // Packets armed on EP1 IN and not read yet by the host
+    static const int fifoDepth = 512;
+    unsigned char fifo[fifoDepth][maxPacketSize] { { 0 } };
+    int fifoLength[fifoDepth] { 0 };
+    int fifoHead = 0;
+    int fifoTail = 0;
+
+    // Simulated sensors state
+    unsigned int rng;
+    int posX[2] { 0 };
+    int posY[2] { 0 };
+    unsigned char squal[2] { 0x30, 0x30 };
+
+    // One 7-byte firmware motion record per replayed sample
+    std::vector<unsigned char> replay;
+    size_t replayPos = 0;
+
+    unsigned long commandCount = 0;
+
+    void handleCommand( const unsigned char *command, int length );
+    void motionRecord( unsigned char *record );
+    void toHost( const unsigned char *data, int length );
+
+    unsigned int nextRandom();
+
+};
+
+
+#endif //TRACKBALLCONTROL_SIMULATOR_H
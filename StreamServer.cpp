@@ -0,0 +1,355 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "StreamServer.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+StreamServer::~StreamServer() {
+    stop();
+}
+
+void StreamServer::setQueueSize( size_t records ) {
+    queueSize = std::max<size_t>(records, 1);
+}
+
+void StreamServer::setSlowClientPolicy( SlowClientPolicy policy ) {
+    this->policy = policy;
+}
+
+int StreamServer::listenUnix( const std::string& path ) {
+
+    sockaddr_un address = { };
+    address.sun_family = AF_UNIX;
+
+    if ( running || path.size() >= sizeof(address.sun_path) ) {
+        std::cout << "Invalid stream socket path " << path << std::endl;
+        return -1;
+    }
+
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    // A socket file left behind by a previous run would make bind() fail
+    unlink(path.c_str());
+
+    if ( fd < 0 || bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 8) != 0 ) {
+        std::cout << "Can't listen on " << path << " (" << strerror(errno) << ")" << std::endl;
+        if ( fd >= 0 )
+            close(fd);
+        return -1;
+    }
+
+    listeners.push_back(fd);
+    unixPath = path;
+
+    return 0;
+}
+
+int StreamServer::listenTcp( const std::string& port ) {
+
+    if ( running )
+        return -1;
+
+    addrinfo hints { };
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+
+    addrinfo* foundAddresses { nullptr };
+
+    // Local clients only: loopback address
+    if ( getaddrinfo("127.0.0.1", port.c_str(), &hints, &foundAddresses) != 0 ) {
+        std::cout << "Invalid stream port " << port << std::endl;
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if ( fd < 0 ) {
+        std::cout << "Can't create the stream socket (" << strerror(errno) << ")" << std::endl;
+        freeaddrinfo(foundAddresses);
+        return -1;
+    }
+
+    int reuseAddress = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+    int r = bind(fd, foundAddresses->ai_addr, foundAddresses->ai_addrlen);
+    freeaddrinfo(foundAddresses);
+
+    if ( r != 0 || listen(fd, 8) != 0 ) {
+        std::cout << "Can't listen on port " << port << " (" << strerror(errno) << ")" << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    listeners.push_back(fd);
+
+    return 0;
+}
+
+int StreamServer::start( SampleReader reader ) {
+
+    if ( running || listeners.empty() )
+        return -1;
+
+    this->reader = reader;
+
+    // New stream ID (see WireProtocol.h)
+    streamId = static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count()) ^ static_cast<uint32_t>(getpid());
+
+    running = true;
+    server = std::thread(&StreamServer::run, this);
+
+    return 0;
+}
+
+void StreamServer::stop() {
+
+    if ( running ) {
+        running = false;
+        server.join();
+    }
+
+    for ( size_t i = clients.size(); i > 0; i-- )
+        drop(i - 1);
+
+    for ( int fd : listeners )
+        close(fd);
+    listeners.clear();
+
+    if ( !unixPath.empty() ) {
+        unlink(unixPath.c_str());
+        unixPath.clear();
+    }
+}
+
+size_t StreamServer::clientCount() const {
+    return connected;
+}
+
+StreamServer::Stats StreamServer::getStats() const {
+
+    Stats stats;
+    stats.samples = samples;
+    stats.ringDropped = ringDropped;
+    stats.clients = accepted;
+    stats.disconnected = disconnected;
+    stats.recordsSent = recordsSent;
+    stats.recordsDropped = recordsDropped;
+
+    return stats;
+}
+
+void StreamServer::printStats() const {
+
+    Stats stats = getStats();
+
+    std::cout << "Stream server: " << stats.samples << " samples (" << stats.ringDropped << " missed), "
+              << stats.clients << " clients (" << stats.disconnected << " disconnected), "
+              << stats.recordsSent << " records sent, " << stats.recordsDropped << " dropped from full queues" << std::endl;
+}
+
+
+// Private methods
+void StreamServer::run() {
+
+    std::vector<Sample> batch(256);
+    std::vector<pollfd> fds;
+    fds.reserve(listeners.size() + maxClients);
+
+    unsigned char record[wireRecordSize];
+    uint32_t sequence = 0;
+    uint64_t lost = reader.dropped();
+
+    while ( running ) {
+
+        // Everything published since the last round, encoded once for all the clients
+        size_t n = reader.read(batch.data(), batch.size());
+
+        // Samples overwritten before we got to them still take their sequence numbers, so the clients see the hole
+        uint64_t nowLost = reader.dropped();
+        sequence += static_cast<uint32_t>(nowLost - lost);
+        ringDropped += nowLost - lost;
+        lost = nowLost;
+
+        for ( size_t k = 0; k < n; k++ ) {
+
+            const Sample& sample = batch[k];
+
+            WireRecord wireRecord;
+            wireRecord.sequence = sequence++;
+            wireRecord.count = static_cast<uint32_t>(sample.count);
+            wireRecord.timestamp = sample.timestamp;
+            for ( int i = 0; i < 2; i++ ) {
+                wireRecord.x[i] = sample.motion[i];
+                wireRecord.y[i] = sample.motion[i+2];
+                wireRecord.dx[i] = static_cast<signed char>(sample.motion[i+4]);
+                wireRecord.dy[i] = static_cast<signed char>(sample.motion[i+6]);
+                wireRecord.sq[i] = static_cast<unsigned char>(sample.motion[i+8]);
+            }
+            wireRecord.button = sample.button;
+            wireRecord.marker = static_cast<unsigned char>(sample.marker);
+
+            encodeWireRecord(wireRecord, record);
+
+            for ( auto& client : clients )
+                enqueue(*client, record);
+        }
+
+        samples += n;
+
+        // Send what each client can take right now, without ever blocking on one of them
+        for ( size_t i = clients.size(); i > 0; i-- ) {
+            if ( !pump(*clients[i - 1]) ) {
+                disconnected++;
+                drop(i - 1);
+            }
+        }
+
+        // Wait for new clients, for room in the sockets of the clients that are behind, or for the next samples
+        fds.clear();
+        for ( int fd : listeners )
+            fds.push_back({ fd, POLLIN, 0 });
+        for ( auto& client : clients ) {
+            bool pending = client->frameSent < client->frameLength || client->count > 0;
+            fds.push_back({ client->fd, static_cast<short>(POLLIN | ( pending ? POLLOUT : 0 )), 0 });
+        }
+
+        // Don't wait if the ring had more samples than the batch could take
+        timespec timeout = { 0, ( n == batch.size() ) ? 0 : 500000 };
+        if ( ppoll(fds.data(), fds.size(), &timeout, nullptr) <= 0 )
+            continue;
+
+        // Clients don't send anything: readable means it hung up (or an error)
+        for ( size_t i = clients.size(); i > 0; i-- ) {
+
+            const pollfd& fd = fds[listeners.size() + i - 1];
+            if ( !( fd.revents & (POLLIN | POLLERR | POLLHUP) ) )
+                continue;
+
+            char discard[256];
+            ssize_t r = recv(fd.fd, discard, sizeof(discard), MSG_DONTWAIT);
+            if ( r == 0 || ( r < 0 && errno != EAGAIN && errno != EWOULDBLOCK ) )
+                drop(i - 1);
+        }
+
+        // New clients last, so the indices above still match fds
+        for ( size_t l = 0; l < listeners.size(); l++ )
+            if ( fds[l].revents & POLLIN )
+                accept(listeners[l]);
+    }
+}
+
+void StreamServer::accept( int listener ) {
+
+    int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if ( fd < 0 )
+        return;
+
+    if ( clients.size() >= maxClients ) {
+        close(fd);
+        return;
+    }
+
+    // Small frames must leave right away (fails harmlessly on Unix sockets)
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    auto client = std::make_unique<Client>();
+    client->fd = fd;
+    client->queue.resize(queueSize * wireRecordSize);
+
+    clients.push_back(std::move(client));
+    accepted++;
+    connected = clients.size();
+}
+
+void StreamServer::enqueue( Client& client, const unsigned char *record ) {
+
+    if ( client.fd < 0 )
+        return;
+
+    if ( client.count == queueSize ) {
+
+        // Closed right away, then removed from the list by the next pump()
+        if ( policy == SlowClientPolicy::Disconnect ) {
+            close(client.fd);
+            client.fd = -1;
+            return;
+        }
+
+        // Drop the oldest record that isn't already part of the frame being sent
+        client.head = (client.head + 1) % queueSize;
+        client.count--;
+        recordsDropped++;
+    }
+
+    size_t tail = (client.head + client.count) % queueSize;
+    memcpy(&client.queue[tail * wireRecordSize], record, wireRecordSize);
+    client.count++;
+}
+
+bool StreamServer::pump( Client& client ) {
+
+    if ( client.fd < 0 )
+        return false;
+
+    while ( true ) {
+
+        // Next frame: as many queued records as fit
+        if ( client.frameSent == client.frameLength ) {
+
+            if ( client.count == 0 )
+                return true;
+
+            size_t n = std::min<size_t>(client.count, 36);
+            encodeWireHeader(streamId, static_cast<uint16_t>(n), client.frame);
+
+            for ( size_t k = 0; k < n; k++ ) {
+                memcpy(client.frame + wireHeaderSize + k * wireRecordSize, &client.queue[client.head * wireRecordSize], wireRecordSize);
+                client.head = (client.head + 1) % queueSize;
+            }
+
+            client.count -= n;
+            client.frameLength = wireHeaderSize + n * wireRecordSize;
+            client.frameSent = 0;
+        }
+
+        ssize_t r = send(client.fd, client.frame + client.frameSent, client.frameLength - client.frameSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if ( r < 0 )
+            return errno == EAGAIN || errno == EWOULDBLOCK;     // Socket full: try again when poll() says so
+
+        client.frameSent += static_cast<size_t>(r);
+
+        if ( client.frameSent < client.frameLength )
+            return true;
+
+        // Counted only once the whole frame is out: a client dropped halfway didn't get it
+        recordsSent += (client.frameLength - wireHeaderSize) / wireRecordSize;
+    }
+}
+
+void StreamServer::drop( size_t index ) {
+
+    if ( clients[index]->fd >= 0 )
+        close(clients[index]->fd);
+
+    clients.erase(clients.begin() + static_cast<long>(index));
+    connected = clients.size();
+}
@@ -0,0 +1,102 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_STREAMSERVER_H
+#define TRACKBALLCONTROL_STREAMSERVER_H
+
+#include "SampleRing.h"
+#include "WireProtocol.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Local stream server: co-located processes connect to a Unix-domain socket (or a TCP port on the loopback)
+// and receive every sample, as a stream of WireProtocol.h frames (a header, then its records).
+//
+// The server runs on its own thread and reads the samples from the SampleRing, so the acquisition thread
+// never waits for it. Each client has its own bounded queue of records: when a client doesn't read fast
+// enough, either its oldest records are dropped (it sees holes in the sequence numbers) or it is disconnected.
+// Either way the other clients and acquire() carry on at full speed.
+class StreamServer {
+
+public:
+
+    enum class SlowClientPolicy { DropOldest, Disconnect };
+
+    static constexpr int maxClients = 32;
+
+    struct Stats {
+        uint64_t samples = 0;           // Samples read from the ring
+        uint64_t ringDropped = 0;       // Samples the server itself was too late to read
+        uint64_t clients = 0;           // Connections accepted
+        uint64_t disconnected = 0;      // Clients dropped for being too slow (or for a socket error)
+        uint64_t recordsSent = 0;       // In frames fully written to the sockets, all clients together
+        uint64_t recordsDropped = 0;    // Dropped from full client queues
+    };
+
+    StreamServer() = default;
+    ~StreamServer();
+
+    StreamServer( const StreamServer& ) = delete;
+    StreamServer& operator=( const StreamServer& ) = delete;
+
+    // Only before start()
+    void setQueueSize( size_t records );            // Per client. Default is 8192 records (about 1.6 s at 5 kHz)
+    void setSlowClientPolicy( SlowClientPolicy policy );
+    int listenUnix( const std::string& path );
+    int listenTcp( const std::string& port );       // Loopback only
+
+    int start( SampleReader reader );
+    void stop();
+
+    size_t clientCount() const;
+    Stats getStats() const;
+    void printStats() const;
+
+private:
+
+    struct Client {
+        int fd = -1;
+        std::vector<unsigned char> queue;           // Ring of encoded records
+        size_t head = 0;                            // Oldest queued record
+        size_t count = 0;                           // Queued records
+        unsigned char frame[wireHeaderSize + 36 * wireRecordSize];     // Frame being sent
+        size_t frameLength = 0;
+        size_t frameSent = 0;
+    };
+
+    void run();
+    void accept( int listener );
+    void enqueue( Client& client, const unsigned char *record );
+    bool pump( Client& client );                    // false if the client must be disconnected
+    void drop( size_t index );
+
+    std::vector<int> listeners;
+    std::string unixPath;
+
+    size_t queueSize = 8192;
+    SlowClientPolicy policy = SlowClientPolicy::DropOldest;
+
+    std::vector<std::unique_ptr<Client>> clients;   // Only touched by the server thread
+    std::atomic<size_t> connected { 0 };
+
+    SampleReader reader;
+    std::thread server;
+    std::atomic<bool> running { false };
+    uint32_t streamId = 0;
+
+    std::atomic<uint64_t> samples { 0 };
+    std::atomic<uint64_t> ringDropped { 0 };
+    std::atomic<uint64_t> accepted { 0 };
+    std::atomic<uint64_t> disconnected { 0 };
+    std::atomic<uint64_t> recordsSent { 0 };
+    std::atomic<uint64_t> recordsDropped { 0 };
+
+};
+
+
+#endif //TRACKBALLCONTROL_STREAMSERVER_H
@@ -0,0 +1,256 @@
+//
+// Created on 17/10/2026.
+//
+
+// Converts a binary session log (.tbs) back to the CSV files written by the Disk Write mode
+// (name.csv, name_P.csv and name_O.csv), byte for byte, so the existing analysis scripts keep working.
+// Compressed logs (--compress) are read the same way.
+// With --path, the freeball path of the ball (as on the trace) is also written, to name_path.csv.
+
+#include "../SessionLog.h"
+#include "../DeltaCodec.h"
+#include "../CsvFormatter.h"
+#include "../TrajectoryEngine.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+
+static void show_usage( std::string name )
+{
+    std::cerr << "Usage: " << name << " <option(s)> SESSION.tbs [OUTPUT_NAME]\n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message.\n"
+              << "\t-i,--info\t\tOnly print the session header.\n"
+              << "\t-t,--timestamps\t\tAdd the host timestamp (ns) of each sample, as with --csv-timestamps.\n"
+              << "\t-p,--path\t\tAlso write the freeball path (heading in radians, X and Y in mm) to OUTPUT_NAME_path.csv.\n"
+              << "OUTPUT_NAME defaults to the session file name without its extension.\n"
+              << std::endl;
+}
+
+static void printHeader( const SessionHeader& header )
+{
+    std::cout << "Session log version " << header.version << ( header.compressed ? ", compressed" : "" ) << "\n"
+              << "\tSensors:        0x" << std::hex << +header.sensorID[0] << " rev." << +header.sensorRev[0]
+              << ", 0x" << +header.sensorID[1] << " rev." << +header.sensorRev[1] << "\n"
+              << "\tFirmware hash:  0x" << header.firmwareHash << std::dec << "\n"
+              << "\tSample rate:    " << header.sampleRate << " Hz\n"
+              << "\tCalibration:    " << header.calibration[0] << ", " << header.calibration[1] << "\n"
+              << "\tStart time:     " << header.startTime << " ns" << std::endl;
+}
+
+static void writeRow( std::ofstream& file, const SessionRecord& record, const int *position, bool timestamps )
+{
+    // Same fixed-width layout as Trackball::acquire()
+    CsvFormatter row;
+
+    row.field(record.count);
+    row.field(position[0]);
+    row.field(position[2]);
+    row.field(position[1]);
+    row.field(position[3]);
+    row.field(record.sq[0]);
+    row.field(record.sq[1]);
+
+    if ( timestamps )
+        row.field(record.timestamp, CsvFormatter::timestampWidth);
+
+    row.endRow();
+
+    file.write(row.data(), static_cast<std::streamsize>(row.size()));
+}
+
+int main( int argc, char* argv[] )
+{
+    bool infoOnly = false;
+    bool timestamps = false;
+    bool path = false;
+    std::vector<std::string> remaining_args;
+
+    for ( int i = 1; i < argc; ++i ) {
+
+        std::string arg = argv[i];
+
+        if ( (arg == "-h") || (arg == "--help") ) {
+            show_usage(argv[0]);
+            return 0;
+        } else if ( (arg == "-i") || (arg == "--info") ) {
+            infoOnly = true;
+        } else if ( (arg == "-t") || (arg == "--timestamps") ) {
+            timestamps = true;
+        } else if ( (arg == "-p") || (arg == "--path") ) {
+            path = true;
+        } else {
+            remaining_args.push_back(arg);
+        }
+    }
+
+    if ( remaining_args.empty() || remaining_args.size() > 2 ) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    std::string inputName = remaining_args[0];
+    std::string outputName = ( remaining_args.size() == 2 ) ? remaining_args[1]
+                                                            : inputName.substr(0, inputName.find_last_of('.'));
+
+    std::ifstream input(inputName.c_str(), std::ios::binary);
+
+    unsigned char headerBytes[sessionHeaderSize];
+    SessionHeader header;
+
+    if ( !input.read(reinterpret_cast<char*>(headerBytes), sessionHeaderSize)
+         || decodeSessionHeader(headerBytes, header) != 0 ) {
+        std::cerr << inputName << " is not a session log." << std::endl;
+        return 1;
+    }
+
+    printHeader(header);
+
+    if ( infoOnly )
+        return 0;
+
+    std::ofstream dataA((outputName + ".csv").c_str());
+    std::ofstream dataP((outputName + "_P.csv").c_str());
+    std::ofstream dataO((outputName + "_O.csv").c_str());
+
+    if ( !dataA || !dataP || !dataO ) {
+        std::cerr << "Error writing files." << std::endl;
+        return 1;
+    }
+
+    std::string filesHeader = "  Count;     X0;     Y0;     X1;     Y1;    SQ0;    SQ1";
+
+    if ( timestamps )
+        filesHeader += ";           Timestamp";
+
+    dataA << filesHeader << "\n";
+    dataP << filesHeader << "\n";
+    dataO << filesHeader << "\n";
+
+    // Freeball path, integrated in batches with the session's calibration
+    std::ofstream dataPath;
+    TrajectoryEngine trajectory(header.calibration[0] > 0.0 ? header.calibration[0] : 1000.0,
+                                header.calibration[1] > 0.0 ? header.calibration[1] : 1000.0);
+    const size_t pathBatch = 4096;
+    std::vector<int> pathCount, dx0, dx1, dy0, dy1;
+    std::vector<double> heading(pathBatch), x(pathBatch), y(pathBatch);
+
+    if ( path ) {
+        dataPath.open((outputName + "_path.csv").c_str());
+        if ( !dataPath ) {
+            std::cerr << "Error writing files." << std::endl;
+            return 1;
+        }
+        dataPath << "  Count;   Heading;           X;           Y\n" << std::fixed;
+    }
+
+    auto writePath = [&]() {
+
+        trajectory.integrate(dx0.data(), dx1.data(), dy0.data(), dy1.data(), pathCount.size(), heading.data(), x.data(), y.data());
+
+        for ( size_t k = 0; k < pathCount.size(); k++ )
+            dataPath << std::setw(7) << pathCount[k] << ";" << std::setprecision(5) << std::setw(10) << heading[k] << ";"
+                     << std::setprecision(3) << std::setw(12) << x[k] << ";" << std::setw(12) << y[k] << "\n";
+
+        pathCount.clear();
+        dx0.clear();
+        dx1.clear();
+        dy0.clear();
+        dy1.clear();
+    };
+
+    // Positions integrated the same way as formattedBuffer: X0, X1, Y0, Y1
+    int position[4] { 0 };
+    unsigned long samples = 0, markers = 0;
+
+    auto convert = [&]( const SessionRecord& record ) {
+
+        if ( record.marker != 0 ) {
+            writeRow(dataP, record, position, timestamps);
+            markers++;
+            return;
+        }
+
+        for ( int i = 0; i < 2; i++ ) {
+            position[i] += record.dx[i];
+            position[i+2] += record.dy[i];
+        }
+
+        writeRow(dataA, record, position, timestamps);
+        samples++;
+
+        if ( path ) {
+            pathCount.push_back(static_cast<int>(record.count));
+            dx0.push_back(record.dx[0]);
+            dx1.push_back(record.dx[1]);
+            dy0.push_back(record.dy[0]);
+            dy1.push_back(record.dy[1]);
+
+            if ( pathCount.size() == pathBatch )
+                writePath();
+        }
+    };
+
+    if ( !header.compressed ) {
+
+        unsigned char recordBytes[sessionRecordSize];
+        SessionRecord record;
+
+        while ( input.read(reinterpret_cast<char*>(recordBytes), sessionRecordSize) ) {
+            decodeSessionRecord(recordBytes, record);
+            convert(record);
+        }
+
+    } else {
+
+        unsigned char blockHeader[sessionBlockHeaderSize];
+        std::vector<unsigned char> payload;
+
+        while ( input.read(reinterpret_cast<char*>(blockHeader), sessionBlockHeaderSize) ) {
+
+            size_t size = static_cast<size_t>(blockHeader[0] | (blockHeader[1] << 8));
+            size_t records = static_cast<size_t>(blockHeader[2] | (blockHeader[3] << 8));
+
+            payload.resize(size);
+            if ( !input.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(size)) ) {
+                std::cerr << "The last block is truncated." << std::endl;
+                break;
+            }
+
+            DeltaBlockReader reader(payload.data(), payload.size());
+            WireRecord wire;
+            size_t decoded = 0;
+
+            while ( decoded < records && reader.next(wire) ) {
+
+                SessionRecord record;
+                record.count = wire.count;
+                record.timestamp = wire.timestamp;
+                for ( int i = 0; i < 2; i++ ) {
+                    record.dx[i] = wire.dx[i];
+                    record.dy[i] = wire.dy[i];
+                    record.sq[i] = wire.sq[i];
+                }
+                record.button = wire.button;
+                record.marker = wire.marker;
+
+                convert(record);
+                decoded++;
+            }
+
+            if ( decoded != records )
+                std::cerr << "A block is damaged: " << records - decoded << " records lost." << std::endl;
+        }
+    }
+
+    if ( path ) {
+        writePath();
+        std::cout << "Path written to " << outputName << "_path.csv" << std::endl;
+    }
+
+    std::cout << samples << " samples and " << markers << " markers written to " << outputName << ".csv" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,435 @@
+//
+// Created on 17/10/2026.
+//
+
+// Reference receiver of the network output: reads the UDP stream sent by enableNetwork() / transmit(),
+// and measures what the receivers get. Batched mode (--udp-batch): sequence gaps, reordering and duplicates,
+// and the one-way latency from the USB completion on the sender to the reception here (same host only: both ends
+// read CLOCK_MONOTONIC_RAW). Raw mode datagrams have no sequence number, they are only counted.
+// Compressed datagrams (DeltaCodec.h) are decoded and counted the same way.
+//
+// --soak runs the sender too: a Trackball against the simulated device, sending over the loopback at a fixed rate,
+// so loss and latency can be measured under load without any hardware.
+
+#include "../Trackball.h"
+#include "../WireProtocol.h"
+#include "../DeltaCodec.h"
+#include "../Histogram.h"
+#include "../Clock.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void onInterrupt( int )
+{
+    interrupted = 1;
+}
+
+static void show_usage( std::string name )
+{
+    std::cerr << "Usage: " << name << " <option(s)>\n"
+              << "Options:\n"
+              << "\t-h,--help\t\tShow this help message.\n"
+              << "\t-p,--port PORT\t\tUDP port to listen on. Default is 45944\n"
+              << "\t-g,--group ADDR\t\tJoin the multicast group ADDR.\n"
+              << "\t--duration S\t\tStop after S seconds. Default is to run until Ctrl-C (10 s with --soak)\n"
+              << "\t--interval S\t\tPrint a report every S seconds. Default is 1\n"
+              << "\t--soak\t\t\tAlso run a simulated trackball sending to this receiver over the loopback.\n"
+              << "\t--rate HZ\t\tWith --soak, sample rate of the simulated trackball. Default is 5000\n"
+              << "\t--replay FILE\t\tWith --soak, replay a recorded CSV session instead of synthetic motion.\n"
+              << "\t--udp-batch N\t\tWith --soak, N samples per datagram. Default is 1 (0 = raw samples)\n"
+              << "\t--udp-burst M\t\tWith --soak, up to M datagrams per sendmmsg() call. Default is 1\n"
+              << "\t--udp-latency US\tWith --soak, latency bound of the batching. Default is 1000\n"
+              << "\t--decimate N\t\tWith --soak, receive one aggregated record every N samples.\n"
+              << "\t--output-rate HZ\tWith --soak, receive about HZ aggregated records per second.\n"
+              << "\t--udp-compress\t\tWith --soak, send compressed datagrams.\n"
+              << std::endl;
+}
+
+
+// Sequence numbers seen within a sliding window, to tell late records from duplicates
+class SequenceTracker {
+
+public:
+
+    static constexpr uint32_t window = 4096;
+
+    uint64_t received = 0;
+    uint64_t lost = 0;              // Missing so far (late records are taken back out)
+    uint64_t reordered = 0;         // Arrived after a later one
+    uint64_t duplicates = 0;
+    uint64_t late = 0;              // Older than the window: a late record or a duplicate, can't tell. Still counted as lost
+
+    void reset() {
+        *this = SequenceTracker();
+    }
+
+    void add( uint32_t sequence ) {
+
+        if ( !started ) {
+            started = true;
+            next = sequence + 1;
+            mark(sequence);
+            received++;
+            return;
+        }
+
+        // Wrap-safe distance from the next expected number
+        int32_t distance = static_cast<int32_t>(sequence - next);
+
+        if ( distance >= 0 ) {
+
+            // Everything skipped is missing until it shows up
+            uint32_t skipped = static_cast<uint32_t>(distance);
+            for ( uint32_t k = 0; k < std::min(skipped, window); k++ )
+                seen[(next + k) % window] = false;
+
+            lost += skipped;
+            next = sequence + 1;
+            mark(sequence);
+            received++;
+
+        } else if ( static_cast<uint32_t>(-distance) > window ) {
+
+            // Too late to tell a late record from a duplicate: it stays counted as lost
+            late++;
+
+        } else if ( seen[sequence % window] ) {
+            duplicates++;
+
+        } else {
+            mark(sequence);
+            reordered++;
+            lost--;
+            received++;
+        }
+    }
+
+private:
+
+    void mark( uint32_t sequence ) {
+        seen[sequence % window] = true;
+    }
+
+    bool started = false;
+    uint32_t next = 0;
+    bool seen[window] { };
+
+};
+
+
+struct Totals {
+    uint64_t datagrams = 0;
+    uint64_t rawDatagrams = 0;
+    uint64_t compressed = 0;
+    uint64_t invalid = 0;
+    uint64_t restarts = 0;
+};
+
+
+static void printInterval( double elapsed, double seconds, uint64_t records, const SequenceTracker& tracker, const Histogram& latency )
+{
+    std::cout << std::fixed << std::setprecision(1) << std::setw(7) << elapsed << " s: "
+              << std::setprecision(0) << static_cast<double>(records) / seconds << " records/s, "
+              << tracker.lost << " lost, " << tracker.reordered << " reordered, " << tracker.duplicates << " duplicates, "
+              << tracker.late << " too late";
+
+    if ( latency.count() > 0 )
+        std::cout << std::setprecision(1) << ", latency p50 " << static_cast<double>(latency.percentile(0.5)) / 1000.0
+                  << " us, p99 " << static_cast<double>(latency.percentile(0.99)) / 1000.0
+                  << " us, max " << static_cast<double>(latency.max()) / 1000.0 << " us";
+
+    std::cout << std::defaultfloat << std::endl;
+}
+
+int main( int argc, char* argv[] )
+{
+    std::string port = "45944";
+    std::string group;
+    double duration = 0.0;
+    double interval = 1.0;
+    bool soak = false;
+    double rate = 5000.0;
+    std::string replay;
+    int udpBatch = 1;
+    int udpBurst = 1;
+    int udpLatency = 1000;
+    int decimation = 1;
+    double outputRate = 0.0;
+    bool udpCompress = false;
+
+    for ( int i = 1; i < argc; ++i ) {
+
+        std::string arg = argv[i];
+
+        if ( (arg == "-h") || (arg == "--help") ) {
+            show_usage(argv[0]);
+            return 0;
+
+        } else if ( (arg == "-p" || arg == "--port") && i + 1 < argc ) {
+            port = argv[++i];
+
+        } else if ( (arg == "-g" || arg == "--group") && i + 1 < argc ) {
+            group = argv[++i];
+
+        } else if ( (arg == "--duration") && i + 1 < argc ) {
+            duration = std::stod(argv[++i]);
+
+        } else if ( (arg == "--interval") && i + 1 < argc ) {
+            interval = std::stod(argv[++i]);
+
+        } else if ( arg == "--soak" ) {
+            soak = true;
+
+        } else if ( (arg == "--rate") && i + 1 < argc ) {
+            rate = std::stod(argv[++i]);
+
+        } else if ( (arg == "--replay") && i + 1 < argc ) {
+            replay = argv[++i];
+
+        } else if ( (arg == "--udp-batch") && i + 1 < argc ) {
+            udpBatch = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--udp-burst") && i + 1 < argc ) {
+            udpBurst = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--udp-latency") && i + 1 < argc ) {
+            udpLatency = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--decimate") && i + 1 < argc ) {
+            decimation = std::stoi(argv[++i]);
+
+        } else if ( (arg == "--output-rate") && i + 1 < argc ) {
+            outputRate = std::stod(argv[++i]);
+
+        } else if ( arg == "--udp-compress" ) {
+            udpCompress = true;
+
+        } else {
+            show_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ( interval <= 0.0 || ( soak && rate <= 0.0 ) ) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    if ( soak && duration == 0.0 )
+        duration = 10.0;
+
+    // Socket first, so nothing the soak sender sends is lost before we listen
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    int reuseAddress = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+    // Bursts of several thousand samples must not overflow the default buffer
+    int bufferSize = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    sockaddr_in address = { };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(std::stoi(port)));
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if ( bind(sock, (sockaddr*)&address, sizeof(address)) != 0 ) {
+        std::cerr << "Can't listen on port " << port << " (" << strerror(errno) << ")" << std::endl;
+        return 1;
+    }
+
+    if ( !group.empty() ) {
+        ip_mreqn request = { };
+        if ( inet_pton(AF_INET, group.c_str(), &request.imr_multiaddr) != 1
+             || setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) != 0 ) {
+            std::cerr << "Can't join the multicast group " << group << std::endl;
+            return 1;
+        }
+    }
+
+    // [Soak test] The sender: a simulated trackball, on its own thread
+    Trackball tb;
+    std::atomic<bool> sending { false };
+    std::thread sender;
+
+    if ( soak ) {
+
+        tb.disableConsoleOutput();
+
+        if ( tb.connectSimulator(replay) != 0 )
+            return 1;
+        if ( udpBatch > 0 && tb.setNetworkBatching(udpBatch, udpBurst, std::chrono::microseconds(udpLatency)) != 0 )
+            return 1;
+        tb.setNetworkCompression(udpCompress);
+        if ( tb.enableNetwork("127.0.0.1", port) != 0 )
+            return 1;
+        if ( ( decimation > 1 || outputRate > 0.0 ) && tb.setNetworkDecimation(0, decimation, outputRate) != 0 )
+            return 1;
+        if ( tb.enableAsyncMode(8, rate) != 0 )
+            return 1;
+
+        std::cout << "Soak test: " << rate << " Hz for " << duration << " s, "
+                  << ( udpBatch > 0 ? std::to_string(udpBatch) + " samples per datagram" : std::string("raw samples") ) << std::endl;
+
+        sending = true;
+        sender = std::thread([&tb, &sending]() {
+            while ( sending )
+                tb.acquire();
+            tb.disableNetwork();        // Flushes what is still batched
+        });
+    }
+
+    std::signal(SIGINT, onInterrupt);
+
+    const int batch = 64;
+    std::vector<unsigned char> buffers(batch * 2048);
+    std::vector<iovec> pieces(batch);
+    std::vector<mmsghdr> messages(batch);
+
+    for ( int m = 0; m < batch; m++ ) {
+        pieces[m].iov_base = &buffers[static_cast<size_t>(m) * 2048];
+        pieces[m].iov_len = 2048;
+        messages[m].msg_hdr.msg_iov = &pieces[m];
+        messages[m].msg_hdr.msg_iovlen = 1;
+    }
+
+    SequenceTracker tracker;
+    Totals totals;
+    Histogram latency;                  // Whole run
+    Histogram intervalLatency;          // Since the last report
+    uint32_t streamId = 0;
+    bool streamKnown = false;
+
+    int64_t start = monotonicNs();
+    int64_t lastReport = start;
+    uint64_t recordsAtReport = 0;
+    int64_t stopSending = ( duration > 0.0 ) ? start + static_cast<int64_t>(duration * 1e9) : INT64_MAX;
+    int64_t stop = soak ? stopSending + 200000000 : stopSending;    // Let the last datagrams arrive
+
+    while ( !interrupted && monotonicNs() < stop ) {
+
+        if ( soak && sending && monotonicNs() >= stopSending ) {
+            sending = false;
+            sender.join();
+        }
+
+        pollfd fd = { sock, POLLIN, 0 };
+        int r = poll(&fd, 1, 50);
+
+        if ( r > 0 ) {
+
+            int n = recvmmsg(sock, messages.data(), batch, MSG_DONTWAIT, nullptr);
+            int64_t now = monotonicNs();
+
+            for ( int m = 0; m < n; m++ ) {
+
+                const unsigned char *data = &buffers[static_cast<size_t>(m) * 2048];
+                size_t length = messages[m].msg_len;
+
+                totals.datagrams++;
+
+                WireDatagram datagram;
+                CompressedDatagram compressed;
+                bool plain = datagram.parse(data, length);
+
+                if ( !plain && !compressed.parse(data, length) ) {
+                    if ( length == 8 )
+                        totals.rawDatagrams++;
+                    else
+                        totals.invalid++;
+                    continue;
+                }
+
+                // A restarted sender starts over from its own sequence numbers
+                uint32_t id = plain ? datagram.streamId() : compressed.streamId();
+                if ( streamKnown && id != streamId ) {
+                    std::cout << "New stream " << std::hex << id << std::dec << ", restarting the counts" << std::endl;
+                    tracker.reset();
+                    totals.restarts++;
+                    recordsAtReport = 0;
+                }
+                streamId = id;
+                streamKnown = true;
+
+                if ( plain ) {
+                    for ( size_t k = 0; k < datagram.size(); k++ ) {
+                        WireRecordView record = datagram[k];
+
+                        tracker.add(record.sequence());
+                        latency.record(now - record.timestamp());
+                        intervalLatency.record(now - record.timestamp());
+                    }
+                    continue;
+                }
+
+                // The records of a compressed datagram follow each other from the first sequence number
+                totals.compressed++;
+
+                DeltaBlockReader reader = compressed.reader();
+                WireRecord record;
+                uint32_t sequence = compressed.firstSequence();
+
+                while ( sequence - compressed.firstSequence() < compressed.size() && reader.next(record) ) {
+                    tracker.add(sequence++);
+                    latency.record(now - record.timestamp);
+                    intervalLatency.record(now - record.timestamp);
+                }
+
+                if ( reader.error() || sequence - compressed.firstSequence() != compressed.size() )
+                    totals.invalid++;
+            }
+        }
+
+        int64_t now = monotonicNs();
+
+        if ( now - lastReport >= static_cast<int64_t>(interval * 1e9) ) {
+
+            uint64_t records = tracker.received + totals.rawDatagrams;
+            printInterval(static_cast<double>(now - start) / 1e9, static_cast<double>(now - lastReport) / 1e9,
+                          records - recordsAtReport, tracker, intervalLatency);
+
+            intervalLatency.reset();
+            lastReport = now;
+            recordsAtReport = records;
+        }
+    }
+
+    if ( soak && sending ) {
+        sending = false;
+        sender.join();
+    }
+
+    double seconds = static_cast<double>(monotonicNs() - start) / 1e9;
+
+    std::cout << "\nReceived " << totals.datagrams << " datagrams in " << seconds << " s ("
+              << totals.rawDatagrams << " raw, " << totals.compressed << " compressed, " << totals.invalid << " invalid, " << totals.restarts << " stream restarts)\n"
+              << "\tRecords:        " << tracker.received << "\n"
+              << "\tLost:           " << tracker.lost << "\n"
+              << "\tReordered:      " << tracker.reordered << "\n"
+              << "\tDuplicates:     " << tracker.duplicates << "\n"
+              << "\tToo late:       " << tracker.late << " (older than the last " << SequenceTracker::window << " records)" << std::endl;
+
+    if ( latency.count() > 0 )
+        latency.print("One-way latency (USB completion to reception)", true);
+
+    // The sender knows exactly how many samples it sent: the samples lost at the end of the run show up here
+    if ( soak ) {
+        std::cout << "\tSent:           " << tb.getCount() << " samples" << std::endl;
+        tb.printNetworkStats();
+    }
+
+    close(sock);
+
+    return 0;
+}
@@ -4,8 +4,10 @@
 
 
 #include "Trackball.h"
+#include "Simulator.h"
 #include "fx2flash.cpp"
 #include <sys/stat.h>
+#include <thread>
 
 
 // Constructor & Destructor
@@ -56,14 +58,6 @@ int Trackball::askOutputName() {
 
 int Trackball::enableDiskwrite() {
 
-    std::string fnameA = outpath + formattedName + ".csv";
-    std::string fnameP = outpath + formattedName + "_P.csv";
-    std::string fnameO = outpath + formattedName + "_O.csv";
-
-    dataA.open(fnameA.c_str(), std::ios::out);
-    dataP.open(fnameP.c_str(), std::ios::out);
-    dataO.open(fnameO.c_str(), std::ios::out);
-
     // Check if output folder exists
     struct stat st = {0};
     if (stat(outpath.c_str(), &st) == -1) {
@@ -71,23 +65,70 @@ int Trackball::enableDiskwrite() {
         for (int i = 1; i < 1500; ++i) {}           // Just a little delay
     }
 
-    // Check if files are writable
-    if ( !dataA || !dataP || !dataO ) {
-        std::cout << "Error writing files." << std::endl;
-        return -1;
+    if ( logFormat != LogFormat::Binary ) {
+
+        std::string fnameA = outpath + formattedName + ".csv";
+        std::string fnameP = outpath + formattedName + "_P.csv";
+        std::string fnameO = outpath + formattedName + "_O.csv";
+
+        dataA = disk.open(fnameA);
+        dataP = disk.open(fnameP);
+        dataO = disk.open(fnameO);
+
+        // Check if files are writable
+        if ( dataA < 0 || dataP < 0 || dataO < 0 ) {
+            std::cout << "Error writing files." << std::endl;
+            return -1;
+        }
+
+        // Initialize the files headers
+        std::string filesHeader = "  Count;     X0;     Y0;     X1;     Y1;    SQ0;    SQ1";
+
+        if ( csvTimestamps )
+            filesHeader += ";           Timestamp";
+
+        filesHeader += "\n";
+
+        disk.append(dataA, filesHeader.data(), filesHeader.size());
+        disk.append(dataP, filesHeader.data(), filesHeader.size());
+        disk.append(dataO, filesHeader.data(), filesHeader.size());
     }
 
-    // Initialize the files headers
-    const std::string filesHeader = "  Count;     X0;     Y0;     X1;     Y1;    SQ0;    SQ1";
+    if ( logFormat != LogFormat::CSV ) {
+
+        std::string fnameB = outpath + formattedName + ".tbs";
 
-    dataA << filesHeader << std::endl;
-    dataA.flush();
+        dataB = disk.open(fnameB);
+
+        if ( dataB < 0 ) {
+            std::cout << "Error writing files." << std::endl;
+            return -1;
+        }
 
-    dataP << filesHeader << std::endl;
-    dataP.flush();
+        // Describe the session in the header
+        SessionHeader header;
+        header.sensorID[0] = sensorInfo[0];
+        header.sensorID[1] = sensorInfo[1];
+        header.sensorRev[0] = sensorInfo[2];
+        header.sensorRev[1] = sensorInfo[3];
+        header.firmwareHash = hashFile(fwpath);
+        header.sampleRate = ( pollPeriod.count() > 0 ) ? 1.0 / std::chrono::duration<double>(pollPeriod).count() : 0.0;
+        header.calibration[0] = calibration[0];
+        header.calibration[1] = calibration[1];
+        header.startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        header.compressed = logCompression;
+
+        logBlock.clear();
+
+        unsigned char headerBytes[sessionHeaderSize];
+        encodeSessionHeader(header, headerBytes);
+
+        disk.append(dataB, headerBytes, sessionHeaderSize);
+    }
 
-    dataO << filesHeader << std::endl;
-    dataO.flush();
+    // From now on the files are only touched by the writer thread
+    disk.setIoUring(ioUringEnabled);
+    disk.start();
 
     diskwriteEnabled = true;
 
@@ -96,14 +137,50 @@ int Trackball::enableDiskwrite() {
 }
 
 void Trackball::saveFiles() {
-    dataA.close();
-    dataP.close();
-    dataO.close();
+
+    bool wasWriting = disk.isRunning();
+
+    // Only called once the acquisition is over: nothing else pops the markers now
+    flushMarkers();
+
+    // The last block of a compressed log isn't full
+    if ( wasWriting && dataB >= 0 && logCompression )
+        writeLogBlock();
+
+    // Writes out everything still buffered and closes the files
+    disk.close();
+
+    if ( wasWriting )
+        disk.printStats();
+
+    // The channels are gone: nothing is written until the files are opened again (enableDiskwrite())
+    dataA = dataP = dataO = dataB = -1;
+    diskwriteEnabled = false;
 }
 
 void Trackball::disableDiskwrite() {
     saveFiles();
-    diskwriteEnabled = false;
+}
+
+void Trackball::setLogFormat( LogFormat format ) {
+    logFormat = format;
+}
+
+void Trackball::setCsvTimestamps( bool enabled ) {
+    csvTimestamps = enabled;
+}
+
+void Trackball::setLogCompression( bool enabled ) {
+    logCompression = enabled;
+}
+
+void Trackball::setCommitPolicy( size_t commitSize, std::chrono::milliseconds commitInterval ) {
+    disk.setCommitPolicy(commitSize, commitInterval);
+    logBlockInterval = std::chrono::duration_cast<std::chrono::nanoseconds>(commitInterval).count();
+}
+
+DiskWriter::Stats Trackball::getDiskStats() const {
+    return disk.getStats();
 }
 
 void Trackball::enableConsoleOutput() {
@@ -127,6 +204,14 @@ int Trackball::enableSensorView() {
         return -1;
     }
 
+    // The firmware is only reflashed when the sensors don't answer, so the board can still run an older one that
+    // doesn't know PIX_BURST (and would take it for a register write): ask for its version, and grab the pixels
+    // a pair at a time if it's too old
+    pixelBurst = transport && readFirmwareVersion() >= firmwareBurstVersion;
+
+    if ( transport && !pixelBurst )
+        std::cout << "The firmware doesn't support PIX_BURST, reading the pixels with PIX_GRAB." << std::endl;
+
     sensorviewEnabled = true;
 
     return 0;
@@ -145,60 +230,150 @@ int Trackball::disableSensorView() {
 // [Network Mode]
 int Trackball::enableNetwork( const std::string& hostname, const std::string& service_or_port ) {
 
-    int r{ 1 };
+    int r = network.open(hostname, service_or_port);
+
+    if ( r != 0 )
+        return r;
+
+    if ( ioUringEnabled )
+        network.setIoUring(true);      // Keeps sendmmsg() if it fails
 
-    // Populate the socket object
-    sockUDP = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    networkEnabled = true;
 
-    int reusePort = 1;
-    setsockopt(sockUDP, SOL_SOCKET, SO_REUSEPORT, &reusePort, sizeof(reusePort));
+    return 0;
+}
 
-    // Populate the sockaddr_in struct
-    addrTb.sin_family = AF_INET;    // IPv4 only
-    addrTb.sin_port = 0x0A1A;       // Port 6666
+int Trackball::disableNetwork() {
 
-    // Bind: Assigns a network name to our socket
-    r = bind( sockUDP, (sockaddr*)&addrTb, sizeof(addrTb) );
+    sender.stop();
+    network.close();
 
-    if ( r != 0 ) {
-        std::cout << errno;
-        return 1;
+    networkEnabled = false;
+
+    return 0;
+}
+
+int Trackball::addNetworkDestination( const std::string& hostname, const std::string& service_or_port ) {
+
+    if ( sender.isRunning() ) {
+        std::cout << "The network output can't be changed once the acquisition has started." << std::endl;
+        return -1;
+    }
+
+    return network.addDestination(hostname, service_or_port);
+}
+
+int Trackball::setNetworkMulticast( int ttl, const std::string& interface ) {
+
+    if ( sender.isRunning() ) {
+        std::cout << "The network output can't be changed once the acquisition has started." << std::endl;
+        return -1;
     }
 
-    // Temporary struct of discovered internet addresses
-    addrinfo* foundAddresses { nullptr };
+    return network.setMulticast(ttl, interface);
+}
+
+void Trackball::setIoUring( bool enabled ) {
+    ioUringEnabled = enabled;
+}
+
+int Trackball::setNetworkDecimation( size_t destination, int factor, double rate ) {
+
+    if ( sender.isRunning() ) {
+        std::cout << "The network output can't be changed once the acquisition has started." << std::endl;
+        return -1;
+    }
 
-    // This hints struct is a skeleton of which results we want to select from the discovered addresses struct
-    addrinfo hints { };
-    hints.ai_family = AF_INET;             // Typically AF_INET or AF_INET6 (IPv4 or IPv6), or AF_UNSPEC (= 0) for "any"
-    hints.ai_socktype = SOCK_DGRAM;        // SOCK_STREAM (TCP) or SOCK_DGRAM (UDP), or 0 for "any"
-    hints.ai_protocol = IPPROTO_UDP;       // IPPROTO_UDP or IPPROTO_TCP, or IPPROTO_IP (= 0) for "any". When ai_protocol is 0, UDP is used for SOCK_DGRAM and TCP is used for SOCK_STREAM
-    hints.ai_flags = AI_NUMERICSERV;       // AI_NUMERICSERV specifies not to try to do server name resolution
+    return network.setDecimation(destination, factor, rate);
+}
 
-    // Query network and get all matching addresses
-    r = getaddrinfo( hostname.c_str(), service_or_port.c_str(), &hints, &foundAddresses );
+int Trackball::setNetworkThread( bool enabled ) {
 
-    if ( r == 0 ) {
-        // If getaddrinfo found something, copy that to the addrDest struct and delete the foundAddresses struct
-        memcpy( &addrDest, foundAddresses->ai_addr, foundAddresses->ai_addrlen );
-        freeaddrinfo( foundAddresses );
-    } else {
-        std::cout << errno;
-        return 2;
+    if ( networkEnabled ) {
+        std::cout << "The network thread must be chosen before enabling the network output." << std::endl;
+        return -1;
     }
 
-    networkEnabled = true;
+    networkThread = enabled;
 
     return 0;
 }
 
-int Trackball::disableNetwork() {
+int Trackball::setNetworkBatching( int recordsPerDatagram, int datagramsPerFlush, std::chrono::microseconds latency ) {
+    return network.setBatching(recordsPerDatagram, datagramsPerFlush, latency);
+}
 
-    sockUDP = 0;
-    addrTb = { };
-    addrDest = { };
+void Trackball::setNetworkCompression( bool enabled ) {
+    network.setCompression(enabled);
+}
 
-    networkEnabled = false;
+void Trackball::printNetworkStats() const {
+
+    // The sink's counters belong to the sender thread while it runs: only call this after disableNetwork()
+    network.printStats();
+    if ( networkThread )
+        sender.printStats();
+}
+
+
+// [Async Mode]
+int Trackball::enableAsyncMode( int depth, double targetRate ) {
+
+    int r { 1 };
+
+    if ( !transport ) {
+        std::cout << "Connect the trackball before enabling async mode." << std::endl;
+        return -1;
+    }
+
+    r = transport->startAsync(depth, [this]( const unsigned char *data, int length, int64_t timestamp ) { processRecords(data, length, timestamp); });
+    if ( r != 0 ) {
+        std::cout << "Could not allocate the asynchronous transfers." << std::endl;
+        cyusb_error(r);
+        return -1;
+    }
+
+    asyncDepth = depth;
+
+    // A target rate of 0 means polling as fast as the pipeline allows
+    if ( targetRate > 0.0 )
+        pollPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / targetRate));
+    else
+        pollPeriod = std::chrono::steady_clock::duration::zero();
+
+    nextPoll = std::chrono::steady_clock::now();
+
+    asyncEnabled = true;
+
+    return 0;
+}
+
+int Trackball::disableAsyncMode() {
+
+    if ( !asyncEnabled )
+        return 0;
+
+    // Wait for the commands still in flight, so no sample is lost
+    for ( int tries = 0; tries < 100 && transport->asyncInFlight() > 0; tries++ )
+        transport->handleAsync(10);
+
+    transport->stopAsync();
+
+    asyncEnabled = false;
+
+    return 0;
+}
+
+
+// [Batch Mode]
+int Trackball::setBatchSize( int samples ) {
+
+    if ( samples < 1 || samples > maxMotionBatch ) {
+        std::cout << "Batch size must be between 1 and " << maxMotionBatch << "." << std::endl;
+        return -1;
+    }
+
+    batchSize = samples;
 
     return 0;
 }
@@ -272,6 +447,9 @@ int Trackball::connectUSB() {
         return -1;
     }
 
+    // All the bulk transfers now go through the claimed device
+    transport = std::make_unique<UsbTransport>(device);
+
     // Try to initialize the optical sensors
     r = prepareSensors();
     if ( r != 0 ) {
@@ -296,34 +474,72 @@ int Trackball::connectUSB() {
 
     }
 
+    // Keep the sensors IDs for the session logs (not critical if it fails)
+    readSensorsInfo();
+
     // If all went well
     std::cout << "Trackball ready." << std::endl;
 
     return 0;
 }
 
+int Trackball::connectSimulator( const std::string& replayFile ) {
+
+    int r{ 1 };
+
+    auto simulator = std::make_unique<SimulatedTransport>();
+
+    // Without a replay file, the simulated sensors produce a synthetic random walk
+    if ( !replayFile.empty() ) {
+        r = simulator->loadReplay(replayFile);
+        if ( r != 0 )
+            return -1;
+    }
+
+    transport = std::move(simulator);
+
+    r = prepareSensors();
+    if ( r != 0 ) {
+        std::cout << "Impossible to initiate connection with the simulated sensors." << std::endl;
+        return -1;
+    }
+
+    readSensorsInfo();
+
+    std::cout << "Simulated trackball ready." << std::endl;
+
+    return 0;
+}
+
 int Trackball::disconnectUSB() {
 
+    disableAsyncMode();
+    transport.reset();
+
+    // Nothing to release when running on the simulator
+    if ( !device )
+        return 0;
+
     cyusb_clear_halt(device, endpointOUT);
     cyusb_clear_halt(device, endpointIN);
     cyusb_release_interface(device, INTF);
     cyusb_release_interface(device, ALTINTF);
     cyusb_close();
+    device = nullptr;
 
     return 0;
 }
 
-int Trackball::printSensorsInfo() {
+int Trackball::readSensorsInfo() {
 
     int r { 1 };
-    unsigned char bufID[4] { 0 };
 
     // Read Product ID of the 2 chips
 
     // Product_ID address: 0x00 (0000 0000)
     // 1st bit must stay 0 (because Read) so no need to change
     writeBuffer[0] = PRODUCT_ID;
-    r = cyusb_bulk_transfer(device, endpointOUT, writeBuffer, 1, &transferred, 1000);
+    r = transport->bulkTransfer(endpointOUT, writeBuffer, 1, &transferred, 1000);
     if ( r < 0 ) {
         std::cout << "Error writing to optical chips PROD_ID address" << std::endl;
         cyusb_error(r);
@@ -331,7 +547,7 @@ int Trackball::printSensorsInfo() {
     }
 
     // Get back the response
-    r = cyusb_bulk_transfer(device, endpointIN, readBuffer, 2, &transferred, 1000);
+    r = transport->bulkTransfer(endpointIN, readBuffer, 2, &transferred, 1000);
     if ( r < 0 ) {
         std::cout << "Error reading optical chips PROD_ID address" << std::endl;
         cyusb_error(r);
@@ -339,13 +555,13 @@ int Trackball::printSensorsInfo() {
     }
 
     // Put the response into the ID buffer
-    bufID[0] = readBuffer[0];
-    bufID[1] = readBuffer[1];
+    sensorInfo[0] = readBuffer[0];
+    sensorInfo[1] = readBuffer[1];
 
     // Rev_ID address: 0x01 (0000 0001)
     // 1st bit must stay 0 (because Read) so no need to change
     writeBuffer[0] = REV_ID;
-    r = cyusb_bulk_transfer(device, endpointOUT, writeBuffer, 2, &transferred, 1000);
+    r = transport->bulkTransfer(endpointOUT, writeBuffer, 2, &transferred, 1000);
     if ( r < 0 ) {
         std::cout << "Error writing to optical chips REV_ID address" << std::endl;
         cyusb_error(r);
@@ -353,7 +569,7 @@ int Trackball::printSensorsInfo() {
     }
 
     // Get back the response
-    r = cyusb_bulk_transfer(device, endpointIN, readBuffer, 2, &transferred, 1000);
+    r = transport->bulkTransfer(endpointIN, readBuffer, 2, &transferred, 1000);
     if ( r < 0 ) {
         std::cout << "Error reading optical chips REV_ID address" << std::endl;
         cyusb_error(r);
@@ -361,18 +577,29 @@ int Trackball::printSensorsInfo() {
     }
 
     // Put the response into the ID buffer
-    bufID[2] = readBuffer[0];
-    bufID[3] = readBuffer[1];
+    sensorInfo[2] = readBuffer[0];
+    sensorInfo[3] = readBuffer[1];
+
+    return 0;
+}
+
+int Trackball::printSensorsInfo() {
+
+    int r { 1 };
+
+    r = readSensorsInfo();
+    if ( r != 0 )
+        return r;
 
     // Print the info
     for ( int i = 0; i < 2; i++ ) {
 
-        switch ( bufID[i] ) {
+        switch ( sensorInfo[i] ) {
             case ADNS5090_ID :
-                std::cout << "Chip " << i << ": ADNS-5090 rev." << +bufID[i+2] << std::endl; //"+" to force-print a nb
+                std::cout << "Chip " << i << ": ADNS-5090 rev." << +sensorInfo[i+2] << std::endl; //"+" to force-print a nb
                 break;
             case ADNS3050_ID :
-                std::cout << "Chip " << i << ": ADNS-3050 rev." << +bufID[i+2] << std::endl;
+                std::cout << "Chip " << i << ": ADNS-3050 rev." << +sensorInfo[i+2] << std::endl;
                 break;
             default:
                 std::cout << "Chip " << i << ": Unknown" << std::endl;
@@ -386,22 +613,22 @@ int Trackball::printSensorsInfo() {
 
 void Trackball::reset( bool resetAll ) {
 
-    transferred = 0;
-    ackCount = 0;
-
+    // First, so that the pending markers still get the count and time of the last sample
     if (diskwriteEnabled) {
         saveFiles();
     }
 
-    // Reset buffers
-    for ( int i : readBuffer )
-        readBuffer[i] = 0;
+    transferred = 0;
+    ackCount = 0;
 
-    for ( int i : writeBuffer )
-        writeBuffer[i] = 0;
+    lastTimestamp = 0;
+    gapCount = 0;
+    intervalHistogram.reset();
 
-    for ( int i : formattedBuffer )
-        formattedBuffer[i] = 0;
+    // Reset buffers
+    memset(readBuffer, 0, sizeof(readBuffer));
+    memset(writeBuffer, 0, sizeof(writeBuffer));
+    memset(formattedBuffer, 0, sizeof(formattedBuffer));
 
     // Reinitialize the button to 1 (= non pressed)
     readBuffer[6] = 0x01;
@@ -418,39 +645,150 @@ void Trackball::reset( bool resetAll ) {
 // Routines
 void Trackball::acquire() {
 
-    int r { 1 };
+    INSTRUMENT_STAGE(Acquire);
 
-    // Send 'Motion status' command to device and acquire back DX, DY, and SQ for both sensors
-    // Motion address: 0x02
-    writeBuffer[0] = MOTION_ST; // Ask to read address 02 (0000 0010), Read mode so no need to change 1st bit
+    if ( networkEnabled ) {
+        if ( !networkThread )
+            network.poll();     // Batched samples must not wait longer than the latency bound, even if no new sample comes
+        else if ( !sender.isRunning() )
+            sender.start(network, ring.reader());
+    }
 
-    r = cyusb_bulk_transfer(device, endpointOUT, writeBuffer, 1, &transferred, 1000);
+    if ( asyncEnabled ) {
+        acquireAsync();
+        return;
+    }
+
+    int r { 1 };
+
+    // Send 'Motion status' (or 'Motion batch') command to device and acquire back DX, DY, and SQ for both sensors
+    INSTRUMENT_STAGE(OutTransfer);
+    r = transport->bulkTransfer(endpointOUT, writeBuffer, sendMotionCommand(), &transferred, 1000);
+    INSTRUMENT_STOP(OutTransfer);
+    INSTRUMENT_COUNT(Commands, 1);
     if ( r != 0 ) {
+        INSTRUMENT_COUNT(TransferErrors, 1);
         std::cout << "Failed to send 'get_motion_status' command." << std::endl;
         return;
     }
 
-    // Read 6 bytes: two DX bytes, two DY bytes, two SQ bytes, in the read buffer
-    r = cyusb_bulk_transfer(device, endpointIN, readBuffer, 7, &transferred, 1000);
+    // Read 7 bytes per record: two DX bytes, two DY bytes, two SQ bytes and the button byte
+    INSTRUMENT_STAGE(InTransfer);
+    r = transport->bulkTransfer(endpointIN, batchBuffer, batchSize * 7, &transferred, 1000);
+    int64_t timestamp = monotonicNs();
+    INSTRUMENT_STOP(InTransfer);
+    if ( r < 0 ) {
+        INSTRUMENT_COUNT(TransferErrors, 1);
+        std::cout << "Failed to read DX, DY, SQ bytes" << std::endl;
+        return;
+    }
+
+    processRecords(batchBuffer, transferred, timestamp);
+}
+
+int Trackball::sendMotionCommand() {
+
+    if ( batchSize == 1 ) {
+        // Motion address: 0x02
+        writeBuffer[0] = MOTION_ST; // Ask to read address 02 (0000 0010), Read mode so no need to change 1st bit
+        return 1;
+    }
+
+    // The firmware reads motion batchSize times back to back and answers with all the records in one packet
+    writeBuffer[0] = MOTION_BATCH;
+    writeBuffer[1] = static_cast<unsigned char>(batchSize);
+    return 2;
+}
+
+void Trackball::acquireAsync() {
+
+    using clock = std::chrono::steady_clock;
+
+    int r { 1 };
+    auto now = clock::now();
+
+    // Don't try to catch up with polls missed while we were held up (the pipeline would just burst)
+    if ( pollPeriod.count() > 0 && nextPoll + pollPeriod * asyncDepth < now )
+        nextPoll = now;
+
+    // Keep the pipeline full, but never poll ahead of the target rate
+    int commandLength = sendMotionCommand();
+
+    while ( transport->asyncInFlight() < asyncDepth && ( pollPeriod.count() == 0 || nextPoll <= now ) ) {
+
+        r = transport->submitAsync(writeBuffer, commandLength, batchSize * 7);
+        INSTRUMENT_COUNT(Commands, 1);
+        if ( r != 0 ) {
+            INSTRUMENT_COUNT(TransferErrors, 1);
+            std::cout << "Failed to queue 'get_motion_status' command." << std::endl;
+            cyusb_error(r);
+            break;
+        }
+
+        nextPoll += pollPeriod * batchSize;     // The target rate is in samples, not in commands
+    }
+
+    // Nothing to wait for until the next poll is due
+    if ( transport->asyncInFlight() == 0 ) {
+        std::this_thread::sleep_until(nextPoll);
+        return;
+    }
+
+    // Completions come back in order through processRecords()
+    INSTRUMENT_STAGE(UsbEvents);
+    r = transport->handleAsync(1);
+    INSTRUMENT_STOP(UsbEvents);
     if ( r < 0 ) {
+        std::cout << "Error handling USB events." << std::endl;
+        cyusb_error(r);
+    }
+}
+
+void Trackball::processRecords( const unsigned char *data, int length, int64_t timestamp ) {
+
+    if ( length < 7 ) {
+        INSTRUMENT_COUNT(ShortReads, 1);
         std::cout << "Failed to read DX, DY, SQ bytes" << std::endl;
         return;
     }
 
-    // Interpret the readBuffer and fill the formattedBuffer variable
+    // Time between two USB completions (in batch mode, all the records of a packet share the completion time)
+    if ( lastTimestamp != 0 ) {
+        int64_t interval = timestamp - lastTimestamp;
+
+        intervalHistogram.record(interval);
+        if ( interval > gapThreshold )
+            gapCount++;
+    }
+    lastTimestamp = timestamp;
+
+    // One 7-byte record per sample, each decoded (and counted) on its own.
+    // readBuffer always holds the latest raw record, which is what transmit() sends
+    for ( int offset = 0; offset + 7 <= length; offset += 7 ) {
+        memcpy(readBuffer, data + offset, 7);
+        processMotion(readBuffer, timestamp);
+    }
+}
+
+void Trackball::processMotion( const unsigned char *motion, int64_t timestamp ) {
+
+    // Interpret the motion bytes and fill the formattedBuffer variable
 
     // ------------------------ formattedBuffer -------------------------
     // |  0  |  1  |  2  |  3  |  4  |  5  |  6  |  7  |  8  |  9  |
     // |  X0 |  X1 |  Y0 |  Y1 | DX0 | DX1 | DY0 | DY1 | SQ0 | SQ0 |
 
+    INSTRUMENT_STAGE(Decode);
+    INSTRUMENT_COUNT(Samples, 1);
+
     int dx, dy;
 
     for ( int i = 0; i < 2; i++ ) {
 
         // To safely store the formattedBuffer into normal signed int variables,
         // we must correctly interpret readBuffer's binary values:
-        dx = static_cast<signed char>(readBuffer[i]);    // DX and DY are signed 8-bit (see datasheet),
-        dy = static_cast<signed char>(readBuffer[i+2]);  // so we must explicitly cast to that
+        dx = static_cast<signed char>(motion[i]);    // DX and DY are signed 8-bit (see datasheet),
+        dy = static_cast<signed char>(motion[i+2]);  // so we must explicitly cast to that
 
         // X: increment X by DX
         formattedBuffer[i] += dx;
@@ -465,62 +803,185 @@ void Trackball::acquire() {
         formattedBuffer[i+6] = dy;
 
         // SQ: store SQ
-        formattedBuffer[i+8] = readBuffer[i+4];    // SQ is weird (it is the upper 8 bits of an unsigned 9-bit integer),
+        formattedBuffer[i+8] = motion[i+4];    // SQ is weird (it is the upper 8 bits of an unsigned 9-bit integer),
     }                                         // but we can interpret it as an unsigned char (i.e. just like readBuffer)
 
-    std::stringstream txtbuffer;
-
-    txtbuffer << std::setw(7) << ackCount << ";"
-              << std::setw(7) << formattedBuffer[0] << ";"
-              << std::setw(7) << formattedBuffer[2] << ";"
-              << std::setw(7) << formattedBuffer[1] << ";"
-              << std::setw(7) << formattedBuffer[3] << ";"
-              << std::setw(7) << formattedBuffer[8] << ";"
-              << std::setw(7) << formattedBuffer[9] << std::endl;
+    // Publish the sample for the other threads before doing any slow output
+    // Markers pressed since the last sample are attached to this one: all of them go to the files,
+    // the sample (and so the network) carries the first one
+    char keys[MarkerQueue::capacity];
+    int nbKeys = 0;
+    while ( nbKeys < static_cast<int>(MarkerQueue::capacity) && markers.pop(keys[nbKeys]) )
+        nbKeys++;
+    char key = nbKeys > 0 ? keys[0] : 0;
+
+    Sample sample;
+    sample.timestamp = timestamp;
+    sample.count = ackCount;
+    memcpy(sample.motion, formattedBuffer, sizeof(formattedBuffer));
+    sample.button = motion[6];
+    sample.marker = key;
+
+    ring.publish(sample);
+    if ( sharedRingEnabled )
+        sharedRing.publish(sample);
+    INSTRUMENT_STOP(Decode);
+
+    // Text row, only if something is going to print or write it
+    if ( consoleOutput || ( diskwriteEnabled && logFormat != LogFormat::Binary ) ) {
+        INSTRUMENT_STAGE(Format);
+        csvRow.sampleRow(ackCount, formattedBuffer, csvTimestamps, timestamp);
+    }
 
     if ( consoleOutput ) {
-        std::cout << txtbuffer.str();
+        INSTRUMENT_STAGE(Console);
+        std::cout.write(csvRow.data(), static_cast<std::streamsize>(csvRow.size()));
     }
 
-    if ( diskwriteEnabled ) {
+    INSTRUMENT_STAGE(Disk);
+
+    if ( diskwriteEnabled && logFormat != LogFormat::CSV ) {
 
-        dataA << txtbuffer.str();
-        dataA.flush();
+        SessionRecord record;
+        record.count = static_cast<uint32_t>(ackCount);
+        record.timestamp = sample.timestamp;
+        for ( int i = 0; i < 2; i++ ) {
+            record.dx[i] = static_cast<signed char>(motion[i]);
+            record.dy[i] = static_cast<signed char>(motion[i+2]);
+            record.sq[i] = motion[i+4];
+        }
+        record.button = motion[6];
+
+        logRecord(record);
+    }
+
+    if ( diskwriteEnabled && logFormat != LogFormat::Binary ) {
+
+        disk.append(dataA, csvRow.data(), csvRow.size());
 
 //      // Finally check if the button is pressed
 //        if ( readBuffer[6] == 0 ) {
 //            std::cout << "Button: " << ackCount << std::endl;
-//            dataB << txtbuffer.str();
+//            dataB.write(csvRow.data(), csvRow.size());
 //            dataB.flush();
 //
 //        }
     }
 
-    if ( networkEnabled )
-        transmit();
+    if ( diskwriteEnabled ) {
+        for ( int k = 0; k < nbKeys; k++ )
+            writeMarker(keys[k], sample.timestamp);
+    }
+
+    INSTRUMENT_STOP(Disk);
+
+    if ( networkEnabled && !networkThread ) {
+        INSTRUMENT_STAGE(Transmit);
+        transmit(timestamp, key);
+    }
 
     ackCount++;
 }
 
 void Trackball::marker( const char& key ) {
 
-    std::cout << ackCount << ": " << key << " pressed" << std::endl;
-    if ( diskwriteEnabled ) {
+    // Markers come from the visualizer threads: the key is only queued here,
+    // and the acquisition thread writes it to the files along with the next sample.
+    // The count is the one of the sample it will go with, from the ring (ackCount belongs to the acquisition thread)
+    Sample latest;
+    int count = ring.latest(latest) ? latest.count + 1 : 0;
+
+    if ( !markers.push(key) ) {
+        std::cout << count << ": " << key << " pressed, but too many keys are pending. Dropped." << std::endl;
+        return;
+    }
+
+    std::cout << count << ": " << key << " pressed" << std::endl;
+}
+
+void Trackball::flushMarkers() {
+
+    // Keys pressed after the last sample (acquisition stopped or stalled) are written with its time, rather than lost
+    char key;
+    while ( markers.pop(key) ) {
+        if ( diskwriteEnabled && disk.isRunning() )
+            writeMarker(key, lastTimestamp);
+    }
+}
 
-        std::stringstream txtbuffer;
+void Trackball::writeMarker( char key, int64_t timestamp ) {
 
-        txtbuffer << std::setw(7) << ackCount << ";"
-                  << std::setw(7) << formattedBuffer[0] << ";"
-                  << std::setw(7) << formattedBuffer[2] << ";"
-                  << std::setw(7) << formattedBuffer[1] << ";"
-                  << std::setw(7) << formattedBuffer[3] << ";"
-                  << std::setw(7) << formattedBuffer[8] << ";"
-                  << std::setw(7) << formattedBuffer[9] << std::endl;
+    if ( logFormat != LogFormat::CSV ) {
 
-        std::cout << ackCount << " : " << key << " pressed" << std::endl;
-        dataP << txtbuffer.str();
-        dataP.flush();
+        // Same count and SQ as the sample, but no motion, so the positions integrate the same way
+        SessionRecord record;
+        record.count = static_cast<uint32_t>(ackCount);
+        record.timestamp = timestamp;
+        record.sq[0] = static_cast<unsigned char>(formattedBuffer[8]);
+        record.sq[1] = static_cast<unsigned char>(formattedBuffer[9]);
+        record.button = readBuffer[6];
+        record.marker = static_cast<unsigned char>(key);
+
+        logRecord(record);
+    }
+
+    if ( logFormat != LogFormat::Binary ) {
+
+        // The row of the sample it is attached to, already in csvRow
+        disk.append(dataP, csvRow.data(), csvRow.size());
+    }
+}
+
+void Trackball::logRecord( const SessionRecord& record ) {
+
+    if ( !logCompression ) {
+        unsigned char recordBytes[sessionRecordSize];
+        encodeSessionRecord(record, recordBytes);
+
+        disk.append(dataB, recordBytes, sessionRecordSize);
+        return;
     }
+
+    // The positions go in the blocks' keyframes; elsewhere they cost nothing, the decoder integrates the deltas
+    WireRecord wire;
+    wire.count = record.count;
+    wire.timestamp = record.timestamp;
+    for ( int i = 0; i < 2; i++ ) {
+        wire.x[i] = formattedBuffer[i];
+        wire.y[i] = formattedBuffer[i+2];
+        wire.dx[i] = record.dx[i];
+        wire.dy[i] = record.dy[i];
+        wire.sq[i] = record.sq[i];
+    }
+    wire.button = record.button;
+    wire.marker = record.marker;
+
+    if ( logBlock.records() == 0 )
+        logBlockStart = record.timestamp;
+
+    logBlock.append(wire);
+
+    // Full, or as old as the commit interval: at low rates a block takes seconds to fill, and the samples must
+    // not wait in memory longer than the files' commit policy promises. Blocks can be short, the decoder doesn't mind
+    if ( logBlock.full() || record.timestamp - logBlockStart >= logBlockInterval )
+        writeLogBlock();
+}
+
+void Trackball::writeLogBlock() {
+
+    if ( logBlock.records() == 0 )
+        return;
+
+    unsigned char blockHeader[sessionBlockHeaderSize];
+    blockHeader[0] = static_cast<unsigned char>(logBlock.size());
+    blockHeader[1] = static_cast<unsigned char>(logBlock.size() >> 8);
+    blockHeader[2] = static_cast<unsigned char>(logBlock.records());
+    blockHeader[3] = static_cast<unsigned char>(logBlock.records() >> 8);
+
+    disk.append(dataB, blockHeader, sessionBlockHeaderSize);
+    disk.append(dataB, logBlock.data(), logBlock.size());
+
+    logBlock.clear();
 }
 
 unsigned char* Trackball::sensorView() {
@@ -538,43 +999,35 @@ unsigned char* Trackball::sensorView() {
         return nullptr;
     }
 
-    // Send 'pixel_grab' command to the device
-    // PIX_GRAB address: 0x0B (0000 1011)
-    writeBuffer[0] = PIX_GRAB;
-    r = cyusb_bulk_transfer(device, endpointOUT, writeBuffer, 1, &transferred, 1000);
+    const int frameSize = sensorSize*sensorSize*2;
 
-    if ( r < 0 ) {
-        std::cout << "Error sending 'pixel grab' command." << std::endl;
-        cyusb_error(r);
+    r = grabPixels(pixelBurst);
+
+    if ( r != frameSize ) {
+        std::cout << "Error reading pixels (" << ( r < 0 ? 0 : r ) << " of " << frameSize << " bytes)." << std::endl;
+        if ( r < 0 )
+            cyusb_error(r);
         return nullptr;
     }
 
-    // Perform as many read operations as there are of pixels per sensor
+    // Pixel pairs to one image per sensor
     for ( int k = 0; k < sensorSize*sensorSize; k++ )
     {
-        r = cyusb_bulk_transfer(device, endpointIN, readBuffer, 2, &transferred, 1000);
-
-        if ( r < 0 ) {
-            std::cout << "Error reading 1 pixel." << std::endl;
-            cyusb_error(r);
-            return nullptr;
-        }
-
-        ptrImages[k] = readBuffer[0];                           // 1st image starting from 0
-        ptrImages[k + sensorSize*sensorSize] = readBuffer[1];   // 2nd image starting from end of 1st image
+        ptrImages[k] = pixelBuffer[2*k];                            // 1st image starting from 0
+        ptrImages[k + sensorSize*sensorSize] = pixelBuffer[2*k+1];  // 2nd image starting from end of 1st image
     }
 
     // Now get a live reading of the Surface Quality
     writeBuffer[0] = SQUAL;
 
-    r = cyusb_bulk_transfer(device, endpointOUT, writeBuffer, 1, &transferred, 1000);
+    r = transport->bulkTransfer(endpointOUT, writeBuffer, 1, &transferred, 1000);
     if ( r < 0 ) {
         std::cout << "Error querying Surface Quality." << std::endl;
         cyusb_error(r);
         // Not critical, no need to return
     }
 
-    r = cyusb_bulk_transfer(device, endpointIN, readBuffer, 2, &transferred, 1000);
+    r = transport->bulkTransfer(endpointIN, readBuffer, 2, &transferred, 1000);
     if ( r < 0 ) {
         std::cout << "Error reading Surface Quality." << std::endl;
         cyusb_error(r);
@@ -594,6 +1047,83 @@ unsigned char* Trackball::sensorView() {
 
 
 // Private methods
+int Trackball::readFirmwareVersion() {
+
+    int r { 1 };
+    int transferred { 0 };
+    unsigned char info[Transport::maxPacketSize] { 0 };
+
+    r = drainAsync();
+    if ( r < 0 )
+        return 0;
+
+    writeBuffer[0] = FW_INFO;
+    r = transport->bulkTransfer(endpointOUT, writeBuffer, 1, &transferred, 1000);
+    if ( r < 0 )
+        return 0;
+
+    r = transport->bulkTransfer(endpointIN, info, sizeof(info), &transferred, 1000);
+    if ( r < 0 || transferred != 4 || info[0] != 'T' || info[1] != 'B' || info[2] != 'F' )
+        return 0;
+
+    return info[3];
+}
+
+int Trackball::drainAsync() {
+
+    if ( !asyncEnabled )
+        return 0;
+
+    // Motion polls still in flight must be answered before another command takes over the endpoints:
+    // their transfers would read its response
+    for ( int tries = 0; tries < 100 && transport->asyncInFlight() > 0; tries++ )
+        transport->handleAsync(10);
+
+    if ( transport->asyncInFlight() > 0 ) {
+        std::cout << "Motion polls still in flight after 1 s (" << transport->asyncInFlight() << ")." << std::endl;
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+
+    return 0;
+}
+
+int Trackball::grabPixels( bool burst ) {
+
+    int r { 1 };
+    int transferred { 0 };
+
+    const int frameSize = sensorSize*sensorSize*2;
+
+    r = drainAsync();
+    if ( r < 0 )
+        return r;
+
+    // PIX_BURST: the firmware grabs the pixels like PIX_GRAB (0x0B), but sends them in full packets instead of
+    // one pair at a time, so the 722 bytes come in one transfer (ended by the short last packet)
+    writeBuffer[0] = burst ? PIX_BURST : PIX_GRAB;
+    r = transport->bulkTransfer(endpointOUT, writeBuffer, 1, &transferred, 1000);
+    if ( r < 0 )
+        return r;
+
+    if ( burst ) {
+        r = transport->bulkTransfer(endpointIN, pixelBuffer, frameSize, &transferred, 1000);
+        return ( r < 0 ) ? r : transferred;
+    }
+
+    // Perform as many read operations as there are of pixels per sensor
+    for ( int received = 0; received < frameSize; received += 2 ) {
+
+        r = transport->bulkTransfer(endpointIN, pixelBuffer + received, 2, &transferred, 1000);
+
+        if ( r < 0 )
+            return r;
+        if ( transferred < 2 )
+            return received + transferred;
+    }
+
+    return frameSize;
+}
+
 int Trackball::flashCypress( const std::string& firmwarefile, Memory dest, RAM ramType, EEPROM romType ) {
 
     int r { 1 };
@@ -638,7 +1168,7 @@ int Trackball::prepareSensors() {
     // Reset command 0x5A (0101 1010) is then sent by the microcontroller (see firmware.c file)
     writeBuffer[0] = ( CHIP_RESET | rwBit );        // Effectively send 0xBA to the microcontroller
 
-    r = cyusb_bulk_transfer(device, endpointOUT, writeBuffer, 1, &transferred, 1000);
+    r = transport->bulkTransfer(endpointOUT, writeBuffer, 1, &transferred, 1000);
     if ( r != 0 ) {
         std::cout << "Could not send reset signal to the optical sensors." << std::endl;
         cyusb_error(r);
@@ -651,7 +1181,7 @@ int Trackball::prepareSensors() {
     // Read/Write address so we set 1st bit to 1: 0x80 (1000 0000) to indicate Write
     writeBuffer[0] = ( NAV_CTRL2 | rwBit );         // Effectively send 0xA2 to the microcontroller
 
-    r = cyusb_bulk_transfer(device, endpointOUT, writeBuffer, 1, &transferred, 1000);
+    r = transport->bulkTransfer(endpointOUT, writeBuffer, 1, &transferred, 1000);
     if ( r != 0 ) {
         std::cout << "Error disabling LEDs rest mode" << std::endl;
         cyusb_error(r);
@@ -661,21 +1191,82 @@ int Trackball::prepareSensors() {
     return 0;
 }
 
-void Trackball::transmit() {
+void Trackball::transmit( int64_t timestamp, char key ) {
+
+    // Raw mode: one datagram per sample, the bytes as read from the firmware
+    if ( !network.isBatching() ) {
+        network.sendRaw(readBuffer, sizeof(readBuffer), timestamp);
+        return;
+    }
+
+    // Decoded mode: the positions as integrated into formattedBuffer, so receivers don't have to
+    WireRecord record;
+    record.count = static_cast<uint32_t>(ackCount);
+    record.timestamp = timestamp;
+    for ( int i = 0; i < 2; i++ ) {
+        record.x[i] = formattedBuffer[i];
+        record.y[i] = formattedBuffer[i+2];
+        record.dx[i] = static_cast<signed char>(formattedBuffer[i+4]);
+        record.dy[i] = static_cast<signed char>(formattedBuffer[i+6]);
+        record.sq[i] = static_cast<unsigned char>(formattedBuffer[i+8]);
+    }
+    record.button = readBuffer[6];
+    record.marker = static_cast<unsigned char>(key);
 
+    network.append(record);
+}
 
-    size_t msgLen = sizeof(readBuffer);
 
-    int sendFlags = 0;
 
-    // ssize_t is just a signed size_t (because sendto returns -1 on error)
-    ssize_t sentBytes = sendto( sockUDP, readBuffer, msgLen, sendFlags, (sockaddr*)&addrDest, sizeof(addrDest) );
+// [Sample Ring]
+SampleReader Trackball::makeReader() const {
+    return ring.reader();
+}
 
-    if ( sentBytes < 0 )
-        std::cout << "Error sending data" << std::endl;
+bool Trackball::getLatestSample( Sample& sample ) const {
+    return ring.latest(sample);
 }
 
 
+// [Shared Memory Mode]
+int Trackball::enableSharedRing( const std::string& name, size_t capacity ) {
+
+    if ( sharedRing.create(name, capacity) != 0 )
+        return -1;
+
+    sharedRingEnabled = true;
+
+    return 0;
+}
+
+void Trackball::disableSharedRing() {
+
+    sharedRingEnabled = false;
+
+    sharedRing.close();
+}
+
+
+// [Timing]
+const Histogram& Trackball::getIntervalHistogram() const {
+    return intervalHistogram;
+}
+
+void Trackball::setGapThreshold( std::chrono::nanoseconds threshold ) {
+    gapThreshold = threshold.count();
+}
+
+void Trackball::printTimingStats() const {
+
+    if ( intervalHistogram.count() == 0 )
+        return;
+
+    intervalHistogram.print("Inter-sample interval", true);
+
+    std::cout << "Gaps longer than " << gapThreshold / 1000 << " us: " << gapCount
+              << " (longest " << intervalHistogram.max() / 1000 << " us)" << std::endl;
+}
+
 
 // Getters
 int Trackball::getCount() const {
@@ -699,3 +1290,8 @@ void Trackball::setFirmwarePath( const std::string& path ) {
 void Trackball::setOutputPath( const std::string& outputFolder ) {
     this->outpath = outputFolder;
 }
+
+void Trackball::setCalibration( double cal0, double cal1 ) {
+    calibration[0] = cal0;
+    calibration[1] = cal1;
+}
@@ -6,6 +6,19 @@
 #define TRACKBALLCONTROL_TRACKBALL_H
 
 #include "./Cypress/include/cyusb.h"
+#include "Transport.h"
+#include "SampleRing.h"
+#include "MarkerQueue.h"
+#include "SessionLog.h"
+#include "DiskWriter.h"
+#include "Histogram.h"
+#include "Instrument.h"
+#include "CsvFormatter.h"
+#include "NetworkSink.h"
+#include "NetworkSender.h"
+#include "DeltaCodec.h"
+#include "SharedRing.h"
+#include "Clock.h"
 #include <iostream>
 #include <fstream>
 #include <iomanip>
@@ -15,6 +28,9 @@
 #include <cstring>
 #include <cstdlib>
 #include <sstream>
+#include <memory>
+#include <chrono>
+#include <atomic>
 
 // ADNS-5090 and ADNS-3050 addresses
 const unsigned char PRODUCT_ID = 0x00;
@@ -25,6 +41,18 @@ const unsigned char PIX_GRAB = 0x0B;
 const unsigned char CHIP_RESET = 0x3A;
 const unsigned char NAV_CTRL2 = 0x22;
 
+// Firmware-only command (not an ADNS address): reads motion K times and packs the K 7-byte records in one packet
+const unsigned char MOTION_BATCH = 0xE2;
+constexpr int maxMotionBatch = 9;           // 9 x 7 bytes fit in the 64-byte EP1 IN buffer
+
+// Firmware-only command: same as PIX_GRAB, but the 361 pixel pairs come packed in 64-byte packets (12 packets)
+const unsigned char PIX_BURST = 0xEB;
+
+// Firmware-only command: answers "TBF" and the firmware version (4 bytes). Its bit 7 is clear, so an older firmware
+// takes it for a read of an unused sensor register and answers 2 bytes, without writing anything
+const unsigned char FW_INFO = 0x7E;
+constexpr int firmwareBurstVersion = 1;     // First version with PIX_BURST
+
 // ADNS Product IDs
 const unsigned char ADNS3050_ID = 0x09;
 const unsigned char ADNS5090_ID = 0x29;
@@ -47,12 +75,21 @@ public:
     explicit Trackball( unsigned short VID = 0x04b4, unsigned short PID = 0x8613 );
     ~Trackball();
 
+    // Output file formats for the Disk Write mode
+    enum class LogFormat {
+        CSV,            // Text files (name.csv, name_P.csv, name_O.csv)
+        Binary,         // Binary session log (name.tbs, see SessionLog.h)
+        Both
+    };
+
     // ADNS-3050 and ADNS-5090 sensors have a 19x19 pixels Array Address Map
     const int sensorSize = 19;
 
     // General methods
     int connectUSB();
+    int connectSimulator( const std::string& replayFile = "" );
     int disconnectUSB();
+    int readSensorsInfo();
     int printSensorsInfo();
     void reset(bool resetAll = false);
 
@@ -68,17 +105,61 @@ public:
     // [Disk Write Mode]
     int setOutputName(const std::string &manualName);
     int askOutputName();
-    void saveFiles();
+    void saveFiles();                               // Closes the files: enableDiskwrite() again for new ones
     int enableDiskwrite();
     void disableDiskwrite();
+    void setLogFormat( LogFormat format );
+    void setCsvTimestamps( bool enabled );          // Adds a Timestamp column (ns) to the CSV files
+    void setLogCompression( bool enabled );         // Binary session log in compressed blocks (see SessionLog.h). Before enableDiskwrite()
+    void setCommitPolicy( size_t commitSize, std::chrono::milliseconds commitInterval );
+    DiskWriter::Stats getDiskStats() const;
 
     // [Live Images Mode]
     int enableSensorView();
     int disableSensorView();
 
+    // [Async Mode]
+    int enableAsyncMode( int depth = 8, double targetRate = 0.0 );     // targetRate in Hz, 0 = as fast as possible
+    int disableAsyncMode();
+
+    // [Batch Mode]
+    int setBatchSize( int samples );        // Motion samples per USB transaction (1 = classic MOTION_ST)
+
     // [Network Mode]
     int enableNetwork( const std::string& hostname = "127.0.0.1", const std::string& service_or_port = "45944" );
     int disableNetwork();
+    int addNetworkDestination( const std::string& hostname, const std::string& service_or_port );   // After enableNetwork()
+    int setNetworkMulticast( int ttl, const std::string& interface = "" );
+    // Batched mode only: destination (in the order they were added) gets one record every 'factor' samples,
+    // or 'rate' records per second, each aggregating the samples in between (see NetworkSink.h)
+    int setNetworkDecimation( size_t destination, int factor, double rate = 0.0 );
+    // [I/O backend] io_uring submissions for the output files and the UDP datagrams (Linux 5.6 and later),
+    // for the sinks enabled after this call. Where it isn't available, the blocking calls are used
+    void setIoUring( bool enabled );
+
+    // By default the datagrams are sent from a thread of their own, fed through the sample ring (see NetworkSender.h),
+    // so network conditions never delay the USB polling; false sends them from acquire(). Before enableNetwork()
+    int setNetworkThread( bool enabled );
+
+    // Batched UDP: decoded samples (WireProtocol.h), recordsPerDatagram per datagram, datagramsPerFlush per
+    // sendmmsg() call, and never held longer than 'latency'. Without it, each sample is sent alone as the 8 raw bytes
+    int setNetworkBatching( int recordsPerDatagram, int datagramsPerFlush, std::chrono::microseconds latency );
+    // Batched mode: each datagram compressed as one block of deltas (see DeltaCodec.h), when that makes it smaller
+    void setNetworkCompression( bool enabled );
+    void printNetworkStats() const;
+
+    // [Sample Ring] Every decoded sample is published here; each consumer thread should use its own reader
+    SampleReader makeReader() const;
+    bool getLatestSample( Sample& sample ) const;
+
+    // [Shared Memory Mode] Also publish every sample in a POSIX shared memory ring, for other processes (see SharedRing.h)
+    int enableSharedRing( const std::string& name = "/trackball", size_t capacity = 1 << 16 );
+    void disableSharedRing();
+
+    // [Timing] Intervals between consecutive USB completions, and gaps longer than gapThreshold
+    const Histogram& getIntervalHistogram() const;
+    void setGapThreshold( std::chrono::nanoseconds threshold );
+    void printTimingStats() const;
 
     // Getters
     int getCount() const;
@@ -88,6 +169,7 @@ public:
     // Setters
     void setFirmwarePath(  const std::string& path );
     void setOutputPath(  const std::string& outputFolder );
+    void setCalibration( double cal0, double cal1 );       // Sensor counts per ball rotation
 
 
 private:
@@ -119,9 +201,13 @@ private:
     cyusb_handle *device { nullptr };
     int transferred = 0;
 
+    // Where all the bulk transfers go (the USB device, or a simulated one)
+    std::unique_ptr<Transport> transport;
+
     // Read and Write buffers (unsigned char because they store raw 8-bit binary values)
     unsigned char readBuffer[8] { 0 };
     unsigned char writeBuffer[2] { 0 };
+    unsigned char batchBuffer[maxMotionBatch * 7] { 0 };
 
     // Output array for motion data (we handle the appropriate casting from binary to integer in the acquire() function)
     //
@@ -137,32 +223,86 @@ private:
     bool diskwriteEnabled = false;
     bool networkEnabled = false;
     bool sensorviewEnabled = false;
+    bool asyncEnabled = false;
+    bool sharedRingEnabled = false;
+    bool ioUringEnabled = false;
 
     // Acquisition count
     int ackCount = 0;
 
+    // Timing of the samples
+    int64_t lastTimestamp = 0;                  // monotonicNs() of the previous USB completion
+    int64_t gapThreshold = 2000000;             // Intervals longer than this count as gaps (ns)
+    uint64_t gapCount = 0;
+    Histogram intervalHistogram;
+
+    // Sensors Product and Revision IDs (filled by readSensorsInfo())
+    unsigned char sensorInfo[4] { 0 };
+
+    // Sensor counts per 1 ball rotation (recorded in the binary session header)
+    double calibration[2] { 1000.0, 1000.0 };
+
+    // Decoded samples, for the consumers running on other threads (visualizers, markers...)
+    SampleRing ring;
+
+    // The same samples, for the consumers running in other processes
+    SharedRingWriter sharedRing;
+
 
     // Private methods
     int flashCypress( const std::string& firmwarefile, Memory dest=Memory::RAM,           // Strongly typed, for safety
                                                         RAM ramType=RAM::Internal,
                                                         EEPROM romType=EEPROM::Small );
     int prepareSensors();
-    void transmit();
+    void acquireAsync();
+    int sendMotionCommand();
+    void processRecords( const unsigned char *data, int length, int64_t timestamp );
+    void processMotion( const unsigned char *motion, int64_t timestamp );
+    void writeMarker( char key, int64_t timestamp );
+    void flushMarkers();
+    void logRecord( const SessionRecord& record );
+    void writeLogBlock();
+    void transmit( int64_t timestamp, char key );
+    int readFirmwareVersion();              // 0 for a firmware without FW_INFO
+    int drainAsync();                       // 0, or a libusb error if the motion polls in flight don't all come back
+    int grabPixels( bool burst );
 
 
     // Prepare the outputs
 
     // [Disk Write mode]
-    std::ofstream dataA, dataP, dataO;      // Output streams
+    DiskWriter disk;                        // Writes the files on its own thread
+    int dataA = -1, dataP = -1, dataO = -1; // Output files (DiskWriter channels)
+    int dataB = -1;                         // Binary session log
+    LogFormat logFormat = LogFormat::CSV;
+    bool csvTimestamps = false;
+    bool logCompression = false;
+    DeltaBlockWriter logBlock { sessionBlockRecords };     // Compressed log: the block being filled
+    int64_t logBlockStart = 0;              // Timestamp of its first record
+    int64_t logBlockInterval = 100000000;   // ns: a block is written out once that old, like the commit interval of the files
+    CsvFormatter csvRow;                    // Text row of the current sample, for the console and the CSV files
     std::string formattedName = "NONAME";   // Formatted files name (from experimental condition)
 
+    // Keys pressed on another thread, written to the outputs along with the next sample
+    MarkerQueue markers;
+
     // [Sensor View mode]
     unsigned char *ptrImages { nullptr };   // Pointer to the generated images
+    unsigned char pixelBuffer[722] { 0 };   // Pixel pairs as they come from the device (sensor 1, sensor 2, ...)
+    bool pixelBurst = false;                // The firmware answers PIX_BURST (probed by enableSensorView())
+
+    // [Batch mode]
+    int batchSize = 1;                                      // Motion records per command
+
+    // [Async mode]
+    int asyncDepth = 8;                                     // Motion polls kept in flight
+    std::chrono::steady_clock::duration pollPeriod { 0 };   // 1 / target rate (0 = unpaced)
+    std::chrono::steady_clock::time_point nextPoll;         // When the next poll is due
 
     // [Network mode]
-    int sockUDP = 0;                  // Socket to bind
-    sockaddr_in addrTb = { };           // Trackball address struct
-    sockaddr_storage addrDest = { };    // Destination address struct
+    NetworkSink network;
+    NetworkSender sender;                   // Started by the first acquire(), once the sink is configured
+    bool networkThread = true;
 };
 
 
@@ -0,0 +1,269 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "TrajectoryEngine.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+
+// 4 lanes of double: one AVX register, or two SSE2 / NEON ones when the target has nothing wider
+typedef double v4d __attribute__((vector_size(32)));
+typedef long long v4l __attribute__((vector_size(32)));
+typedef int v4i __attribute__((vector_size(16)));
+typedef double v2d __attribute__((vector_size(16)));
+
+static const double twoPi = 2.0 * M_PI;
+
+// { 0, a0, a1, a2 } and { 0, 0, a0, a1 }
+static inline v4d shiftLanes1( v4d a ) {
+#if defined(__clang__)
+    return __builtin_shufflevector(a, v4d{}, 4, 0, 1, 2);
+#else
+    return __builtin_shuffle(a, v4d{}, v4l{ 4, 0, 1, 2 });
+#endif
+}
+
+static inline v4d shiftLanes2( v4d a ) {
+#if defined(__clang__)
+    return __builtin_shufflevector(a, v4d{}, 4, 5, 0, 1);
+#else
+    return __builtin_shuffle(a, v4d{}, v4l{ 4, 5, 0, 1 });
+#endif
+}
+
+// Inclusive prefix sum of the 4 lanes
+static inline v4d scan( v4d a ) {
+    a += shiftLanes1(a);
+    a += shiftLanes2(a);
+    return a;
+}
+
+// Comparison-free: without AVX the 256-bit comparisons and selects are lowered lane by lane, while the int32
+// conversions stay single SSE2 / NEON instructions
+
+static inline v4d roundLanes( v4d a ) {                         // To the nearest integer (ties to even)
+    const double magic = 6755399441055744.0;                    // 1.5 * 2^52
+    return (a + magic) - magic;
+}
+
+static inline v4d floorLanes( v4d a ) {                         // For a > -1024
+    return __builtin_convertvector(__builtin_convertvector(a + 1024.0, v4i), v4d) - 1024.0;
+}
+
+static inline v4d wrapHeading( v4d a ) {
+    return a - twoPi * floorLanes(a * (1.0 / twoPi));
+}
+
+static inline v4d sqrtLanes( v4d a ) {
+#if defined(__AVX__)
+    return __builtin_ia32_sqrtpd256(a);
+#elif defined(__SSE2__)
+    v2d lo = __builtin_ia32_sqrtpd(v2d{ a[0], a[1] });
+    v2d hi = __builtin_ia32_sqrtpd(v2d{ a[2], a[3] });
+    return v4d{ lo[0], lo[1], hi[0], hi[1] };
+#else
+    for ( int l = 0; l < 4; l++ )
+        a[l] = std::sqrt(a[l]);
+    return a;
+#endif
+}
+
+// sin and cos of the 4 lanes: reduction to [-pi/4, pi/4] with pi/2 in 2 parts (the first one has 33 bits,
+// so q * pio2Hi is exact while |q| < 2^20: the headings never get past a few 2pi), then the Cephes polynomials
+static inline void sincosLanes( v4d a, v4d& s, v4d& c ) {
+
+    const double pio2Hi = 1.57079632673412561417e+00;
+    const double pio2Lo = 6.07710050650619224932e-11;
+
+    v4d q = roundLanes(a * (2.0 / M_PI));
+    v4d r = (a - q * pio2Hi) - q * pio2Lo;
+    v4d z = r * r;
+
+    v4d sr = v4d{} + 1.58962301576546568060e-10;
+    sr = sr * z - 2.50507477628578072866e-8;
+    sr = sr * z + 2.75573136213857245213e-6;
+    sr = sr * z - 1.98412698295895385996e-4;
+    sr = sr * z + 8.33333333332211858878e-3;
+    sr = sr * z - 1.66666666666666307295e-1;
+    sr = r + r * z * sr;
+
+    v4d cr = v4d{} - 1.13585365213876817300e-11;
+    cr = cr * z + 2.08757008419747316778e-9;
+    cr = cr * z - 2.75573141792967388112e-7;
+    cr = cr * z + 2.48015872888517045348e-5;
+    cr = cr * z - 1.38888888888730564116e-3;
+    cr = cr * z + 4.16666666666665929218e-2;
+    cr = 1.0 - 0.5 * z + z * z * cr;
+
+    // Quadrant: odd ones swap sin and cos, 2 and 3 negate sin, 1 and 2 negate cos. The factors are 0 or 1,
+    // so the blends are exact
+    v4i quadrant = __builtin_convertvector(q, v4i);
+    v4d swap = __builtin_convertvector(quadrant & 1, v4d);
+    v4d sinSign = 1.0 - 2.0 * __builtin_convertvector((quadrant >> 1) & 1, v4d);
+    v4d cosSign = 1.0 - 2.0 * __builtin_convertvector(((quadrant + 1) >> 1) & 1, v4d);
+
+    s = (sr * (1.0 - swap) + cr * swap) * sinSign;
+    c = (cr * (1.0 - swap) + sr * swap) * cosSign;
+}
+
+static inline v4d load( const int *p ) {
+
+    v4i v;
+    memcpy(&v, p, sizeof(v));
+
+    return __builtin_convertvector(v, v4d);
+}
+
+TrajectoryEngine::TrajectoryEngine( double cal0, double cal1, double perimeter ) :
+    cal0(cal0),
+    cal1(cal1),
+    perimeter(perimeter) {
+    setCalibration(cal0, cal1);
+}
+
+void TrajectoryEngine::setCalibration( double cal0, double cal1 ) {
+
+    this->cal0 = cal0;
+    this->cal1 = cal1;
+
+    turn0 = M_PI / cal0;
+    turn1 = M_PI / cal1;
+    step0 = perimeter / cal0;
+    step1 = perimeter / cal1;
+}
+
+void TrajectoryEngine::setPerimeter( double perimeter ) {
+
+    this->perimeter = perimeter;
+    setCalibration(cal0, cal1);
+}
+
+void TrajectoryEngine::reset( double x, double y, double heading ) {
+    this->x = x;
+    this->y = y;
+    this->heading = heading - twoPi * std::floor(heading / twoPi);
+}
+
+void TrajectoryEngine::integrate( const int *dx0, const int *dx1, const int *dy0, const int *dy1, size_t n,
+                                  double *heading, double *x, double *y ) {
+
+    v4d h, px, py;
+
+    for ( size_t i = 0; i < n; i += 4 ) {
+
+        v4d a0, a1, b0, b1;
+
+        if ( i + 4 <= n ) {
+            a0 = load(dx0 + i);
+            a1 = load(dx1 + i);
+            b0 = load(dy0 + i);
+            b1 = load(dy1 + i);
+        } else {
+            // The last block is padded with samples without motion
+            int pad[4][4] { { 0 } };
+            for ( size_t l = 0; i + l < n; l++ ) {
+                pad[0][l] = dx0[i+l];
+                pad[1][l] = dx1[i+l];
+                pad[2][l] = dy0[i+l];
+                pad[3][l] = dy1[i+l];
+            }
+            a0 = load(pad[0]);
+            a1 = load(pad[1]);
+            b0 = load(pad[2]);
+            b1 = load(pad[3]);
+        }
+
+        v4d turn = a0 * turn0 + a1 * turn1;
+        b0 *= step0;
+        b1 *= step1;
+        v4d step = sqrtLanes(b0 * b0 + b1 * b1);
+
+        // Heading after each sample, and before it (which is the one the sample moves along)
+        v4d turned = scan(turn);
+        v4d after = this->heading + turned;
+        v4d before = this->heading + shiftLanes1(turned);
+
+        v4d s, c;
+        sincosLanes(before, s, c);
+
+        px = this->x + scan(step * c);
+        py = this->y + scan(step * s);
+        h = wrapHeading(after);
+
+        size_t lanes = std::min<size_t>(4, n - i);
+
+        if ( lanes == 4 ) {
+            if ( heading )
+                memcpy(heading + i, &h, sizeof(h));
+            if ( x )
+                memcpy(x + i, &px, sizeof(px));
+            if ( y )
+                memcpy(y + i, &py, sizeof(py));
+        } else {
+            for ( size_t l = 0; l < lanes; l++ ) {
+                if ( heading )
+                    heading[i+l] = h[l];
+                if ( x )
+                    x[i+l] = px[l];
+                if ( y )
+                    y[i+l] = py[l];
+            }
+        }
+
+        this->x = px[3];
+        this->y = py[3];
+        this->heading = h[3];
+    }
+}
+
+void TrajectoryEngine::integrateScalar( const int *dx0, const int *dx1, const int *dy0, const int *dy1, size_t n,
+                                        double *heading, double *x, double *y ) {
+
+    for ( size_t i = 0; i < n; i++ ) {
+
+        double DX0, DX1, DY0, DY1;
+        double Dalpha, Ds;
+
+        DX0 = dx0[i] / cal0;    // Measured in ball rotations
+        DX1 = dx1[i] / cal1;
+
+        DY0 = dy0[i] / cal0;
+        DY1 = dy1[i] / cal1;
+
+        Ds = perimeter * std::sqrt(DY0 * DY0 + DY1 * DY1);
+
+        Dalpha = M_PI * (DX0 + DX1);   // Dalpha = 2pi * (DX0 + DX1)/2
+
+        this->x += Ds * std::cos(this->heading);
+        this->y += Ds * std::sin(this->heading);
+
+        this->heading += Dalpha;
+
+        if ( this->heading < 0 )
+            this->heading += twoPi;
+
+        if ( this->heading >= twoPi )
+            this->heading -= twoPi;
+
+        if ( heading )
+            heading[i] = this->heading;
+        if ( x )
+            x[i] = this->x;
+        if ( y )
+            y[i] = this->y;
+    }
+}
+
+double TrajectoryEngine::getX() const {
+    return x;
+}
+
+double TrajectoryEngine::getY() const {
+    return y;
+}
+
+double TrajectoryEngine::getHeading() const {
+    return heading;
+}
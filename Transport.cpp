@@ -0,0 +1,239 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "Transport.h"
+#include "Trackball.h"
+#include <algorithm>
+#include <iostream>
+
+
+// Default pipelined requests: queued, then run synchronously when the events are handled
+int Transport::startAsync( int depth, CompletionCallback callback ) {
+
+    if ( depth < 1 )
+        return -1;
+
+    asyncCallback = std::move(callback);
+    pendingCommands.assign(depth, PendingCommand());
+    pendingHead = 0;
+    pendingCount = 0;
+
+    return 0;
+}
+
+int Transport::submitAsync( const unsigned char *command, int commandLength, int responseLength ) {
+
+    int depth = static_cast<int>(pendingCommands.size());
+
+    if ( pendingCount == depth || commandLength > maxPacketSize || responseLength > maxPacketSize )
+        return LIBUSB_ERROR_BUSY;
+
+    PendingCommand& pending = pendingCommands[(pendingHead + pendingCount) % depth];
+
+    memcpy(pending.command, command, commandLength);
+    pending.commandLength = commandLength;
+    pending.responseLength = responseLength;
+    pendingCount++;
+
+    return 0;
+}
+
+int Transport::handleAsync( int /*timeoutMs*/ ) {
+
+    int r { 1 };
+    int transferred = 0;
+    int handled = 0;
+
+    while ( pendingCount > 0 ) {
+
+        PendingCommand& pending = pendingCommands[pendingHead];
+
+        r = bulkTransfer(endpointOUT, pending.command, pending.commandLength, &transferred, 1000);
+        if ( r == 0 )
+            r = bulkTransfer(endpointIN, pendingResponse, pending.responseLength, &transferred, 1000);
+
+        pendingHead = (pendingHead + 1) % static_cast<int>(pendingCommands.size());
+        pendingCount--;
+        handled++;
+
+        asyncCallback(pendingResponse, r < 0 ? r : transferred, monotonicNs());
+    }
+
+    return handled;
+}
+
+void Transport::stopAsync() {
+
+    pendingCommands.clear();
+    pendingHead = 0;
+    pendingCount = 0;
+}
+
+int Transport::asyncInFlight() const {
+    return pendingCount;
+}
+
+
+// [USB]
+UsbTransport::UsbTransport( cyusb_handle *device ) {
+    this->device = device;
+}
+
+UsbTransport::~UsbTransport() {
+    stopAsync();
+}
+
+int UsbTransport::bulkTransfer( unsigned char endpoint, unsigned char *data, int length, int *transferred,
+                                unsigned int timeout ) {
+
+    return cyusb_bulk_transfer(device, endpoint, data, length, transferred, timeout);
+}
+
+int UsbTransport::startAsync( int depth, CompletionCallback callback ) {
+
+    if ( depth < 1 )
+        return -1;
+
+    stopAsync();
+
+    asyncCallback = std::move(callback);
+
+    // All the transfers are allocated once here, and recycled for the whole session
+    slots.resize(depth);
+
+    for ( AsyncSlot& slot : slots ) {
+
+        slot.out = libusb_alloc_transfer(0);
+        slot.in = libusb_alloc_transfer(0);
+
+        if ( !slot.out || !slot.in ) {
+            stopAsync();
+            return LIBUSB_ERROR_NO_MEM;
+        }
+    }
+
+    slotHead = 0;
+    slotCount = 0;
+
+    return 0;
+}
+
+int UsbTransport::submitAsync( const unsigned char *command, int commandLength, int responseLength ) {
+
+    int r { 1 };
+    int depth = static_cast<int>(slots.size());
+
+    if ( slotCount == depth || commandLength > maxPacketSize || responseLength > maxPacketSize )
+        return LIBUSB_ERROR_BUSY;
+
+    AsyncSlot& slot = slots[(slotHead + slotCount) % depth];
+
+    memcpy(slot.command, command, commandLength);
+    slot.status = 0;
+
+    libusb_fill_bulk_transfer(slot.out, device, endpointOUT, slot.command, commandLength, transferDone, &slot, 1000);
+    libusb_fill_bulk_transfer(slot.in, device, endpointIN, slot.response, responseLength, transferDone, &slot, 1000);
+
+    // The IN read is queued right behind its command, so the device can answer as soon as it has parsed it
+    r = libusb_submit_transfer(slot.out);
+    if ( r != 0 )
+        return r;
+    slot.outstanding = 1;
+
+    r = libusb_submit_transfer(slot.in);
+    if ( r != 0 )
+        slot.status = r;        // The slot still completes (with an error) once the OUT transfer is back
+    else
+        slot.outstanding++;
+
+    slotCount++;
+
+    return 0;
+}
+
+int UsbTransport::handleAsync( int timeoutMs ) {
+
+    int r { 1 };
+    int handled = 0;
+
+    timeval tv { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+
+    // cyusb opens the device on the default libusb context
+    r = libusb_handle_events_timeout_completed(nullptr, &tv, nullptr);
+    if ( r < 0 )
+        return r;
+
+    // Hand the completed slots back in submission order
+    while ( slotCount > 0 && slots[slotHead].outstanding == 0 ) {
+
+        AsyncSlot& slot = slots[slotHead];
+
+        slotHead = (slotHead + 1) % static_cast<int>(slots.size());
+        slotCount--;
+        handled++;
+
+        asyncCallback(slot.response, slot.status < 0 ? slot.status : slot.in->actual_length, slot.completed);
+    }
+
+    return handled;
+}
+
+void UsbTransport::stopAsync() {
+
+    // Cancel whatever is still in flight and wait for libusb to give the transfers back
+    for ( AsyncSlot& slot : slots ) {
+        if ( slot.outstanding > 0 ) {
+            libusb_cancel_transfer(slot.out);
+            libusb_cancel_transfer(slot.in);
+        }
+    }
+
+    // A cancelled transfer stays libusb's until its callback has run, and that callback writes to its slot: nothing
+    // is freed before every slot is back. They time out after 1 s anyway, so 5 s is only a safety net
+    auto outstanding = [this]() {
+        return std::any_of(slots.begin(), slots.end(), []( const AsyncSlot& slot ) { return slot.outstanding > 0; });
+    };
+
+    for ( int tries = 0; tries < 500 && outstanding(); tries++ ) {
+        timeval tv { 0, 10000 };
+        libusb_handle_events_timeout_completed(nullptr, &tv, nullptr);
+    }
+
+    if ( outstanding() ) {
+        // Leaked rather than freed under libusb's feet. Moving the vector keeps the slots where they are
+        std::cerr << "USB transfers still in flight after cancellation, leaking them" << std::endl;
+        new std::vector<AsyncSlot>(std::move(slots));
+
+    } else {
+        for ( AsyncSlot& slot : slots ) {
+            libusb_free_transfer(slot.out);
+            libusb_free_transfer(slot.in);
+        }
+    }
+
+    slots.clear();
+    slotHead = 0;
+    slotCount = 0;
+}
+
+int UsbTransport::asyncInFlight() const {
+    return slotCount;
+}
+
+
+// Private methods
+void LIBUSB_CALL UsbTransport::transferDone( libusb_transfer *transfer ) {
+
+    auto slot = static_cast<AsyncSlot*>(transfer->user_data);
+
+    // The sample time is when its response reached the host, not when we get around to decoding it
+    if ( transfer == slot->in )
+        slot->completed = monotonicNs();
+
+    if ( transfer->status != LIBUSB_TRANSFER_COMPLETED && slot->status == 0 ) {
+        slot->status = ( transfer->status == LIBUSB_TRANSFER_TIMED_OUT ) ? LIBUSB_ERROR_TIMEOUT : LIBUSB_ERROR_IO;
+    }
+
+    slot->outstanding--;
+}
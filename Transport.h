@@ -0,0 +1,105 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_TRANSPORT_H
+#define TRACKBALLCONTROL_TRANSPORT_H
+
+#include "./Cypress/include/cyusb.h"
+#include "Clock.h"
+#include <functional>
+#include <vector>
+
+
+// Everything Trackball sends to or reads from the FX2 goes through a Transport,
+// so the same acquisition code can run against the real device or against a simulated one
+class Transport {
+
+public:
+
+    // Called once per completed command, in submission order, with the bytes read back
+    // (length is negative, a libusb error code, if the command or its response failed)
+    // and the monotonicNs() time at which the response came back
+    using CompletionCallback = std::function<void( const unsigned char *data, int length, int64_t timestamp )>;
+
+    // Largest command and response a pipelined request can carry (one full-speed bulk packet)
+    static constexpr int maxPacketSize = 64;
+
+    virtual ~Transport() = default;
+
+    // Same contract as cyusb_bulk_transfer(): returns 0 on success or a negative libusb error code,
+    // and stores in 'transferred' the number of bytes actually moved
+    virtual int bulkTransfer( unsigned char endpoint, unsigned char *data, int length, int *transferred,
+                              unsigned int timeout ) = 0;
+
+    // Pipelined requests: up to 'depth' command/response pairs can be in flight at the same time.
+    // The default implementation runs them synchronously, one after the other, when the events are handled
+    virtual int startAsync( int depth, CompletionCallback callback );
+    virtual int submitAsync( const unsigned char *command, int commandLength, int responseLength );
+    virtual int handleAsync( int timeoutMs );
+    virtual void stopAsync();
+    virtual int asyncInFlight() const;
+
+protected:
+
+    CompletionCallback asyncCallback;
+
+private:
+
+    struct PendingCommand {
+        unsigned char command[maxPacketSize] { 0 };
+        int commandLength = 0;
+        int responseLength = 0;
+    };
+
+    std::vector<PendingCommand> pendingCommands;
+    int pendingHead = 0;
+    int pendingCount = 0;
+    unsigned char pendingResponse[maxPacketSize] { 0 };
+
+};
+
+
+// [USB] Thin wrapper around an already opened and claimed cyusb handle
+class UsbTransport : public Transport {
+
+public:
+
+    explicit UsbTransport( cyusb_handle *device );
+    ~UsbTransport() override;
+
+    int bulkTransfer( unsigned char endpoint, unsigned char *data, int length, int *transferred,
+                      unsigned int timeout ) override;
+
+    // Pipelined requests use libusb asynchronous transfers: each slot owns one OUT and one IN transfer,
+    // both submitted straight away, and slots are handed back strictly in submission order
+    int startAsync( int depth, CompletionCallback callback ) override;
+    int submitAsync( const unsigned char *command, int commandLength, int responseLength ) override;
+    int handleAsync( int timeoutMs ) override;
+    void stopAsync() override;
+    int asyncInFlight() const override;
+
+private:
+
+    struct AsyncSlot {
+        libusb_transfer *out { nullptr };
+        libusb_transfer *in { nullptr };
+        unsigned char command[maxPacketSize] { 0 };
+        unsigned char response[maxPacketSize] { 0 };
+        int outstanding = 0;        // Transfers of this slot still owned by libusb
+        int status = 0;             // First error reported on this slot (libusb error code)
+        int64_t completed = 0;      // monotonicNs() when the IN transfer came back
+    };
+
+    static void LIBUSB_CALL transferDone( libusb_transfer *transfer );
+
+    cyusb_handle *device { nullptr };
+
+    std::vector<AsyncSlot> slots;
+    int slotHead = 0;
+    int slotCount = 0;
+
+};
+
+
+#endif //TRACKBALLCONTROL_TRANSPORT_H
@@ -3,16 +3,20 @@
 //
 
 #include "Visualizers.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstring>
 
 
 std::string msTime() {
+    return msTime(std::chrono::system_clock::now());
+}
+
+std::string msTime( std::chrono::system_clock::time_point now ) {
     // From https://stackoverflow.com/a/35157784
 
     using namespace std::chrono;
 
-    // get current time
-    auto now = system_clock::now();
-
     // get number of milliseconds for the current second
     // (remainder after division into seconds)
     auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
@@ -31,48 +35,45 @@ std::string msTime() {
 
 
 
-int VisualizerTrace::update( const int *motionData, bool &isFreeball ) {
+VisualizerTrace::VisualizerTrace( size_t traceLength ) :
+    output(viewportSize, viewportSize, CV_8UC1, 255),
+    history(std::max<size_t>(traceLength, 1)),
+    canvas(canvasSize, canvasSize, CV_8UC1, 255),
+    hits(canvasSize, canvasSize, CV_32SC1, cv::Scalar(0)),
+    origin(-canvasSize / 2, -canvasSize / 2) {
+}
 
-    // Initialize a matrix filled with white
-    cv::Mat imageTrace( viewportSize, viewportSize, CV_8UC1, 255 );
-
-    // Move all pixels coords by 1 to the right (i.e. get rid of the last one and make an empty space at the beginning)
-    for ( int i = traceLength-1; i > 0; i-- ) {
-        allPixelsX[i] = allPixelsX[i-1];
-        allPixelsY[i] = allPixelsY[i-1];
-    }
+void VisualizerTrace::integrate( const Sample *samples, size_t n, bool isFreeball ) {
 
     if ( isFreeball ) {
 
-        double DX0, DX1, DY0, DY1;
-        double Dalpha, Ds;
-
-        DX0 = motionData[4] / cal0;    // DX0, measured in ball rotations
-        DX1 = motionData[5] / cal1;
-
-        DY0 = motionData[6] / cal0;
-        DY1 = motionData[7] / cal1;
-
-        Ds = 152.9955 * std::sqrt(DY0 * DY0 + DY1 * DY1); // 152.99 = ball perimeter in mm
-
-        Dalpha = M_PI * (DX0 + DX1);   // Dalpha = 2pi * (DX0 + DX1)/2
-
-        Xs += Ds * std::cos(alpha);
-        Ys += Ds * std::sin(alpha);
+        // The arrays only grow up to the largest batch, then they are reused
+        batchDX0.resize(n);
+        batchDX1.resize(n);
+        batchDY0.resize(n);
+        batchDY1.resize(n);
+        batchX.resize(n);
+        batchY.resize(n);
+
+        for ( size_t s = 0; s < n; s++ ) {
+            batchDX0[s] = samples[s].motion[4];
+            batchDX1[s] = samples[s].motion[5];
+            batchDY0[s] = samples[s].motion[6];
+            batchDY1[s] = samples[s].motion[7];
+        }
 
-        alpha += Dalpha;
+        trajectory.integrate(batchDX0.data(), batchDX1.data(), batchDY0.data(), batchDY1.data(), n,
+                             nullptr, batchX.data(), batchY.data());
 
-        if ( alpha < 0 )
-            alpha += 2 * M_PI;
+        for ( size_t s = 0; s < n; s++ )
+            addPoint(static_cast<int>(std::round( batchX[s] * 2 )), static_cast<int>(std::round( batchY[s] * 2 )));
 
-        if ( alpha > (2 * M_PI) )
-            alpha -= 2 * M_PI;
+        return;
+    }
 
-        // put new pixel's X and Y at the beginning of the array (to display in the center)
-        allPixelsX[0] = static_cast<int>(std::round( Xs * 2 ));
-        allPixelsY[0] = static_cast<int>(std::round( Ys * 2 ));
+    for ( size_t s = 0; s < n; s++ ) {
 
-    } else {
+        const int *motionData = samples[s].motion;
 
         double Y0, Y1;
 
@@ -83,41 +84,26 @@ int VisualizerTrace::update( const int *motionData, bool &isFreeball ) {
         Y0 = Y0 * sensitivity / cal0;
         Y1 = Y1 * sensitivity / cal1;
 
-        // put new pixel's X and Y at the beginning of the array (to display in the center)
-        allPixelsX[0] = static_cast<int>(std::round( Y0 ));
-        allPixelsY[0] = static_cast<int>(std::round( Y1 ));
+        addPoint(static_cast<int>(std::round( Y0 )), static_cast<int>(std::round( Y1 )));
     }
+}
 
-    // Now iterate over the coord arrays to color the trace to black
-    int j, k;
-
-    for ( int i = 0; i < traceLength; i++ ) {
-        j = allPixelsX[i] - allPixelsX[0] + viewportSize/2;
-        k = allPixelsY[i] - allPixelsY[0] + viewportSize/2;
+int VisualizerTrace::update( bool &isFreeball ) {
 
-        // If the pixel is inside the viewport, change it to black
-        if ( j > 0 && j < viewportSize-1 && k > 0 && k < viewportSize-1 )
-            imageTrace.at<uchar>(j, k) = 0; // TODO: .at is supposed to range-check, why does this break without the if?
-    }
+    // The latest point is displayed in the center
+    const cv::Point& latest = history[(head + history.size() - 1) % history.size()];
 
-    std::string ballStatus;
+    cv::Point corner(latest.x - origin.x - viewportSize/2, latest.y - origin.y - viewportSize/2);
 
-    if ( isFreeball ) {
-        ballStatus = "ON";
-    } else {
-        ballStatus = "OFF";
+    if ( corner.x < 0 || corner.x > canvasSize - viewportSize || corner.y < 0 || corner.y > canvasSize - viewportSize ) {
+        recentre(latest);
+        corner = cv::Point(canvasMargin, canvasMargin);
     }
 
-    // Put Surface Quality SQ0
-    cv::putText(imageTrace, "Freeball is " + ballStatus + " (press F to toggle)", cv::Point(10, viewportSize-10),     // Coordinates
-                cv::FONT_HERSHEY_COMPLEX_SMALL,   // Font
-                0.5,                              // Scale
-                0,                              // Color (255 = white)
-                0.5,                                // Line Thickness
-                cv::LINE_AA);                     // Anti-alias
-
+    // Same size every frame, so this reuses the output buffer
+    canvas(cv::Rect(corner.y, corner.x, viewportSize, viewportSize)).copyTo(output);
 
-    output = imageTrace;
+    drawStatus(isFreeball);
 
     return 0;
 }
@@ -132,58 +118,125 @@ cv::Mat VisualizerTrace::get() {
     return output;
 }
 
-int VisualizerSensors::update( unsigned char *images, const int *motionData ) {
+// Private methods
+void VisualizerTrace::addPoint( int x, int y ) {
 
-    // First image starts at the pointed address
-    cv::Mat imgS1(1, matLength, CV_8UC1, images);
+    if ( points > 0 && history[(head + history.size() - 1) % history.size()] == cv::Point(x, y) )
+        return;
 
-    // Second image starts at the pointed address + the length of the first image
-    cv::Mat imgS2(1, matLength, CV_8UC1, images + matLength);
+    // The history is full: the oldest point goes away to make room
+    if ( points == history.size() )
+        plot(history[head], -1);
+    else
+        points++;
 
-    // Reshape the two vectors into squares of correct resolution
-    imgS1 = imgS1.reshape(1, resolution);
-    imgS2 = imgS2.reshape(1, resolution);
+    history[head] = cv::Point(x, y);
+    plot(history[head], 1);
 
-    // Create a compound image (of h x 2w)
-    cv::Mat bothSensorsImage(resolution, 2 * resolution, CV_8UC1);
+    head = (head + 1) % history.size();
+}
 
-    // Move the ROI to the left
-    bothSensorsImage.adjustROI(0, 0, 0, -resolution);
-    imgS1.copyTo(bothSensorsImage);
+void VisualizerTrace::plot( const cv::Point& point, int increment ) {
 
-    // Move the ROI to the right
-    bothSensorsImage.adjustROI(0, 0, -resolution, resolution);
-    imgS2.copyTo(bothSensorsImage);
+    int j = point.x - origin.x;
+    int k = point.y - origin.y;
 
-    // Restore normal ROI
-    bothSensorsImage.adjustROI(0, 0, resolution, 0);
+    // Points off the canvas are only drawn when it is recentred on them
+    if ( j < 0 || j >= canvasSize || k < 0 || k >= canvasSize )
+        return;
 
-    // Resize the image to something we can actually see without squinting like mf*ers
-    cv::resize(bothSensorsImage, bothSensorsImage, cv::Size(600, 300), 0, 0, cv::INTER_NEAREST);  // Nearest interpolation is important
+    int& count = hits.at<int>(j, k);
+    count += increment;
+    canvas.at<uchar>(j, k) = ( count > 0 ) ? 0 : 255;
+}
 
-    if ( motionData ) {
-        // Extract SQ readings from passed formattedBuffer array
-        std::string SQ0 = std::to_string(motionData[8]);
-        std::string SQ1 = std::to_string(motionData[9]);
+void VisualizerTrace::recentre( const cv::Point& centre ) {
 
-        // Put Surface Quality SQ0
-        cv::putText(bothSensorsImage, SQ0, cv::Point(20, 280),     // Coordinates
-                    cv::FONT_HERSHEY_COMPLEX_SMALL,   // Font
-                    1.5,                              // Scale
-                    255,                              // Color (255 = white)
-                    2,                                // Line Thickness
-                    cv::LINE_AA);                     // Anti-alias
+    origin = cv::Point(centre.x - canvasSize/2, centre.y - canvasSize/2);
+
+    canvas.setTo(255);
+    hits.setTo(0);
+
+    for ( size_t i = 0; i < points; i++ )
+        plot(history[i], 1);
+}
+
+void VisualizerTrace::drawStatus( bool isFreeball ) {
+
+    if ( statusShown != static_cast<int>(isFreeball) ) {
+
+        std::string ballStatus;
+
+        if ( isFreeball ) {
+            ballStatus = "ON";
+        } else {
+            ballStatus = "OFF";
+        }
 
-        // Put Surface Quality SQ1
-        cv::putText(bothSensorsImage, SQ1, cv::Point(320, 280),    // Coordinates
+        // Black on white: darkening the trace with it is the same as drawing it on the trace
+        statusText.create(statusHeight, viewportSize, CV_8UC1);
+        statusText.setTo(255);
+
+        cv::putText(statusText, "Freeball is " + ballStatus + " (press F to toggle)", cv::Point(10, statusHeight-10),     // Coordinates
                     cv::FONT_HERSHEY_COMPLEX_SMALL,   // Font
-                    1.5,                              // Scale
-                    255,                              // Color (255 = white)
-                    2,                                // Line Thickness
+                    0.5,                              // Scale
+                    0,                              // Color (255 = white)
+                    0.5,                                // Line Thickness
                     cv::LINE_AA);                     // Anti-alias
+
+        statusShown = static_cast<int>(isFreeball);
+    }
+
+    cv::Mat band = output.rowRange(viewportSize - statusHeight, viewportSize);
+    cv::min(band, statusText, band);
+}
+
+VisualizerSensors::VisualizerSensors() {
+
+    output.create(outputHeight, outputWidth, CV_8UC1);
+
+    // The pixels cv::resize() picks with INTER_NEAREST: the left sensor's frame, then the right one's
+    for ( int c = 0; c < outputWidth; c++ ) {
+        int x = std::min(static_cast<int>(std::floor(c * (2.0 * resolution / outputWidth))), 2 * resolution - 1);
+        columnSource[c] = (x / resolution) * matLength + x % resolution;
+    }
+
+    for ( int r = 0; r < outputHeight; r++ )
+        rowSource[r] = std::min(static_cast<int>(std::floor(r * (static_cast<double>(resolution) / outputHeight))), resolution - 1);
+}
+
+int VisualizerSensors::update( unsigned char *images, const int *motionData ) {
+
+    // First image starts at the pointed address, the second one right after it.
+    // Each source row makes a run of identical output rows: the first one is gathered, the others are copies of it
+    for ( int r = 0; r < outputHeight; r++ ) {
+
+        unsigned char *row = output.ptr<unsigned char>(r);
+
+        if ( r > 0 && rowSource[r] == rowSource[r-1] ) {
+            memcpy(row, output.ptr<unsigned char>(r-1), outputWidth);
+            continue;
+        }
+
+        const unsigned char *source = images + rowSource[r] * resolution;
+
+        for ( int c = 0; c < outputWidth; c++ )
+            row[c] = source[columnSource[c]];
     }
 
-    output = bothSensorsImage;
+    if ( motionData ) {
+
+        // Extract SQ readings from passed formattedBuffer array
+        for ( int sensor = 0; sensor < 2; sensor++ ) {
+
+            if ( motionData[8 + sensor] != sqShown[sensor] )
+                drawSQ(sensor, motionData[8 + sensor]);
+
+            // White text: brightening the frame with it is the same as drawing it, up to the anti-aliased edges
+            cv::Mat band = output(cv::Rect(sensor * outputWidth / 2, outputHeight - sqBandHeight, outputWidth / 2, sqBandHeight));
+            cv::max(band, sqText[sensor], band);
+        }
+    }
 
     return 0;
 }
@@ -199,11 +252,32 @@ cv::Mat VisualizerSensors::get() {
     return output;
 }
 
+// Private methods
+void VisualizerSensors::drawSQ( int sensor, int value ) {
+
+    sqText[sensor].create(sqBandHeight, outputWidth / 2, CV_8UC1);
+    sqText[sensor].setTo(0);
+
+    // Put Surface Quality, where it used to be drawn on the whole frame (20 px from the left of each half, 20 px from the bottom)
+    cv::putText(sqText[sensor], std::to_string(value), cv::Point(20, sqBandHeight - 20),     // Coordinates
+                cv::FONT_HERSHEY_COMPLEX_SMALL,   // Font
+                1.5,                              // Scale
+                255,                              // Color (255 = white)
+                2,                                // Line Thickness
+                cv::LINE_AA);                     // Anti-alias
+
+    sqShown[sensor] = value;
+}
+
 VisualizerCamera::~VisualizerCamera() {
     stop();
     cv::destroyAllWindows();
 }
 
+void VisualizerCamera::setFramePolicy( FramePolicy policy ) {
+    this->policy = policy;
+}
+
 int VisualizerCamera::start( int cam, const std::string& outputFilename ) {
 
     // Open the capture object (typically 0 for inbuilt webcam, 1 for first USB camera, etc)
@@ -227,15 +301,50 @@ int VisualizerCamera::start( int cam, const std::string& outputFilename ) {
 
         if ( !writer.isOpened() ) {
             std::cerr << "Could not open the video file to write\n";
+            cap.release();
             return -1;
         }
     }
 
+    // The buffers are allocated here, read() then decodes into them in place
+    freeFrames.reset();
+    annotateQueue.reset();
+    encodeQueue.reset();
+
+    for ( int f = 0; f < poolSize; f++ ) {
+        frames[f].image.create(frameHeight, frameWidth, CV_8UC3);
+        freeFrames.push(f);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(latestMutex);
+        fresh = false;
+    }
+
+    capturing = true;
+
+    captureThread = std::thread(&VisualizerCamera::captureLoop, this);
+    annotateThread = std::thread(&VisualizerCamera::annotateLoop, this);
+    if ( writer.isOpened() )
+        encodeThread = std::thread(&VisualizerCamera::encodeLoop, this);
+
     return 0;
 }
 
 int VisualizerCamera::stop() {
 
+    // The capture stops at once (even when waiting for a buffer), then the frames already captured go
+    // through the overlay and the encoder before the threads end
+    capturing = false;
+    freeFrames.close();
+
+    if ( captureThread.joinable() )
+        captureThread.join();
+    if ( annotateThread.joinable() )
+        annotateThread.join();
+    if ( encodeThread.joinable() )
+        encodeThread.join();
+
     // Release the video capture
     cap.release();
     if ( writer.isOpened() )
@@ -245,47 +354,167 @@ int VisualizerCamera::stop() {
 
 int VisualizerCamera::update() {
 
-    // Get a new frame from camera
-    cv::Mat frame;
-    cap >> frame;
+    std::lock_guard<std::mutex> lock(latestMutex);
 
-    // If the frame is empty, break immediately
-    if ( frame.empty() )
+    if ( !fresh )
         return -1;
 
-    // Put current time
-    cv::putText(frame, msTime(),
-                cv::Point(10, frameHeight-10),               // Coordinates
-                cv::FONT_HERSHEY_COMPLEX_SMALL,   // Font
-                1.0,                              // Scale
-                cv::Scalar(0, 255, 255),          // BGR Color (yellow)
-                1,                                // Line Thickness
-                cv::LINE_AA);                     // Anti-alias
-
-    output = frame;
+    // Into the same buffer every time
+    latest.copyTo(output);
+    fresh = false;
 
     return 0;
 }
 
 void VisualizerCamera::display() {
 
+    if ( output.empty() )
+        return;
+
     cv::imshow( "Live video", output );
 
 }
 
-void VisualizerCamera::write() {
+cv::Mat VisualizerCamera::get() {
 
-    if ( !writer.isOpened() ) {
-        std::cout << "Cannot record video without a file name!" << std::endl;
-        exit(-1);
+    return output;
+}
+
+VisualizerCamera::Stats VisualizerCamera::getStats() const {
+
+    Stats stats;
+
+    stats.captured = captured;
+    stats.recorded = recorded;
+    stats.droppedNoBuffer = droppedNoBuffer;
+    stats.droppedEncoder = droppedEncoder;
+    stats.displaySkipped = displaySkipped;
+    stats.captureErrors = captureErrors;
+
+    return stats;
+}
+
+void VisualizerCamera::printStats() const {
+
+    Stats stats = getStats();
+
+    std::cout << "Camera (" << ( policy == FramePolicy::Live ? "live" : "record" ) << "): " << stats.captured << " frames captured, "
+              << stats.recorded << " recorded, " << stats.droppedNoBuffer << " dropped with no free buffer, "
+              << stats.droppedEncoder << " not recorded with the encoder behind, " << stats.displaySkipped << " not displayed ("
+              << stats.captureErrors << " capture errors)" << std::endl;
+
+    if ( annotateLatency.count() > 0 )
+        annotateLatency.print("Camera annotate latency");
+    if ( encodeTime.count() > 0 )
+        encodeTime.print("Camera encode time");
+    if ( recordLatency.count() > 0 )
+        recordLatency.print("Camera record latency");
+}
+
+
+// Private methods
+void VisualizerCamera::captureLoop() {
+
+    while ( capturing ) {
+
+        int f;
+
+        if ( policy == FramePolicy::RecordAll ) {
+            // Waits for the encoder to give a buffer back
+            if ( !freeFrames.pop(f) )
+                break;
+
+        } else if ( !freeFrames.tryPop(f) ) {
+            // Still read, so the camera's own queue doesn't fill up with stale frames
+            if ( cap.read(scratch) )
+                droppedNoBuffer++;
+            else
+                captureErrors++;
+            continue;
+        }
+
+        Frame& frame = frames[f];
+
+        if ( !cap.read(frame.image) || frame.image.empty() ) {
+            captureErrors++;
+            freeFrames.push(f);
+            std::this_thread::sleep_for(std::chrono::milliseconds(videodelay));
+            continue;
+        }
+
+        frame.captured = monotonicNs();
+        frame.wallClock = std::chrono::system_clock::now();
+        captured++;
+
+        annotateQueue.push(f);
     }
 
-    // Write the frame into the output video file
-    writer.write( output );
+    annotateQueue.close();
+}
+
+void VisualizerCamera::annotateLoop() {
+
+    int f;
+
+    while ( annotateQueue.pop(f) ) {
+
+        Frame& frame = frames[f];
+
+        // Put the capture time
+        cv::putText(frame.image, msTime(frame.wallClock),
+                    cv::Point(10, frameHeight-10),               // Coordinates
+                    cv::FONT_HERSHEY_COMPLEX_SMALL,   // Font
+                    1.0,                              // Scale
+                    cv::Scalar(0, 255, 255),          // BGR Color (yellow)
+                    1,                                // Line Thickness
+                    cv::LINE_AA);                     // Anti-alias
+
+        annotateLatency.record(monotonicNs() - frame.captured);
+
+        {
+            std::lock_guard<std::mutex> lock(latestMutex);
+
+            if ( fresh )
+                displaySkipped++;
+
+            frame.image.copyTo(latest);
+            fresh = true;
+        }
+
+        if ( !writer.isOpened() ) {
+            freeFrames.push(f);
 
+        } else if ( policy == FramePolicy::RecordAll ) {
+            encodeQueue.push(f);
+
+        } else if ( !encodeQueue.tryPush(f) ) {
+            droppedEncoder++;
+            freeFrames.push(f);
+        }
+    }
+
+    encodeQueue.close();
 }
 
-cv::Mat VisualizerCamera::get() {
+void VisualizerCamera::encodeLoop() {
 
-    return output;
+    int f;
+
+    while ( encodeQueue.pop(f) ) {
+
+        Frame& frame = frames[f];
+
+        int64_t t0 = monotonicNs();
+
+        // Write the frame into the output video file
+        writer.write(frame.image);
+
+        int64_t t1 = monotonicNs();
+
+        encodeTime.record(t1 - t0);
+        recordLatency.record(t1 - frame.captured);
+        recorded++;
+
+        freeFrames.push(f);
+    }
 }
@@ -6,6 +6,10 @@
 #define TRACKBALLCONTROL_VISUALIZERS_H
 
 
+#include "SampleRing.h"
+#include "TrajectoryEngine.h"
+#include "BoundedQueue.h"
+#include "Histogram.h"
 #include <opencv2/opencv.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/videoio/videoio.hpp>
@@ -14,8 +18,13 @@
 //#include <libavdevice/avdevice.h>
 
 #include <chrono>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 std::string msTime();
+std::string msTime( std::chrono::system_clock::time_point time );
 
 
 class Visualizer {
@@ -28,13 +37,24 @@ public:
 class VisualizerTrace : public Visualizer {
 
 public:
+    explicit VisualizerTrace( size_t traceLength = 500 );      // Points kept on screen (tens of thousands are fine)
+
     cv::Mat output;
-    int update( const int *motionData, bool &isFreeball );
+
+    // Integrates every sample acquired since the last frame (oldest first), in as many calls as needed.
+    // The cost is a few vector operations per sample, and at most one O(1) plot: nothing is drawn until update()
+    void integrate( const Sample *samples, size_t n, bool isFreeball );
+    int update( bool &isFreeball );             // Draws the frame, whatever the number of samples integrated
     void display();
     cv::Mat get();
 
 private:
 
+    void addPoint( int x, int y );
+    void plot( const cv::Point& point, int increment );
+    void recentre( const cv::Point& centre );
+    void drawStatus( bool isFreeball );
+
     // Calibration: sensor counts per 1 ball rotation
     // Resolution: 1000 dpi
     // Ball diameter: 48.7 mm
@@ -48,24 +68,41 @@ private:
     double cal1 = 1000.0;
     double sensitivity = 500.0;		 // Sensitivity of the display for 'no yaw ball': 500 = low, 2000 = high
 
-    // Initialize values to increment
-    double Xs = 0.0;
-    double Ys = 0.0;
-    double alpha = 0.0;
+    // Freeball path (mm), integrated a whole batch at a time
+    TrajectoryEngine trajectory { cal0, cal1 };
+
+    // One batch of sensor deltas, one array per field, and the path after each sample
+    std::vector<int> batchDX0, batchDX1, batchDY0, batchDY1;
+    std::vector<double> batchX, batchY;
 
     // Params for the displayed image vertices
-    static const int traceLength = 500;
     static const int viewportSize = 500;
+    static const int canvasMargin = 250;        // The canvas is only redrawn when the trace moves this far from its centre
+    static const int canvasSize = viewportSize + 2 * canvasMargin;
+    static const int statusHeight = 24;         // Bottom band of the viewport holding the status line
 
-    // Arrays for the trace coords
-    int allPixelsX[viewportSize] { 0 };
-    int allPixelsY[viewportSize] { 0 };
+    // Trace history, a ring of the last traceLength points (trace coordinates, x is the row).
+    // Consecutive samples on the same pixel make one point, so the history holds path rather than time
+    std::vector<cv::Point> history;
+    size_t head = 0;                            // Where the next point goes
+    size_t points = 0;
+
+    // Persistent canvas: each frame only adds the new point and erases the expired one, then the viewport is cut out of it
+    cv::Mat canvas;                             // White, with the trace in black
+    cv::Mat hits;                               // Trace points on each canvas pixel, so a pixel is only erased by its last one
+    cv::Point origin;                           // Trace coordinates of the canvas' top-left pixel
+
+    // Status line, only rasterised when it changes
+    cv::Mat statusText;
+    int statusShown = -1;
 
 };
 
 class VisualizerSensors : public Visualizer {
 
 public:
+    VisualizerSensors();
+
     cv::Mat output;
 
     int update( unsigned char *images, const int *motionData = nullptr );
@@ -74,28 +111,67 @@ public:
 
 private:
 
+    void drawSQ( int sensor, int value );
+
     const int resolution = 19;
     const int matLength = resolution * resolution;
 
+    // Both frames side by side, upscaled with nearest neighbour straight into the persistent output
+    static const int outputWidth = 600;
+    static const int outputHeight = 300;
+    int columnSource[outputWidth];              // Offset of each output column's pixel in a row of 'images'
+    int rowSource[outputHeight];                // Source row of each output row
+
+    // SQ readings, white on black in the bottom band of each half, only rasterised when they change
+    static const int sqBandHeight = 48;
+    cv::Mat sqText[2];
+    int sqShown[2] { -1, -1 };
+
 };
 
 class VisualizerCamera : public Visualizer {
 
 public:
+
+    // What gives when the encoder can't keep up with the camera
+    enum class FramePolicy {
+        Live,           // Frames are dropped from the video, so capture and display stay at the camera's rate
+        RecordAll       // Every captured frame is encoded: the capture waits for a free buffer, only the display skips frames
+    };
+
+    struct Stats {
+        uint64_t captured = 0;
+        uint64_t recorded = 0;
+        uint64_t droppedNoBuffer = 0;   // [Live] Captured while every buffer was in use, neither shown nor recorded
+        uint64_t droppedEncoder = 0;    // [Live] Shown but not recorded, the encoder being too far behind
+        uint64_t displaySkipped = 0;    // Annotated but replaced before update() picked them up
+        uint64_t captureErrors = 0;     // Empty frames from the camera
+    };
+
+    VisualizerCamera() = default;
     ~VisualizerCamera();
 
+    void setFramePolicy( FramePolicy policy );      // Before start()
+
+    // Opens the camera (and the video file), and starts the capture, annotation and encoding threads
     int start( int cam = 0, const std::string& outputFilename = "" );
-    int stop();
+    int stop();                                     // Everything captured so far is annotated and encoded first
 
     cv::Mat output;
 
-    int update();
+    int update();                                   // Never waits: 0 if a new frame is in output, -1 otherwise
     void display();
-    void write();
     cv::Mat get();
 
+    Stats getStats() const;
+    void printStats() const;
+
 private:
 
+    void captureLoop();
+    void annotateLoop();
+    void encodeLoop();
+
     // Capture resolution and framerate
     int frameWidth = 640;
     int frameHeight = 360;
@@ -114,6 +190,48 @@ private:
     cv::VideoCapture cap;       // Connection to the camera
     cv::VideoWriter writer;     // Video writer
 
+    FramePolicy policy = FramePolicy::Live;
+
+    // Frame buffers, allocated once by start(). The queues pass their indices from stage to stage:
+    // capture -> annotateQueue -> annotate -> encodeQueue -> encode -> freeFrames -> capture
+    struct Frame {
+        cv::Mat image;
+        int64_t captured = 0;                               // monotonicNs() when read() returned
+        std::chrono::system_clock::time_point wallClock;    // For the overlay
+    };
+
+    static const int poolSize = 8;
+    // Frames waiting for the encoder, leaving a buffer to each of the encoder, the overlay and the capture.
+    // [Live] Beyond that they are not recorded, so the capture never runs out of buffers
+    static const int encodeDepth = poolSize - 3;
+
+    Frame frames[poolSize];
+    BoundedQueue<int> freeFrames { poolSize };
+    BoundedQueue<int> annotateQueue { poolSize };
+    BoundedQueue<int> encodeQueue { encodeDepth };
+    cv::Mat scratch;                                // [Live] Where the frames with no free buffer are read, to be dropped
+
+    std::thread captureThread;
+    std::thread annotateThread;
+    std::thread encodeThread;
+    std::atomic<bool> capturing { false };
+
+    // Latest annotated frame, handed over to update()
+    std::mutex latestMutex;
+    cv::Mat latest;
+    bool fresh = false;
+
+    std::atomic<uint64_t> captured { 0 };
+    std::atomic<uint64_t> recorded { 0 };
+    std::atomic<uint64_t> droppedNoBuffer { 0 };
+    std::atomic<uint64_t> droppedEncoder { 0 };
+    std::atomic<uint64_t> displaySkipped { 0 };
+    std::atomic<uint64_t> captureErrors { 0 };
+
+    Histogram annotateLatency;      // From capture to the overlay drawn
+    Histogram encodeTime;           // writer.write() alone
+    Histogram recordLatency;        // From capture to the frame handed to the encoder and written
+
 };
 
 
@@ -0,0 +1,53 @@
+//
+// Created on 17/10/2026.
+//
+
+#include "WireProtocol.h"
+#include <cstring>
+
+
+// Little-endian helpers, so the datagrams are the same whatever machine sent them
+static void putU16( unsigned char *p, uint16_t v ) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+}
+
+static void putU32( unsigned char *p, uint32_t v ) {
+    for ( int i = 0; i < 4; i++ )
+        p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+static void putU64( unsigned char *p, uint64_t v ) {
+    for ( int i = 0; i < 8; i++ )
+        p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+
+void encodeWireHeader( uint32_t streamId, uint16_t recordCount, unsigned char *buffer ) {
+
+    memcpy(buffer, "TBWP", 4);
+    buffer[4] = wireVersion;
+    buffer[5] = static_cast<unsigned char>(wireHeaderSize);
+    putU16(buffer + 6, static_cast<uint16_t>(wireRecordSize));
+    putU32(buffer + 8, streamId);
+    putU16(buffer + 12, recordCount);
+    putU16(buffer + 14, 0);
+}
+
+void encodeWireRecord( const WireRecord& record, unsigned char *buffer ) {
+
+    putU32(buffer, record.sequence);
+    putU32(buffer + 4, record.count);
+    putU64(buffer + 8, static_cast<uint64_t>(record.timestamp));
+
+    for ( int i = 0; i < 2; i++ ) {
+        putU32(buffer + 16 + 8 * i, static_cast<uint32_t>(record.x[i]));
+        putU32(buffer + 20 + 8 * i, static_cast<uint32_t>(record.y[i]));
+        buffer[32 + 2 * i] = static_cast<unsigned char>(record.dx[i]);
+        buffer[33 + 2 * i] = static_cast<unsigned char>(record.dy[i]);
+        buffer[36 + i] = record.sq[i];
+    }
+
+    buffer[38] = record.button;
+    buffer[39] = record.marker;
+}
@@ -0,0 +1,152 @@
+//
+// Created on 17/10/2026.
+//
+
+#ifndef TRACKBALLCONTROL_WIREPROTOCOL_H
+#define TRACKBALLCONTROL_WIREPROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+
+
+// Decoded network protocol: what Trackball sends over UDP in batched mode, everything little-endian.
+// Receivers get the same integrated positions as the output files, without decoding the firmware bytes themselves.
+//
+// ------------------------------------------- Header (16 bytes) -------------------------------------------
+// | magic "TBWP" | version u8 | header size u8 | record size u16 | stream ID u32 | record count u16 | (2 bytes 0) |
+//
+// ------------------------------------------- Record (40 bytes) -------------------------------------------
+// | sequence u32 | count u32 | timestamp i64 | X0 i32 | Y0 i32 | X1 i32 | Y1 i32 |
+// | DX0 i8 | DY0 i8 | DX1 i8 | DY1 i8 | SQ0 u8 | SQ1 u8 | button u8 | marker u8 |
+//
+// The stream ID is new each time an output starts (wall clock time xor process ID): a receiver that sees it
+// change knows the sender restarted, and its sequence numbers with it, rather than lost packets. The stream
+// server and the shared memory ring (SharedRing.h) pick theirs the same way, for the same reason.
+// Sequence numbers increase by 1 per record within a stream. The timestamp is the host's
+// CLOCK_MONOTONIC_RAW time at USB completion, in ns. A record with a non-zero marker carries a key press.
+// The version goes up only when fields are appended at the end of the header or of the records, so a decoder
+// must use the sizes given in the header, not the ones below, and can read any later version.
+// An incompatible layout would get a new magic.
+
+const uint8_t wireVersion = 1;
+constexpr size_t wireHeaderSize = 16;
+constexpr size_t wireRecordSize = 40;
+
+struct WireRecord {
+    uint32_t sequence = 0;
+    uint32_t count = 0;
+    int64_t timestamp = 0;
+    int32_t x[2] { 0 };
+    int32_t y[2] { 0 };
+    signed char dx[2] { 0 };
+    signed char dy[2] { 0 };
+    unsigned char sq[2] { 0 };
+    unsigned char button = 0x10;
+    unsigned char marker = 0;
+};
+
+void encodeWireHeader( uint32_t streamId, uint16_t recordCount, unsigned char *buffer );
+void encodeWireRecord( const WireRecord& record, unsigned char *buffer );
+
+
+// Reference decoder: views on a received datagram, reading the fields in place (no copy, no allocation).
+// It is header-only, so a receiver only needs this file.
+inline uint16_t wireU16( const unsigned char *p ) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t wireU32( const unsigned char *p ) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+           | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t wireU64( const unsigned char *p ) {
+    return static_cast<uint64_t>(wireU32(p)) | (static_cast<uint64_t>(wireU32(p + 4)) << 32);
+}
+
+class WireRecordView {
+
+public:
+
+    explicit WireRecordView( const unsigned char *data ) : p(data) { }
+
+    uint32_t sequence() const { return wireU32(p); }
+    uint32_t count() const { return wireU32(p + 4); }
+    int64_t timestamp() const { return static_cast<int64_t>(wireU64(p + 8)); }
+    int32_t x( int sensor ) const { return static_cast<int32_t>(wireU32(p + 16 + 8 * sensor)); }
+    int32_t y( int sensor ) const { return static_cast<int32_t>(wireU32(p + 20 + 8 * sensor)); }
+    int dx( int sensor ) const { return static_cast<signed char>(p[32 + 2 * sensor]); }
+    int dy( int sensor ) const { return static_cast<signed char>(p[33 + 2 * sensor]); }
+    int sq( int sensor ) const { return p[36 + sensor]; }
+    bool buttonPressed() const { return (p[38] & 0x10) == 0; }
+    unsigned char button() const { return p[38]; }
+    char marker() const { return static_cast<char>(p[39]); }
+
+    WireRecord record() const {
+
+        WireRecord record;
+        record.sequence = sequence();
+        record.count = count();
+        record.timestamp = timestamp();
+        for ( int i = 0; i < 2; i++ ) {
+            record.x[i] = x(i);
+            record.y[i] = y(i);
+            record.dx[i] = static_cast<signed char>(dx(i));
+            record.dy[i] = static_cast<signed char>(dy(i));
+            record.sq[i] = static_cast<unsigned char>(sq(i));
+        }
+        record.button = button();
+        record.marker = p[39];
+
+        return record;
+    }
+
+private:
+
+    const unsigned char *p;
+
+};
+
+class WireDatagram {
+
+public:
+
+    // false if it isn't a wire datagram or if it's truncated
+    bool parse( const unsigned char *data, size_t length ) {
+
+        if ( length < wireHeaderSize || data[0] != 'T' || data[1] != 'B' || data[2] != 'W' || data[3] != 'P' )
+            return false;
+
+        versionNumber = data[4];
+        headerSize = data[5];
+        recordSize = wireU16(data + 6);
+        streamNumber = wireU32(data + 8);
+        records = wireU16(data + 12);
+
+        if ( versionNumber < 1 || headerSize < wireHeaderSize || recordSize < wireRecordSize
+             || length < headerSize + static_cast<size_t>(records) * recordSize )
+            return false;
+
+        this->data = data;
+
+        return true;
+    }
+
+    uint8_t version() const { return versionNumber; }
+    uint32_t streamId() const { return streamNumber; }
+    size_t size() const { return records; }
+    WireRecordView operator[]( size_t i ) const { return WireRecordView(data + headerSize + i * recordSize); }
+
+private:
+
+    const unsigned char *data { nullptr };
+    uint8_t versionNumber = 0;
+    size_t headerSize = 0;
+    size_t recordSize = 0;
+    uint32_t streamNumber = 0;
+    size_t records = 0;
+
+};
+
+
+#endif //TRACKBALLCONTROL_WIREPROTOCOL_H
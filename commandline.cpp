@@ -4,7 +4,9 @@
 
 #include "Trackball.h"
 #include "Visualizers.h"
+#include "StreamServer.h"
 #include <thread>
+#include <algorithm>
 
 
 static void show_usage( std::string name )
@@ -14,22 +16,54 @@ static void show_usage( std::string name )
               << "\t-h,--help\t\tShow this help message.\n"
               << "\t-s,--sensorview\t\tEnable Sensor View mode.\n"
               << "\t-c,--camera\t\tEnable Camera mode.\n"
+              << "\t--camera-policy P\tWhen the video encoder falls behind: live (drop frames from the video) or record\n"
+              << "\t\t\t\t(record every frame, the display skips some). Default is live\n"
               << "\t-t,--trace\t\tEnable Trace mode.\n"
+              << "\t--trace-length N\tPoints of path kept on the trace. Default is 500\n"
               << "\t-w,--write\t\tEnable writing output files.\n"
+              << "\t--format FORMAT\t\tOutput files format: csv, binary or both. Default is csv\n"
+              << "\t--commit-size KB\tWrite the output files every KB kilobytes. Default is 256\n"
+              << "\t--commit-ms MS\t\tWrite the output files at least every MS milliseconds. Default is 100\n"
+              << "\t--csv-timestamps\tAdd the host timestamp (ns) of each sample to the CSV files.\n"
+              << "\t--compress\t\tWrite the binary session log as compressed blocks (--format binary or both).\n"
               << "\t-n,--network\t\tEnable network diffusion.\n"
+              << "\t-d,--dest HOST:PORT\tSend to HOST:PORT (implies --network). Repeat for several receivers. Default is 127.0.0.1:45944\n"
+              << "\t\t\t\tWith --udp-batch, HOST:PORT/N sends one record every N samples, and HOST:PORT@HZ about HZ records per second,\n"
+              << "\t\t\t\teach one aggregating the samples in between\n"
+              << "\t--mcast-ttl N\t\tTTL of the multicast datagrams. Default is 1 (local network)\n"
+              << "\t--mcast-if IF\t\tSend multicast through the interface IF (name or IPv4 address)\n"
+              << "\t--udp-batch N\t\tSend decoded, sequence-numbered samples, N per datagram (1 to 36). Default is one raw sample per datagram\n"
+              << "\t--udp-burst M\t\tWith --udp-batch, send up to M datagrams per system call (1 to 64). Default is 1\n"
+              << "\t--udp-latency US\tWith --udp-batch, never hold a sample longer than US microseconds. Default is 1000\n"
+              << "\t--udp-compress\t\tWith --udp-batch, compress each datagram (deltas and varints) when that makes it smaller\n"
+              << "\t--udp-inline\t\tSend the datagrams from the acquisition loop. Default is a sender thread of their own\n"
+              << "\t--serve PATH\t\tStream the samples to local clients through the Unix-domain socket PATH.\n"
+              << "\t--serve-tcp PORT\tStream the samples to local clients through the TCP port PORT (loopback only).\n"
+              << "\t--serve-queue N\t\tQueue up to N samples per stream client. Default is 8192\n"
+              << "\t--slow-client POLICY\tWhen a stream client's queue is full: drop (its oldest samples) or disconnect. Default is drop\n"
+              << "\t--shm NAME\t\tAlso publish the samples in the POSIX shared memory ring NAME (e.g. /trackball), for local processes.\n"
+              << "\t--shm-size N\t\tSamples held by the shared memory ring (rounded up to a power of 2). Default is 65536\n"
+              << "\t--io-uring\t\tWrite the output files and send the datagrams through io_uring (Linux 5.6+).\n"
               << "\t-q,--quiet\t\tDisable console output.\n"
               << "\t-v,--vid 0x0000\t\tSpecify the VID of the trackball device. Default is 0x04b4 (Cypress Semiconductor Corp.)\n"
               << "\t-p,--pid 0x0000\t\tSpecify the PID of the trackball device. Default is 0x8613 (CY7C68013 EZ-USB FX2)\n"
               << "\t-f,--firmware PATH\tSpecify the path of the firmware to flash. Default is ./firmware.hex\n"
+              << "\t-a,--async DEPTH\tPoll motion asynchronously, with DEPTH USB commands in flight.\n"
+              << "\t-b,--batch K\t\tRead K motion samples per USB command (1 to 9). Default is 1\n"
+              << "\t--rate HZ\t\tTarget sample rate of the asynchronous polling. Default is as fast as possible\n"
+              << "\t-S,--simulate\t\tRun against a simulated trackball instead of the USB device.\n"
+              << "\t-r,--replay FILE\tSimulate a trackball replaying a recorded CSV session (implies --simulate).\n"
               << std::endl;
 }
 
-void cameraLoopWrapper( Trackball& tb, bool& timeToStop )
+void cameraLoopWrapper( Trackball& tb, bool& timeToStop, VisualizerCamera::FramePolicy framePolicy )
 {
     VisualizerCamera cameraViewer;
 
     int key = 0;
 
+    // Capture, overlay and encoding run on threads of their own: this loop only shows the latest frame
+    cameraViewer.setFramePolicy(framePolicy);
     cameraViewer.start(0, "test");
 
     while ( !timeToStop ) {
@@ -44,21 +78,27 @@ void cameraLoopWrapper( Trackball& tb, bool& timeToStop )
 
         key = cv::waitKey(30);
 
-        cameraViewer.update();
-
-        cameraViewer.display();
-        cameraViewer.write();
+        if ( cameraViewer.update() == 0 )
+            cameraViewer.display();
 
     }
+
+    cameraViewer.stop();
+    cameraViewer.printStats();
 }
 
-void traceLoopWrapper( Trackball& tb, bool& timeToStop )
+void traceLoopWrapper( Trackball& tb, bool& timeToStop, size_t traceLength )
 {
-    VisualizerTrace traceViewer;
+    VisualizerTrace traceViewer(traceLength);
 
     int key = 0;
     bool isFreeball = false;
 
+    // Drain the samples published by the acquisition thread instead of reading its buffer while it's being written.
+    // Every one of them goes into the path, not just the latest: the display runs much slower than the acquisition
+    SampleReader reader = tb.makeReader();
+    std::vector<Sample> samples(4096);
+
     while ( !timeToStop  ) {
 
         if ( key == 27 ) {
@@ -75,20 +115,27 @@ void traceLoopWrapper( Trackball& tb, bool& timeToStop )
 
         key = cv::waitKey(30);
 
-        traceViewer.update(tb.getMotionData(), isFreeball);
+        for ( size_t n = reader.read(samples.data(), samples.size()); n > 0; n = reader.read(samples.data(), samples.size()) )
+            traceViewer.integrate(samples.data(), n, isFreeball);
+
+        traceViewer.update(isFreeball);
 
         traceViewer.display();
     }
 }
 
-void camtraceLoopWrapper( Trackball& tb, bool& timeToStop )
+void camtraceLoopWrapper( Trackball& tb, bool& timeToStop, size_t traceLength, VisualizerCamera::FramePolicy framePolicy )
 {
-    VisualizerTrace traceViewer;
+    VisualizerTrace traceViewer(traceLength);
     VisualizerCamera cameraViewer;
 
     int key = 0;
     bool isFreeball = false;
 
+    SampleReader reader = tb.makeReader();
+    std::vector<Sample> samples(4096);
+
+    cameraViewer.setFramePolicy(framePolicy);
     cameraViewer.start(0, "test");
 
     while ( !timeToStop  ) {
@@ -107,14 +154,18 @@ void camtraceLoopWrapper( Trackball& tb, bool& timeToStop )
 
         key = cv::waitKey(30);
 
-        traceViewer.update(tb.getMotionData(), isFreeball);
-        traceViewer.display();
+        for ( size_t n = reader.read(samples.data(), samples.size()); n > 0; n = reader.read(samples.data(), samples.size()) )
+            traceViewer.integrate(samples.data(), n, isFreeball);
 
-        cameraViewer.update();
+        traceViewer.update(isFreeball);
+        traceViewer.display();
 
-        cameraViewer.display();
-        cameraViewer.write();
+        if ( cameraViewer.update() == 0 )
+            cameraViewer.display();
     }
+
+    cameraViewer.stop();
+    cameraViewer.printStats();
 }
 
 void mainLoopWrapper( Trackball& tb, bool& timeToStop )
@@ -132,31 +183,80 @@ int main(int argc, char* argv[])
 
     bool sensorViewMode;
     bool camera;
+    VisualizerCamera::FramePolicy framePolicy;
     bool trace;
+    size_t traceLength;
     bool silentConsole;
     bool networkOutput;
+    int udpBatch;
+    int udpBurst;
+    int udpLatency;
+    bool udpInline;
     bool diskwriteOutput;
+    bool simulate;
+    Trackball::LogFormat logFormat;
+    bool csvTimestamps;
+    bool compressLog;
+    bool udpCompress;
+    bool ioUring;
+    size_t commitSize;
+    int commitInterval;
 
     unsigned short vid, pid;
     std::string fpath;
+    std::string replay;
+
+    int asyncDepth;
+    double rate;
+    int batch;
+
+    std::vector<std::string> destinations;
+    int multicastTTL;
+    std::string multicastInterface;
 
-    std::string ip;
-    std::string port;
+    std::string servePath;
+    std::string servePort;
+    int serveQueue;
+    StreamServer::SlowClientPolicy slowClientPolicy;
+
+    std::string shmName;
+    size_t shmSize;
 
     // Defaults
     sensorViewMode = false;
     camera = false;
+    framePolicy = VisualizerCamera::FramePolicy::Live;
     trace = false;
+    traceLength = 500;
     silentConsole = false;
     networkOutput = false;
+    udpBatch = 0;
+    udpBurst = 1;
+    udpLatency = 1000;
+    udpInline = false;
     diskwriteOutput = false;
+    simulate = false;
+    logFormat = Trackball::LogFormat::CSV;
+    csvTimestamps = false;
+    compressLog = false;
+    udpCompress = false;
+    ioUring = false;
+    commitSize = 256;
+    commitInterval = 100;
+    asyncDepth = 0;
+    rate = 0.0;
+    batch = 1;
     vid = 0x04b4;
     pid = 0x8613;
     fpath = "./firmware.hex";                 // for final build
 //    fpath = "../Firmware/firmware.hex";       // for debug
 
-    ip = "127.0.0.1";
-    port = "45944";
+    multicastTTL = 1;
+
+    serveQueue = 8192;
+    slowClientPolicy = StreamServer::SlowClientPolicy::DropOldest;
+
+    shmSize = 1 << 16;
 
     std::vector <std::string> remaining_args;
 
@@ -177,10 +277,39 @@ int main(int argc, char* argv[])
             camera = true;
             i++;
 
+        } else if (arg == "--camera-policy") {
+            if (i + 1 < argc) {
+                i++;
+                std::string policy = argv[i];
+
+                if (policy == "live") {
+                    framePolicy = VisualizerCamera::FramePolicy::Live;
+                } else if (policy == "record") {
+                    framePolicy = VisualizerCamera::FramePolicy::RecordAll;
+                } else {
+                    std::cerr << "--camera-policy must be live or record." << std::endl;
+                    return 1;
+                }
+
+            } else {
+                std::cerr << "--camera-policy option requires one argument." << std::endl;
+                return 1;
+            }
+
         }  else if ((arg == "-t") || (arg == "--trace")) {
             trace = true;
             i++;
 
+        } else if (arg == "--trace-length") {
+            if (i + 1 < argc) {
+                i++;
+                traceLength = std::stoul(argv[i]);
+
+            } else {
+                std::cerr << "--trace-length option requires one argument." << std::endl;
+                return 1;
+            }
+
         } else if ((arg == "-q") || (arg == "--quiet")) {
             silentConsole = true;
             i++;
@@ -189,10 +318,203 @@ int main(int argc, char* argv[])
             networkOutput = true;
             i++;
 
+        } else if ((arg == "-d") || (arg == "--dest")) {
+            if (i + 1 < argc) {
+                i++;
+                std::string destination = argv[i];
+
+                if (destination.find(':') == std::string::npos) {
+                    std::cerr << "--dest must be given as HOST:PORT, HOST:PORT/N or HOST:PORT@HZ." << std::endl;
+                    return 1;
+                }
+
+                destinations.push_back(destination);
+                networkOutput = true;
+
+            } else {
+                std::cerr << "--dest option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--mcast-ttl") {
+            if (i + 1 < argc) {
+                i++;
+                multicastTTL = std::stoi(argv[i]);
+
+            } else {
+                std::cerr << "--mcast-ttl option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--mcast-if") {
+            if (i + 1 < argc) {
+                i++;
+                multicastInterface = argv[i];
+
+            } else {
+                std::cerr << "--mcast-if option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--udp-batch") {
+            if (i + 1 < argc) {
+                i++;
+                udpBatch = std::stoi(argv[i]);
+
+            } else {
+                std::cerr << "--udp-batch option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--udp-burst") {
+            if (i + 1 < argc) {
+                i++;
+                udpBurst = std::stoi(argv[i]);
+
+            } else {
+                std::cerr << "--udp-burst option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--udp-latency") {
+            if (i + 1 < argc) {
+                i++;
+                udpLatency = std::stoi(argv[i]);
+
+            } else {
+                std::cerr << "--udp-latency option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--udp-inline") {
+            udpInline = true;
+
+        } else if (arg == "--serve") {
+            if (i + 1 < argc) {
+                i++;
+                servePath = argv[i];
+
+            } else {
+                std::cerr << "--serve option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--serve-tcp") {
+            if (i + 1 < argc) {
+                i++;
+                servePort = argv[i];
+
+            } else {
+                std::cerr << "--serve-tcp option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--serve-queue") {
+            if (i + 1 < argc) {
+                i++;
+                serveQueue = std::stoi(argv[i]);
+
+            } else {
+                std::cerr << "--serve-queue option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--slow-client") {
+            if (i + 1 < argc) {
+                i++;
+                std::string policy = argv[i];
+
+                if (policy == "drop") {
+                    slowClientPolicy = StreamServer::SlowClientPolicy::DropOldest;
+                } else if (policy == "disconnect") {
+                    slowClientPolicy = StreamServer::SlowClientPolicy::Disconnect;
+                } else {
+                    std::cerr << "--slow-client must be drop or disconnect." << std::endl;
+                    return 1;
+                }
+
+            } else {
+                std::cerr << "--slow-client option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--shm") {
+            if (i + 1 < argc) {
+                i++;
+                shmName = argv[i];
+
+            } else {
+                std::cerr << "--shm option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--shm-size") {
+            if (i + 1 < argc) {
+                i++;
+                shmSize = std::stoul(argv[i]);
+
+            } else {
+                std::cerr << "--shm-size option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--io-uring") {
+            ioUring = true;
+
         } else if ((arg == "-w") || (arg == "--write")) {
             diskwriteOutput = true;
             i++;
 
+        } else if (arg == "--format") {
+            if (i + 1 < argc) {
+                i++;
+                std::string format = argv[i];
+
+                if (format == "csv") {
+                    logFormat = Trackball::LogFormat::CSV;
+                } else if (format == "binary") {
+                    logFormat = Trackball::LogFormat::Binary;
+                } else if (format == "both") {
+                    logFormat = Trackball::LogFormat::Both;
+                } else {
+                    std::cerr << "--format must be csv, binary or both." << std::endl;
+                    return 1;
+                }
+
+            } else {
+                std::cerr << "--format option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--commit-size") {
+            if (i + 1 < argc) {
+                i++;
+                commitSize = std::stoul(argv[i]);
+
+            } else {
+                std::cerr << "--commit-size option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--csv-timestamps") {
+            csvTimestamps = true;
+
+        } else if (arg == "--compress") {
+            compressLog = true;
+
+        } else if (arg == "--udp-compress") {
+            udpCompress = true;
+
+        } else if (arg == "--commit-ms") {
+            if (i + 1 < argc) {
+                i++;
+                commitInterval = std::stoi(argv[i]);
+
+            } else {
+                std::cerr << "--commit-ms option requires one argument." << std::endl;
+                return 1;
+            }
+
         } else if ((arg == "-v") || (arg == "--vid")) {
             if (i + 1 < argc) {                 // Make sure we aren't at the end of argv!
                 i++;                            // Increment 'i' so we don't get the argument as the next argv[i]
@@ -224,6 +546,51 @@ int main(int argc, char* argv[])
                 return 1;
             }
 
+        } else if ((arg == "-a") || (arg == "--async")) {
+            if (i + 1 < argc) {
+                i++;
+                asyncDepth = std::stoi(argv[i]);
+
+            } else {
+                std::cerr << "--async option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if ((arg == "-b") || (arg == "--batch")) {
+            if (i + 1 < argc) {
+                i++;
+                batch = std::stoi(argv[i]);
+
+            } else {
+                std::cerr << "--batch option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if (arg == "--rate") {
+            if (i + 1 < argc) {
+                i++;
+                rate = std::stod(argv[i]);
+
+            } else {
+                std::cerr << "--rate option requires one argument." << std::endl;
+                return 1;
+            }
+
+        } else if ((arg == "-S") || (arg == "--simulate")) {
+            simulate = true;
+
+        } else if ((arg == "-r") || (arg == "--replay")) {
+            if (i + 1 < argc) {
+                i++;
+
+                replay = argv[i];
+                simulate = true;
+
+            } else {
+                std::cerr << "--replay option requires one argument." << std::endl;
+                return 1;
+            }
+
         } else {
 
             remaining_args.push_back(argv[i]);
@@ -236,12 +603,20 @@ int main(int argc, char* argv[])
     Trackball tb(vid, pid);
 
     tb.setFirmwarePath(fpath);
-    tb.connectUSB();
+
+    if ( simulate ) {
+        if ( tb.connectSimulator(replay) != 0 )
+            return 1;
+    } else {
+        tb.connectUSB();
+    }
 
     if ( silentConsole ) {
         tb.disableConsoleOutput();
     }
 
+    tb.setIoUring(ioUring);
+
     if ( sensorViewMode ) {
         VisualizerSensors viewer;
         tb.enableSensorView();
@@ -255,12 +630,27 @@ int main(int argc, char* argv[])
             key = cv::waitKey(30);
             tb.acquire();
 
-            viewer.update(tb.sensorView(), tb.getMotionData());
-            viewer.display();
+            // No frame when the grab failed (the error is already reported)
+            unsigned char *images = tb.sensorView();
+            if ( images ) {
+                viewer.update(images, tb.getMotionData());
+                viewer.display();
+            }
         }
 
     } else {
 
+        if ( batch > 1 && tb.setBatchSize(batch) != 0 )
+            return 1;
+
+        if ( asyncDepth > 0 ) {
+            tb.enableAsyncMode(asyncDepth, rate);
+            std::cout << "Polling with " << asyncDepth << " commands in flight";
+            if ( rate > 0.0 )
+                std::cout << " at " << rate << " Hz";
+            std::cout << std::endl;
+        }
+
         if ( diskwriteOutput ) {
             if ( remaining_args.size() == 0 ) {
                 tb.askOutputName();
@@ -268,13 +658,80 @@ int main(int argc, char* argv[])
                 tb.setOutputName(remaining_args[0]);
             }
 
+            tb.setLogFormat(logFormat);
+            tb.setCsvTimestamps(csvTimestamps);
+            tb.setLogCompression(compressLog);
+            tb.setCommitPolicy(commitSize * 1024, std::chrono::milliseconds(commitInterval));
             tb.enableDiskwrite();
         }
 
         if ( networkOutput ) {
-            tb.enableNetwork(ip, port);     // TODO: add args for setting IP and Port from commandline
-            std::cout << "Transmitting over " << ip << ":" << port << std::endl;
+            if ( udpBatch > 0 && tb.setNetworkBatching(udpBatch, udpBurst, std::chrono::microseconds(udpLatency)) != 0 )
+                return 1;
+            tb.setNetworkThread(!udpInline);
+            tb.setNetworkCompression(udpCompress);
+
+            if ( destinations.empty() )
+                destinations.push_back("127.0.0.1:45944");
+
+            // The first destination opens the socket, the others share it
+            for ( size_t d = 0; d < destinations.size(); d++ ) {
+
+                size_t colon = destinations[d].find_last_of(':');
+                size_t suffix = destinations[d].find_first_of("/@", colon);
+                std::string ip = destinations[d].substr(0, colon);
+                std::string port = destinations[d].substr(colon + 1, suffix == std::string::npos ? std::string::npos : suffix - colon - 1);
+
+                int r = ( d == 0 ) ? tb.enableNetwork(ip, port) : tb.addNetworkDestination(ip, port);
+                if ( r != 0 ) {
+                    std::cerr << "Can't send to " << destinations[d] << std::endl;
+                    return 1;
+                }
+
+                // Decimated receiver: /N (every N samples) or @HZ (target rate)
+                if ( suffix != std::string::npos ) {
+                    std::string value = destinations[d].substr(suffix + 1);
+                    bool byRate = destinations[d][suffix] == '@';
+
+                    if ( value.empty() || tb.setNetworkDecimation(d, byRate ? 1 : std::stoi(value), byRate ? std::stod(value) : 0.0) != 0 ) {
+                        std::cerr << "Can't decimate " << destinations[d] << std::endl;
+                        return 1;
+                    }
+                }
+
+                std::cout << "Transmitting over " << destinations[d] << std::endl;
+            }
+
+            if ( tb.setNetworkMulticast(multicastTTL, multicastInterface) != 0 )
+                return 1;
+
+        }
+
+        if ( !shmName.empty() ) {
+            if ( tb.enableSharedRing(shmName, shmSize) != 0 )
+                return 1;
+
+            std::cout << "Publishing samples in shared memory " << shmName << std::endl;
+        }
+
+        StreamServer server;
+
+        if ( !servePath.empty() || !servePort.empty() ) {
+            server.setQueueSize(static_cast<size_t>(std::max(serveQueue, 1)));
+            server.setSlowClientPolicy(slowClientPolicy);
+
+            if ( !servePath.empty() && server.listenUnix(servePath) != 0 )
+                return 1;
+            if ( !servePort.empty() && server.listenTcp(servePort) != 0 )
+                return 1;
+
+            // Reads the sample ring on its own thread, so slow clients never hold up the acquisition
+            server.start(tb.makeReader());
 
+            if ( !servePath.empty() )
+                std::cout << "Serving samples on " << servePath << std::endl;
+            if ( !servePort.empty() )
+                std::cout << "Serving samples on 127.0.0.1:" << servePort << std::endl;
         }
 
         if ( trace && !camera ) {
@@ -282,7 +739,7 @@ int main(int argc, char* argv[])
             bool stopAllThreads = false;
 
             std::thread t1(mainLoopWrapper, std::ref(tb), std::ref(stopAllThreads));
-            std::thread t2(traceLoopWrapper, std::ref(tb), std::ref(stopAllThreads));
+            std::thread t2(traceLoopWrapper, std::ref(tb), std::ref(stopAllThreads), traceLength);
 
             t1.join();
             t2.join();
@@ -292,7 +749,7 @@ int main(int argc, char* argv[])
             bool stopAllThreads = false;
 
             std::thread t1(mainLoopWrapper, std::ref(tb), std::ref(stopAllThreads));
-            std::thread t2(cameraLoopWrapper, std::ref(tb), std::ref(stopAllThreads));
+            std::thread t2(cameraLoopWrapper, std::ref(tb), std::ref(stopAllThreads), framePolicy);
 
             t1.join();
             t2.join();
@@ -302,7 +759,7 @@ int main(int argc, char* argv[])
             bool stopAllThreads = false;
 
             std::thread t1(mainLoopWrapper, std::ref(tb), std::ref(stopAllThreads));
-            std::thread t2(camtraceLoopWrapper, std::ref(tb), std::ref(stopAllThreads));
+            std::thread t2(camtraceLoopWrapper, std::ref(tb), std::ref(stopAllThreads), traceLength, framePolicy);
 
             t1.join();
             t2.join();
@@ -317,6 +774,16 @@ int main(int argc, char* argv[])
 
         }
 
+        server.stop();
+
+        tb.printTimingStats();
+        if ( networkOutput ) {
+            tb.disableNetwork();        // Stops the sender thread, and sends what is still batched
+            tb.printNetworkStats();
+        }
+        if ( !servePath.empty() || !servePort.empty() )
+            server.printStats();
+        printInstrumentation();
     }
 
     return 0;